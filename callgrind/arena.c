@@ -0,0 +1,163 @@
+/*--------------------------------------------------------------------*/
+/*--- Callgrind                                                    ---*/
+/*---                                                      arena.c ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Callgrind, a Valgrind tool for call tracing.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+#include "global.h"
+
+/*------------------------------------------------------------*/
+/*--- Arena allocation of cost center objects              ---*/
+/*------------------------------------------------------------*/
+
+/* Objects are cut from large chunks, so that objects allocated one
+ * after the other (e.g. a BBCC and its cost array) are near in memory.
+ * Objects too big for a chunk get their own chunk.
+ *
+ * Object sizes are rounded up to ARENA_ALIGN. Freed objects are put
+ * into a free list per size class, and reused for the same size.
+ */
+
+#define ARENA_CHUNK_SIZE  (64*1024)
+#define ARENA_MAX_OBJECT  (ARENA_CHUNK_SIZE/4)
+
+struct _ArenaChunk {
+  ArenaChunk *next, *prev;
+  SizeT size;
+  /* align start of data also for 64bit costs on 32bit platforms */
+  ULong data[0];
+};
+
+void CLG_(init_arena)(cc_arena* a, const HChar* cc)
+{
+    Int i;
+
+    a->cc      = cc;
+    a->chunks  = 0;
+    a->current = 0;
+    a->end     = 0;
+    for (i = 0; i < ARENA_CLASSES; i++)
+	a->free[i] = 0;
+}
+
+cc_arena* CLG_(new_arena)(const HChar* cc)
+{
+    cc_arena* a = (cc_arena*) CLG_MALLOC(cc, sizeof(cc_arena));
+
+    CLG_(init_arena)(a, cc);
+    return a;
+}
+
+static __inline__
+SizeT round_size(SizeT size)
+{
+    return (size + ARENA_ALIGN-1) & ~((SizeT)ARENA_ALIGN-1);
+}
+
+static ArenaChunk* new_chunk(cc_arena* a, SizeT size)
+{
+    ArenaChunk* c;
+
+    c = (ArenaChunk*) CLG_MALLOC(a->cc, sizeof(ArenaChunk) + size);
+    c->size = size;
+    c->prev = 0;
+    c->next = a->chunks;
+    if (a->chunks) a->chunks->prev = c;
+    a->chunks = c;
+
+    CLG_(stat).arena_chunks++;
+    return c;
+}
+
+/* Allocate an object of <size> bytes, not initialized */
+void* CLG_(arena_alloc)(cc_arena* a, SizeT size)
+{
+    ArenaChunk* c;
+    void* p;
+    UInt cl;
+
+    /* zero-sized objects still get a distinct address */
+    size = round_size(size > 0 ? size : 1);
+
+    if (size > ARENA_MAX_OBJECT) {
+	c = new_chunk(a, size);
+	return c->data;
+    }
+
+    cl = size / ARENA_ALIGN;
+    if (cl < ARENA_CLASSES && a->free[cl]) {
+	p = a->free[cl];
+	a->free[cl] = *(void**)p;
+	return p;
+    }
+
+    if (a->current + size > a->end) {
+	c = new_chunk(a, ARENA_CHUNK_SIZE);
+	a->current = (HChar*) c->data;
+	a->end     = a->current + ARENA_CHUNK_SIZE;
+    }
+
+    p = a->current;
+    a->current += size;
+    return p;
+}
+
+/* Give back an object of <size> bytes allocated from arena <a> */
+void CLG_(arena_free)(cc_arena* a, void* p, SizeT size)
+{
+    ArenaChunk* c;
+    UInt cl;
+
+    size = round_size(size > 0 ? size : 1);
+
+    if (size > ARENA_MAX_OBJECT) {
+	c = (ArenaChunk*) ((HChar*)p - sizeof(ArenaChunk));
+	CLG_ASSERT(c->size == size);
+	if (c->prev) c->prev->next = c->next;
+	else a->chunks = c->next;
+	if (c->next) c->next->prev = c->prev;
+	VG_(free)(c);
+	CLG_(stat).arena_chunks--;
+	return;
+    }
+
+    /* objects bigger than the largest size class are not reused */
+    cl = size / ARENA_ALIGN;
+    if (cl >= ARENA_CLASSES) return;
+
+    *(void**)p = a->free[cl];
+    a->free[cl] = p;
+}
+
+/* Free all objects allocated from arena <a> at once */
+void CLG_(arena_release)(cc_arena* a)
+{
+    ArenaChunk *c, *next;
+
+    for (c = a->chunks; c; c = next) {
+	next = c->next;
+	VG_(free)(c);
+	CLG_(stat).arena_chunks--;
+    }
+    CLG_(init_arena)(a, a->cc);
+}
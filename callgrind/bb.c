@@ -32,87 +32,47 @@
 /*--- Basic block (BB) operations                          ---*/
 /*------------------------------------------------------------*/
 
-/* BB hash, resizable */
+/* BB hash, resizable.
+ * The hash stores BBs according to
+ * - ELF object (is 0 for code in anonymous mapping)
+ * - BB base as object file offset
+ */
 bb_hash bbs;
 
-void CLG_(init_bb_hash)()
-{
-   Int i;
-
-   bbs.size    = 8437;
-   bbs.entries = 0;
-   bbs.table = (BB**) CLG_MALLOC("cl.bb.ibh.1",
-                                 bbs.size * sizeof(BB*));
+/* BBs are allocated from an arena, and freed on discard */
+static cc_arena bb_arena;
 
-   for (i = 0; i < bbs.size; i++) bbs.table[i] = NULL;
+static Bool bb_eq(void* entry, UWord obj, UWord offset, void* arg)
+{
+   BB* bb = (BB*) entry;
+   return ((UWord)bb->obj == obj) && ((UWord)bb->offset == offset);
 }
 
-bb_hash* CLG_(get_bb_hash)()
+void CLG_(init_bb_hash)()
 {
-  return &bbs;
+   CLG_(init_hash)(&(bbs.table), "cl.bb.ibh.1", 8192, bb_eq,
+		   &(CLG_(stat).bb_hash_resizes));
+   CLG_(init_arena)(&bb_arena, "cl.bb.nb.1");
 }
 
-/* The hash stores BBs according to
- * - ELF object (is 0 for code in anonymous mapping)
- * - BB base as object file offset
- */
-static __inline__
-UInt bb_hash_idx(obj_node* obj, PtrdiffT offset, UInt size)
+bb_hash* CLG_(get_bb_hash)()
 {
-  return (((Addr)obj) + offset) % size;
+  return &bbs;
 }
 
-/* double size of bb table  */
-static
-void resize_bb_table(void)
+/* Size of a BB structure including the arrays allocated after it */
+static UInt bb_size(UInt instr_count, UInt cjmp_count)
 {
-    Int i, new_size, conflicts1 = 0, conflicts2 = 0;
-    BB **new_table, *curr, *next;
-    UInt new_idx;
-
-    new_size  = 2* bbs.size +3;
-    new_table = (BB**) CLG_MALLOC("cl.bb.rbt.1",
-                                  new_size * sizeof(BB*));
- 
-    if (!new_table) return;
- 
-    for (i = 0; i < new_size; i++)
-      new_table[i] = NULL;
- 
-    for (i = 0; i < bbs.size; i++) {
-	if (bbs.table[i] == NULL) continue;
- 
-	curr = bbs.table[i];
-	while (NULL != curr) {
-	    next = curr->next;
-
-	    new_idx = bb_hash_idx(curr->obj, curr->offset, new_size);
-
-	    curr->next = new_table[new_idx];
-	    new_table[new_idx] = curr;
-	    if (curr->next) {
-		conflicts1++;
-		if (curr->next->next)
-		    conflicts2++;
-	    }
-
-	    curr = next;
-	}
-    }
-
-    VG_(free)(bbs.table);
-
-
-    CLG_DEBUG(0, "Resize BB Hash: %d => %d (entries %d, conflicts %d/%d)\n",
-	     bbs.size, new_size,
-	     bbs.entries, conflicts1, conflicts2);
-
-    bbs.size  = new_size;
-    bbs.table = new_table;
-    CLG_(stat).bb_hash_resizes++;
+   UInt size = sizeof(BB) + instr_count * sizeof(InstrInfo)
+                          + (cjmp_count+1) * sizeof(CJmpInfo);
+
+   if (CLG_(clo).collect_mix)
+      size += (cjmp_count+1) * MIX_EVENTS * sizeof(UShort);
+   if (CLG_(clo).cost_model)
+      size += (cjmp_count+1) * sizeof(UInt);
+   return size;
 }
 
-
 /**
  * Allocate new BB structure (including space for event type list)
  * Not initialized:
@@ -122,16 +82,10 @@ static BB* new_bb(obj_node* obj, PtrdiffT offset,
 		  UInt instr_count, UInt cjmp_count, Bool cjmp_inverted)
 {
    BB* bb;
-   UInt idx, size;
-
-   /* check fill degree of bb hash table and resize if needed (>80%) */
-   bbs.entries++;
-   if (10 * bbs.entries / bbs.size > 8)
-       resize_bb_table();
+   UInt size;
 
-   size = sizeof(BB) + instr_count * sizeof(InstrInfo)
-                     + (cjmp_count+1) * sizeof(CJmpInfo);
-   bb = (BB*) CLG_MALLOC("cl.bb.nb.1", size);
+   size = bb_size(instr_count, cjmp_count);
+   bb = (BB*) CLG_(arena_alloc)(&bb_arena, size);
    VG_(memset)(bb, 0, size);
 
    bb->obj        = obj;
@@ -141,6 +95,12 @@ static BB* new_bb(obj_node* obj, PtrdiffT offset,
    bb->cjmp_count  = cjmp_count;
    bb->cjmp_inverted = cjmp_inverted;
    bb->jmp         = (CJmpInfo*) &(bb->instr[instr_count]);
+   bb->mix         = CLG_(clo).collect_mix ?
+                        (UShort*) &(bb->jmp[cjmp_count+1]) : 0;
+   bb->cycles      = 0;
+   if (CLG_(clo).cost_model)
+      bb->cycles   = bb->mix ? (UInt*) &(bb->mix[(cjmp_count+1)*MIX_EVENTS])
+                             : (UInt*) &(bb->jmp[cjmp_count+1]);
    bb->instr_len   = 0;
    bb->cost_count  = 0;
    bb->sect_kind   = VG_(DebugInfo_sect_kind)(NULL, 0, offset + obj->offset);
@@ -149,11 +109,11 @@ static BB* new_bb(obj_node* obj, PtrdiffT offset,
    bb->is_entry    = 0;
    bb->bbcc_list   = 0;
    bb->last_bbcc   = 0;
+   bb->pos_count   = 0;
+   bb->pos         = 0;
 
    /* insert into BB hash table */
-   idx = bb_hash_idx(obj, offset, bbs.size);
-   bb->next = bbs.table[idx];
-   bbs.table[idx] = bb;
+   CLG_(hash_insert)(&(bbs.table), (UWord)obj, (UWord)offset, bb);
 
    CLG_(stat).distinct_bbs++;
 
@@ -179,15 +139,9 @@ static __inline__
 BB* lookup_bb(obj_node* obj, PtrdiffT offset)
 {
     BB* bb;
-    Int idx;
 
-    idx = bb_hash_idx(obj, offset, bbs.size);
-    bb = bbs.table[idx];
-
-    while(bb) {
-      if ((bb->obj == obj) && (bb->offset == offset)) break;
-      bb = bb->next;
-    }
+    bb = (BB*) CLG_(hash_lookup)(&(bbs.table), (UWord)obj, (UWord)offset,
+				 0);
 
     CLG_DEBUG(5, "  lookup_bb (Obj %s, off %#lx): %p\n",
 	     obj->name, offset, bb);
@@ -288,23 +242,14 @@ BB* CLG_(get_bb)(Addr addr, IRSB* bbIn, /*OUT*/ Bool *seen_before)
    address 'addr'. */
 void CLG_(delete_bb)(Addr addr)
 {
-    BB  *bb, *bp;
-    Int idx, size;
+    BB  *bb;
+    Int size;
 
     obj_node* obj = obj_of_address(addr);
     PtrdiffT offset = addr - obj->offset;
 
-    idx = bb_hash_idx(obj, offset, bbs.size);
-    bb = bbs.table[idx];
-
-    /* bb points at the current bb under consideration, and bp is the
-       one before. */
-    bp = NULL;
-    while(bb) {
-      if ((bb->obj == obj) && (bb->offset == offset)) break;
-      bp = bb;
-      bb = bb->next;
-    }
+    bb = (BB*) CLG_(hash_lookup)(&(bbs.table), (UWord)obj, (UWord)offset,
+				 0);
 
     if (bb == NULL) {
 	CLG_DEBUG(3, "  delete_bb (Obj %s, off %#lx): NOT FOUND\n",
@@ -318,15 +263,7 @@ void CLG_(delete_bb)(Addr addr)
     }
 
     /* unlink it from hash table */
-
-    if (bp == NULL) {
-       /* we found the first one in the list. */
-       tl_assert(bb == bbs.table[idx]);
-       bbs.table[idx] = bb->next;
-    } else {
-       tl_assert(bb != bbs.table[idx]);
-       bp->next = bb->next;
-    }
+    CLG_(hash_remove)(&(bbs.table), (UWord)obj, (UWord)offset, bb);
 
     CLG_DEBUG(3, "  delete_bb (Obj %s, off %#lx): %p, BBCC head: %p\n",
 	      obj->name, offset, bb, bb->bbcc_list);
@@ -336,12 +273,111 @@ void CLG_(delete_bb)(Addr addr)
 
 	/* Fill the block up with junk and then free it, so we will
 	   hopefully get a segfault if it is used again by mistake. */
-	size = sizeof(BB)
-	    + bb->instr_count * sizeof(InstrInfo)
-	    + (bb->cjmp_count+1) * sizeof(CJmpInfo);
+	if (bb->pos)
+	    CLG_(arena_free)(&bb_arena, bb->pos,
+			     bb->pos_count * sizeof(PosRun));
+	size = bb_size(bb->instr_count, bb->cjmp_count);
 	VG_(memset)( bb, 0xAA, size );
-	CLG_FREE(bb);
+	CLG_(arena_free)(&bb_arena, bb, size);
 	return;
     }
     CLG_DEBUG(3, "  delete_bb: BB in use, can not free!\n");
 }
+
+/* Forget about all BBCCs of BBs, as they are released.
+ * On next execution, a BB gets a fresh BBCC list */
+void CLG_(forget_bbccs)()
+{
+    BB* bb;
+    UInt pos = 0;
+
+    while ((bb = CLG_(hash_next)(&(bbs.table), &pos))) {
+	bb->bbcc_list = 0;
+	bb->last_bbcc = 0;
+    }
+}
+
+
+/*------------------------------------------------------------*/
+/*--- Source positions of instructions                     ---*/
+/*------------------------------------------------------------*/
+
+/* Source file and line of <addr>, as written into profile dumps */
+static Bool get_source_pos(obj_node* obj, Addr addr, PosRun* r)
+{
+    HChar file[FILENAME_LEN];
+    HChar dir[FILENAME_LEN];
+    Bool found_file_line, found_dirname;
+
+    found_file_line = VG_(get_filename_linenum)(addr,
+						file, FILENAME_LEN,
+						dir, FILENAME_LEN,
+						&found_dirname,
+						&(r->line));
+    if (!found_file_line) {
+	VG_(strcpy)(file, "???");
+	r->line = 0;
+    }
+    if (found_dirname) {
+	// +1 for the '/'.
+	CLG_ASSERT(VG_(strlen)(dir) + VG_(strlen)(file) + 1 < FILENAME_LEN);
+	VG_(strcat)(dir, "/");     // Append '/'
+	VG_(strcat)(dir, file);    // Append file to dir
+	VG_(strcpy)(file, dir);    // Move dir+file to file
+    }
+    r->file  = CLG_(get_file_node)(obj, file);
+    r->found = found_file_line;
+
+    return found_file_line;
+}
+
+/* Look up source positions of all instructions of a BB once.
+ * Consecutive instructions with same position share one run, so
+ * dumps do not need any debug info queries.
+ */
+void CLG_(init_bb_pos)(BB* bb)
+{
+    static PosRun* runs = 0;
+    static UInt runs_size = 0;
+    PosRun r;
+    UInt i, n = 0;
+
+    CLG_ASSERT(bb->pos == 0);
+    if (bb->instr_count == 0) return;
+
+    if (runs_size < bb->instr_count) {
+	runs_size = bb->instr_count;
+	runs = (PosRun*) VG_(realloc)("cl.bb.ibp.1", runs,
+				      runs_size * sizeof(PosRun));
+    }
+
+    for(i = 0; i < bb->instr_count; i++) {
+	get_source_pos(bb->obj, bb_addr(bb) + bb->instr[i].instr_offset, &r);
+	if ((n > 0) && (runs[n-1].file == r.file) &&
+	    (runs[n-1].line == r.line) && (runs[n-1].found == r.found))
+	    continue;
+	r.first = i;
+	runs[n++] = r;
+    }
+
+    bb->pos = (PosRun*) CLG_(arena_alloc)(&bb_arena, n * sizeof(PosRun));
+    VG_(memcpy)(bb->pos, runs, n * sizeof(PosRun));
+    bb->pos_count = n;
+}
+
+/* Run containing instruction <instr> of <bb> */
+PosRun* CLG_(get_bb_pos)(BB* bb, UInt instr)
+{
+    UInt lo = 0, hi = bb->pos_count, mid;
+
+    CLG_ASSERT(bb->pos_count > 0);
+    CLG_ASSERT(instr < bb->instr_count);
+
+    /* find last run with first <= instr */
+    while(hi - lo > 1) {
+	mid = (lo + hi) / 2;
+	if (bb->pos[mid].first <= instr) lo = mid;
+	else hi = mid;
+    }
+    return &(bb->pos[lo]);
+}
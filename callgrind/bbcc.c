@@ -35,32 +35,43 @@
 /*--- BBCC operations                                      ---*/
 /*------------------------------------------------------------*/
 
-#define N_BBCC_INITIAL_ENTRIES  10437
+#define N_BBCC_INITIAL_ENTRIES  16384
 
 /* BBCC table (key is BB/Context), per thread, resizable */
 bbcc_hash current_bbccs;
 
-void CLG_(init_bbcc_hash)(bbcc_hash* bbccs)
+static Bool bbcc_eq(void* entry, UWord bb, UWord cxt, void* arg)
 {
-   Int i;
+   BBCC* bbcc = (BBCC*) entry;
+   return ((UWord)bbcc->bb == bb) && ((UWord)bbcc->cxt == cxt);
+}
 
+void CLG_(init_bbcc_hash)(bbcc_hash* bbccs)
+{
    CLG_ASSERT(bbccs != 0);
 
-   bbccs->size    = N_BBCC_INITIAL_ENTRIES;
-   bbccs->entries = 0;
-   bbccs->table = (BBCC**) CLG_MALLOC("cl.bbcc.ibh.1",
-                                      bbccs->size * sizeof(BBCC*));
+   CLG_(init_hash)(&(bbccs->table), "cl.bbcc.ibh.1",
+		   N_BBCC_INITIAL_ENTRIES, bbcc_eq,
+		   &(CLG_(stat).bbcc_hash_resizes));
+   bbccs->arena = CLG_(new_arena)("cl.bbcc.nb.1");
+   bbccs->dirty = 0;
+   bbccs->epoch = 1;
+}
 
-   for (i = 0; i < bbccs->size; i++) bbccs->table[i] = NULL;
+/* Free all BBCCs of current thread at once.
+ * BBs must not point to them any longer (see CLG_(forget_bbccs)) */
+void CLG_(release_current_bbccs)()
+{
+   CLG_(hash_clear)(&(current_bbccs.table));
+   CLG_(arena_release)(current_bbccs.arena);
+   current_bbccs.dirty = 0;
 }
 
 void CLG_(copy_current_bbcc_hash)(bbcc_hash* dst)
 {
   CLG_ASSERT(dst != 0);
 
-  dst->size    = current_bbccs.size;
-  dst->entries = current_bbccs.entries;
-  dst->table   = current_bbccs.table;
+  *dst = current_bbccs;
 }
 
 bbcc_hash* CLG_(get_current_bbcc_hash)()
@@ -72,9 +83,7 @@ void CLG_(set_current_bbcc_hash)(bbcc_hash* h)
 {
   CLG_ASSERT(h != 0);
 
-  current_bbccs.size    = h->size;
-  current_bbccs.entries = h->entries;
-  current_bbccs.table   = h->table;
+  current_bbccs = *h;
 }
 
 /*
@@ -109,27 +118,76 @@ void CLG_(zero_bbcc)(BBCC* bbcc)
 
 
 
+/* Allocate cost array for skipped calls of a BBCC, if not done yet */
+void CLG_(init_skipped_cost)(BBCC* bbcc)
+{
+  if (bbcc->skipped) return;
+
+  bbcc->skipped = (ULong*) CLG_(arena_alloc)(current_bbccs.arena,
+					     CLG_(sets).full->size *
+					     sizeof(ULong));
+  CLG_(init_cost)( CLG_(sets).full, bbcc->skipped );
+}
+
 void CLG_(forall_bbccs)(void (*func)(BBCC*))
 {
   BBCC *bbcc, *bbcc2;
-  int i, j;
-	
-  for (i = 0; i < current_bbccs.size; i++) {
-    if ((bbcc=current_bbccs.table[i]) == NULL) continue;
-    while (bbcc) {
-      /* every bbcc should have a rec_array */
-      CLG_ASSERT(bbcc->rec_array != 0);
-
-      for(j=0;j<bbcc->cxt->fn[0]->separate_recursions;j++) {
-	if ((bbcc2 = bbcc->rec_array[j]) == 0) continue;
-
-	(*func)(bbcc2);
-      }
-      bbcc = bbcc->next;
+  UInt pos = 0;
+  int j;
+
+  while ((bbcc = CLG_(hash_next)(&(current_bbccs.table), &pos))) {
+    /* every bbcc should have a rec_array */
+    CLG_ASSERT(bbcc->rec_array != 0);
+
+    for(j=0;j<bbcc->cxt->fn[0]->separate_recursions;j++) {
+      if ((bbcc2 = bbcc->rec_array[j]) == 0) continue;
+      /* skip recursion levels folded into the first one */
+      if (bbcc2->rec_index != j) continue;
+
+      (*func)(bbcc2);
     }
   }
 }
 
+/* Changes of counters since the last dump are tracked by chaining
+ * BBCCs into a dirty list. Counters of a jCC only change together
+ * with counters of its BBCC <from>, so the dirty BBCCs also give
+ * all changed jCCs. Dumping and zeroing only needs to visit these,
+ * instead of all BBCCs of the program.
+ */
+static __inline__
+void mark_dirty(BBCC* bbcc)
+{
+  if (bbcc->epoch == current_bbccs.epoch) return;
+
+  bbcc->epoch = current_bbccs.epoch;
+  bbcc->next_dirty = current_bbccs.dirty;
+  current_bbccs.dirty = bbcc;
+}
+
+void CLG_(mark_dirty_bbcc)(BBCC* bbcc)
+{
+  mark_dirty(bbcc);
+}
+
+/* Call <func> for all BBCCs with counters changed since the
+ * last call of CLG_(clear_dirty_bbccs). This includes BBCCs whose
+ * counters were zeroed in between. */
+void CLG_(forall_dirty_bbccs)(void (*func)(BBCC*))
+{
+  BBCC* bbcc;
+
+  for(bbcc = current_bbccs.dirty; bbcc; bbcc = bbcc->next_dirty)
+    (*func)(bbcc);
+}
+
+/* Start a new epoch with an empty dirty list */
+void CLG_(clear_dirty_bbccs)()
+{
+  current_bbccs.dirty = 0;
+  current_bbccs.epoch++;
+}
+
 
 /* All BBCCs for recursion level 0 are inserted into a
  * thread specific hash table with key
@@ -141,23 +199,12 @@ void CLG_(forall_bbccs)(void (*func)(BBCC*))
  * counters to be changed in the execution of a BB.
  */
 
-static __inline__
-UInt bbcc_hash_idx(BB* bb, Context* cxt, UInt size)
-{
-   CLG_ASSERT(bb != 0);
-   CLG_ASSERT(cxt != 0);
-
-   return ((Addr)bb + (Addr)cxt) % size;
-}
- 
-
 /* Lookup for a BBCC in hash.
  */ 
 static
 BBCC* lookup_bbcc(BB* bb, Context* cxt)
 {
    BBCC* bbcc = bb->last_bbcc;
-   UInt  idx;
 
    /* check LRU */
    if (bbcc->cxt == cxt) {
@@ -170,13 +217,8 @@ BBCC* lookup_bbcc(BB* bb, Context* cxt)
 
    CLG_(stat).bbcc_lru_misses++;
 
-   idx = bbcc_hash_idx(bb, cxt, current_bbccs.size);
-   bbcc = current_bbccs.table[idx];
-   while (bbcc &&
-	  (bb      != bbcc->bb ||
-	   cxt     != bbcc->cxt)) {
-       bbcc = bbcc->next;
-   }
+   bbcc = (BBCC*) CLG_(hash_lookup)(&(current_bbccs.table),
+				    (UWord)bb, (UWord)cxt, 0);
    
    CLG_DEBUG(2,"  lookup_bbcc(BB %#lx, Cxt %d, fn '%s'): %p (tid %d)\n",
 	    bb_addr(bb), cxt->base_number, cxt->fn[0]->name, 
@@ -189,66 +231,14 @@ BBCC* lookup_bbcc(BB* bb, Context* cxt)
 }
 
 
-/* double size of hash table 1 (addr->BBCC) */
-static void resize_bbcc_hash(void)
-{
-    Int i, new_size, conflicts1 = 0, conflicts2 = 0;
-    BBCC** new_table;
-    UInt new_idx;
-    BBCC *curr_BBCC, *next_BBCC;
-
-    new_size = 2*current_bbccs.size+3;
-    new_table = (BBCC**) CLG_MALLOC("cl.bbcc.rbh.1",
-                                    new_size * sizeof(BBCC*));
- 
-    if (!new_table) return;
- 
-    for (i = 0; i < new_size; i++)
-      new_table[i] = NULL;
- 
-    for (i = 0; i < current_bbccs.size; i++) {
-	if (current_bbccs.table[i] == NULL) continue;
- 
-	curr_BBCC = current_bbccs.table[i];
-	while (NULL != curr_BBCC) {
-	    next_BBCC = curr_BBCC->next;
-
-	    new_idx = bbcc_hash_idx(curr_BBCC->bb,
-				    curr_BBCC->cxt,
-				    new_size);
-
-	    curr_BBCC->next = new_table[new_idx];
-	    new_table[new_idx] = curr_BBCC;
-	    if (curr_BBCC->next) {
-		conflicts1++;
-		if (curr_BBCC->next->next)
-		    conflicts2++;
-	    }
-
-	    curr_BBCC = next_BBCC;
-	}
-    }
-
-    VG_(free)(current_bbccs.table);
-
-
-    CLG_DEBUG(0,"Resize BBCC Hash: %d => %d (entries %d, conflicts %d/%d)\n",
-	     current_bbccs.size, new_size,
-	     current_bbccs.entries, conflicts1, conflicts2);
-
-    current_bbccs.size = new_size;
-    current_bbccs.table = new_table;
-    CLG_(stat).bbcc_hash_resizes++;
-}
-
-
 static __inline
 BBCC** new_recursion(int size)
 {
     BBCC** bbccs;
     int i;
 
-    bbccs = (BBCC**) CLG_MALLOC("cl.bbcc.nr.1", sizeof(BBCC*) * size);
+    bbccs = (BBCC**) CLG_(arena_alloc)(current_bbccs.arena,
+				       sizeof(BBCC*) * size);
     for(i=0;i<size;i++)
 	bbccs[i] = 0;
 
@@ -273,15 +263,16 @@ BBCC* new_bbcc(BB* bb)
    /* We need cjmp_count+1 JmpData structs:
     * the last is for the unconditional jump/call/ret at end of BB
     */
-   bbcc = (BBCC*)CLG_MALLOC("cl.bbcc.nb.1",
-			    sizeof(BBCC) +
-			    (bb->cjmp_count+1) * sizeof(JmpData));
+   bbcc = (BBCC*) CLG_(arena_alloc)(current_bbccs.arena,
+				    sizeof(BBCC) +
+				    (bb->cjmp_count+1) * sizeof(JmpData));
    bbcc->bb  = bb;
    bbcc->tid = CLG_(current_tid);
 
    bbcc->ret_counter = 0;
    bbcc->skipped = 0;
-   bbcc->cost = CLG_(get_costarray)(bb->cost_count);
+   bbcc->cost = (ULong*) CLG_(arena_alloc)(current_bbccs.arena,
+					   bb->cost_count * sizeof(ULong));
    for(i=0;i<bb->cost_count;i++)
      bbcc->cost[i] = 0;
    for(i=0; i<=bb->cjmp_count; i++) {
@@ -294,6 +285,10 @@ BBCC* new_bbcc(BB* bb)
    bbcc->lru_next_bbcc = 0;
    bbcc->lru_from_jcc  = 0;
    bbcc->lru_to_jcc  = 0;
+
+   /* not in dirty list */
+   bbcc->next_dirty = 0;
+   bbcc->epoch = 0;
    
    CLG_(stat).distinct_bbccs++;
 
@@ -318,24 +313,16 @@ BBCC* new_bbcc(BB* bb)
 static
 void insert_bbcc_into_hash(BBCC* bbcc)
 {
-    UInt idx;
-    
     CLG_ASSERT(bbcc->cxt != 0);
 
     CLG_DEBUG(3,"+ insert_bbcc_into_hash(BB %#lx, fn '%s')\n",
 	     bb_addr(bbcc->bb), bbcc->cxt->fn[0]->name);
 
-    /* check fill degree of hash and resize if needed (>90%) */
-    current_bbccs.entries++;
-    if (100 * current_bbccs.entries / current_bbccs.size > 90)
-	resize_bbcc_hash();
-
-    idx = bbcc_hash_idx(bbcc->bb, bbcc->cxt, current_bbccs.size);
-    bbcc->next = current_bbccs.table[idx];
-    current_bbccs.table[idx] = bbcc;
+    CLG_(hash_insert)(&(current_bbccs.table),
+		      (UWord)bbcc->bb, (UWord)bbcc->cxt, bbcc);
 
     CLG_DEBUG(3,"- insert_bbcc_into_hash: %d entries\n",
-	     current_bbccs.entries);
+	     current_bbccs.table.entries);
 }
 
 static const HChar* mangled_cxt(Context* cxt, int rec_index)
@@ -423,6 +410,9 @@ static BBCC* clone_bbcc(BBCC* orig, Context* cxt, Int rec_index)
 	     mangled_cxt(bbcc->cxt, bbcc->rec_index));
 
     CLG_(stat).bbcc_clones++;
+    CLG_(stat).clone_memory += sizeof(BBCC) +
+      (orig->bb->cjmp_count+1) * sizeof(JmpData) +
+      orig->bb->cost_count * sizeof(ULong);
  
     return bbcc;
 };
@@ -501,6 +491,7 @@ static void handleUnderflow(BB* bb)
   }
   else if (CLG_(current_state).collect)
     source_bbcc->ecounter_sum++;
+  if (source_bbcc->ecounter_sum > 0) mark_dirty(source_bbcc);
   
   /* Force a new top context, will be set active by push_cxt() */
   CLG_(current_fn_stack).top--;
@@ -545,6 +536,28 @@ static void handleUnderflow(BB* bb)
 }
 
 
+/* Add instruction mix of <bb> when leaving at side exit <passed>.
+ * The tallies are precalculated at instrumentation time, so that the
+ * instruction mix is counted without a helper call per instruction.
+ */
+static __inline__
+void add_mix_cost(ULong* cost, BB* bb, Int passed)
+{
+  UShort* tally = bb->mix + passed * MIX_EVENTS;
+  Int i;
+
+  cost += fullOffset(EG_MIX);
+  for(i = 0; i < MIX_EVENTS; i++)
+    cost[i] += tally[i];
+}
+
+/* Add estimated cycles of <bb> when leaving at side exit <passed> */
+static __inline__
+void add_cycle_cost(ULong* cost, BB* bb, Int passed)
+{
+  cost[ fullOffset(EG_CYC) ] += bb->cycles[passed];
+}
+
 /*
  * Helper function called at start of each instrumented BB to setup
  * pointer to costs for current thread/context/recursion level
@@ -598,22 +611,41 @@ void CLG_(setup_bbcc)(BB* bb)
 	if (!CLG_(current_state).nonskipped) {
 	  last_bbcc->ecounter_sum++;
 	  last_bbcc->jmp[passed].ecounter++;
-	  if (!CLG_(clo).simulate_cache) {
+	  mark_dirty(last_bbcc);
+	  /* with sampled simulation, Ir of detail windows is counted by
+	   * the simulator calls */
+	  if (!CLG_(clo).simulate_cache ||
+	      (CLG_(sample_phase) != SAMPLE_DETAIL)) {
 	      /* update Ir cost */              
               UInt instr_count = last_bb->jmp[passed].instr+1;
               CLG_(current_state).cost[ fullOffset(EG_IR) ] += instr_count;
 	  }
+	  if (CLG_(clo).collect_mix)
+	      add_mix_cost(CLG_(current_state).cost, last_bb, passed);
+	  if (CLG_(clo).cost_model)
+	      add_cycle_cost(CLG_(current_state).cost, last_bb, passed);
 	}
 	else {
 	  /* do not increment exe counter of BBs in skipped functions, as it
 	   * would fool dumping code */
-	  if (!CLG_(clo).simulate_cache) {
+	  if (!CLG_(clo).simulate_cache ||
+	      (CLG_(sample_phase) != SAMPLE_DETAIL)) {
 	      /* update Ir cost */
               UInt instr_count = last_bb->jmp[passed].instr+1;
               CLG_(current_state).cost[ fullOffset(EG_IR) ] += instr_count;
               CLG_(current_state).nonskipped->skipped[ fullOffset(EG_IR) ]
 		+= instr_count;
 	  }
+	  if (CLG_(clo).collect_mix) {
+	      add_mix_cost(CLG_(current_state).cost, last_bb, passed);
+	      add_mix_cost(CLG_(current_state).nonskipped->skipped,
+			   last_bb, passed);
+	  }
+	  if (CLG_(clo).cost_model) {
+	      add_cycle_cost(CLG_(current_state).cost, last_bb, passed);
+	      add_cycle_cost(CLG_(current_state).nonskipped->skipped,
+			     last_bb, passed);
+	  }
 	}
       }
 
@@ -621,6 +653,16 @@ void CLG_(setup_bbcc)(BB* bb)
 	  CLG_(print_execstate)(-2, &CLG_(current_state) );
 	  CLG_(print_bbcc_cost)(-2, last_bbcc);
       }
+
+      /* instruction budget (--max-instructions) */
+      CLG_(instr_budget) -= last_bb->jmp[passed].instr+1;
+      if (UNLIKELY(CLG_(instr_budget) <= 0))
+	  CLG_(max_instructions_reached)();
+
+      /* phases of sampled simulation (--sample-period) */
+      CLG_(sample_left) -= last_bb->jmp[passed].instr+1;
+      if (UNLIKELY(CLG_(sample_left) <= 0))
+	  CLG_(sample_next_phase)();
   }
   else {
       jmpkind = jk_None;
@@ -843,6 +885,13 @@ void CLG_(setup_bbcc)(BB* bb)
     }
 
     idx = level -1;
+    if (!bbcc->rec_array[idx] && (idx > 0) &&
+	CLG_(context_memory_full)()) {
+      /* fold into first recursion level, for all further executions:
+       * the entry of a folded level points to the BBCC of level 1 */
+      CLG_(stat).folded_recursions++;
+      bbcc->rec_array[idx] = bbcc->rec_array[0];
+    }
     if (bbcc->rec_array[idx])
       bbcc = bbcc->rec_array[idx];
     else
@@ -903,4 +952,8 @@ void CLG_(setup_bbcc)(BB* bb)
   CLG_DEBUG(3,"\n");
   
   CLG_(stat).bb_executions++;
+
+  /* --live-stats */
+  if (UNLIKELY(CLG_(stat).bb_executions >= CLG_(live_next_update)))
+      CLG_(update_live_stats)();
 }
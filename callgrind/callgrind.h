@@ -78,7 +78,12 @@ typedef
       VG_USERREQ__TOGGLE_COLLECT,
       VG_USERREQ__DUMP_STATS_AT,
       VG_USERREQ__START_INSTRUMENTATION,
-      VG_USERREQ__STOP_INSTRUMENTATION
+      VG_USERREQ__STOP_INSTRUMENTATION,
+      VG_USERREQ__GET_COUNTERS,
+      VG_USERREQ__GET_EVENT_NAMES,
+      VG_USERREQ__REGION_BEGIN,
+      VG_USERREQ__REGION_END,
+      VG_USERREQ__GET_REGION_COUNTERS
    } Vg_CallgrindClientRequest;
 
 /* Dump current state of cost centers, and zero them afterwards */
@@ -126,4 +131,42 @@ typedef
   VALGRIND_DO_CLIENT_REQUEST_STMT(VG_USERREQ__STOP_INSTRUMENTATION,  \
                                   0, 0, 0, 0, 0)
 
+/* Read the event counters of the calling thread, summed up from the
+   start of the thread (not reset by CALLGRIND_ZERO_STATS), into the
+   array "buf" of "n" unsigned long long values. The order of events is
+   given by CALLGRIND_GET_EVENT_NAMES, starting with "Ir".
+   Returns the number of events collected, and 0 if not running on
+   Callgrind. Nothing is written to a file; this is cheap enough to be
+   used for timing inner loops of a benchmark from inside a program. */
+#define CALLGRIND_GET_COUNTERS(buf, n)                               \
+  (int)VALGRIND_DO_CLIENT_REQUEST_EXPR(0,                            \
+                                  VG_USERREQ__GET_COUNTERS,          \
+                                  buf, n, 0, 0, 0)
+
+/* Write the names of the events, separated by spaces, into the string
+   "buf" of size "size". Returns the number of events. */
+#define CALLGRIND_GET_EVENT_NAMES(buf, size)                         \
+  (int)VALGRIND_DO_CLIENT_REQUEST_EXPR(0,                            \
+                                  VG_USERREQ__GET_EVENT_NAMES,       \
+                                  buf, size, 0, 0, 0)
+
+/* Start a region of execution in the calling thread, identified by the
+   string "name". Regions can be nested. The counters of all executions
+   of a region are summed up per name, and printed at termination. */
+#define CALLGRIND_REGION_BEGIN(name)                                 \
+  VALGRIND_DO_CLIENT_REQUEST_STMT(VG_USERREQ__REGION_BEGIN,          \
+                                  name, 0, 0, 0, 0)
+
+/* End the innermost region "name" started in the calling thread */
+#define CALLGRIND_REGION_END(name)                                   \
+  VALGRIND_DO_CLIENT_REQUEST_STMT(VG_USERREQ__REGION_END,            \
+                                  name, 0, 0, 0, 0)
+
+/* Read the summed up counters of region "name", as with
+   CALLGRIND_GET_COUNTERS. Returns -1 if no such region was started. */
+#define CALLGRIND_GET_REGION_COUNTERS(name, buf, n)                  \
+  (int)VALGRIND_DO_CLIENT_REQUEST_EXPR(0,                            \
+                                  VG_USERREQ__GET_REGION_COUNTERS,   \
+                                  name, buf, n, 0, 0)
+
 #endif /* __CALLGRIND_H */
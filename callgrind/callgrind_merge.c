@@ -0,0 +1,1141 @@
+
+/*--------------------------------------------------------------------*/
+/*--- A program that merges multiple callgrind output files.       ---*/
+/*---                                            callgrind_merge.c ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Callgrind, a Valgrind tool for call tracing.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+/* Input files are read line by line, in the text format described in
+   the "Callgrind Format Specification" of the manual. Costs are summed
+   up per cost entry: a position of a function context, optionally with
+   the target of a call or jump. Name compression and subposition
+   compression are resolved while reading, so the memory needed only
+   depends on the number of distinct cost entries, not on the number or
+   size of the input files.
+
+   Input files are distributed among worker threads (-j), each summing
+   up into its own table. At the end, the tables are combined and the
+   entries are written sorted by object, file and function, such that
+   the output does not depend on the number of threads. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <pthread.h>
+
+typedef  signed long   Word;
+typedef  unsigned long UWord;
+typedef  unsigned char Bool;
+#define True ((Bool)1)
+#define False ((Bool)0)
+typedef  signed int    Int;
+typedef  unsigned int  UInt;
+typedef  unsigned long long int ULong;
+typedef  size_t        SizeT;
+
+static const char* argv0 = "callgrind_merge";
+static Bool verbose = False;
+
+/* Maximal number of subpositions: instr, bb, line */
+#define MAX_POS 3
+
+/* Name kinds; compression IDs are separate per kind */
+#define K_OB  0
+#define K_FL  1
+#define K_FN  2
+#define KINDS 3
+
+/* Kinds of cost entries */
+#define E_COST  0
+#define E_CALL  1
+#define E_JUMP  2
+#define E_JCND  3
+
+/* Unset/none value of name IDs */
+#define NONE  (-1)
+
+__attribute__((noreturn, format(printf, 1, 2)))
+static void fatal ( const char* format, ... )
+{
+   va_list vargs;
+
+   fprintf(stderr, "%s: ", argv0);
+   va_start(vargs, format);
+   vfprintf(stderr, format, vargs);
+   va_end(vargs);
+   fprintf(stderr, "\n");
+   exit(1);
+}
+
+static void* xmalloc ( SizeT size )
+{
+   void* p = malloc(size);
+   if (!p) fatal("out of memory");
+   return p;
+}
+
+static void* xrealloc ( void* p, SizeT size )
+{
+   p = realloc(p, size);
+   if (!p) fatal("out of memory");
+   return p;
+}
+
+static void* xcalloc ( SizeT n, SizeT size )
+{
+   void* p = calloc(n, size);
+   if (!p) fatal("out of memory");
+   return p;
+}
+
+
+/*------------------------------------------------------------*/
+/*--- Interned names, shared among worker threads          ---*/
+/*------------------------------------------------------------*/
+
+typedef struct _Str Str;
+struct _Str {
+   char* name;
+   Int   id;
+   Str*  next;
+};
+
+static pthread_mutex_t str_lock = PTHREAD_MUTEX_INITIALIZER;
+static Str**  str_bucket = 0;
+static UWord  str_buckets = 0;
+static Str**  strs = 0;     /* by ID */
+static Int    str_count = 0, str_size = 0;
+
+static UWord str_hash ( const char* s )
+{
+   UWord h = 5381;
+   while (*s) h = h * 33 + (unsigned char)*s++;
+   return h;
+}
+
+static void str_resize ( void )
+{
+   UWord i, n = str_buckets ? 2 * str_buckets : 4096;
+   Str** b = xcalloc(n, sizeof(Str*));
+   Str *s, *next;
+
+   for (i = 0; i < str_buckets; i++)
+      for (s = str_bucket[i]; s; s = next) {
+         UWord h = str_hash(s->name) & (n-1);
+         next = s->next;
+         s->next = b[h];
+         b[h] = s;
+      }
+   free(str_bucket);
+   str_bucket = b;
+   str_buckets = n;
+}
+
+/* ID of name <name>; IDs are given in order of first appearance,
+   which depends on thread scheduling. See rank_names() */
+static Int intern ( const char* name )
+{
+   Str* s;
+   UWord h;
+   Int id;
+
+   pthread_mutex_lock(&str_lock);
+   if ((UWord)str_count >= str_buckets) str_resize();
+   h = str_hash(name) & (str_buckets-1);
+   for (s = str_bucket[h]; s; s = s->next)
+      if (strcmp(s->name, name) == 0) break;
+   if (!s) {
+      s = xmalloc(sizeof(Str));
+      s->name = strdup(name);
+      if (!s->name) fatal("out of memory");
+      s->id = str_count++;
+      s->next = str_bucket[h];
+      str_bucket[h] = s;
+      if (s->id >= str_size) {
+         str_size = str_size ? 2 * str_size : 4096;
+         strs = xrealloc(strs, str_size * sizeof(Str*));
+      }
+      strs[s->id] = s;
+   }
+   id = s->id;
+   pthread_mutex_unlock(&str_lock);
+   return id;
+}
+
+
+/*------------------------------------------------------------*/
+/*--- Merged header information                            ---*/
+/*------------------------------------------------------------*/
+
+/* Union of event types of all input files, in order of appearance */
+static char** events = 0;
+static Int    event_count = 0;
+
+/* "event:" lines with long names, first definition of an event wins */
+static char** event_defs = 0;
+static Int    event_def_count = 0;
+
+/* From the first input file */
+static char*  positions = 0;
+static char*  cmd = 0;
+static char** descs = 0;
+static Int    desc_count = 0;
+
+/* Number of profile runs merged, including those of merged inputs */
+static Int    merged_count = 0;
+
+static Int    pos_count = 0;
+static Bool   pos_has_line[MAX_POS];
+
+static Int event_index ( const char* name )
+{
+   Int i;
+   for (i = 0; i < event_count; i++)
+      if (strcmp(events[i], name) == 0) return i;
+   return -1;
+}
+
+static void add_line ( char*** a, Int* n, const char* s )
+{
+   *a = xrealloc(*a, (*n + 1) * sizeof(char*));
+   (*a)[(*n)++] = strdup(s);
+}
+
+static char* skip_space ( char* p )
+{
+   while (*p == ' ' || *p == '\t') p++;
+   return p;
+}
+
+static void set_positions ( const char* file, const char* p )
+{
+   char *tok, *save, *buf;
+
+   while (*p == ' ' || *p == '\t') p++;
+   if (positions) {
+      if (strcmp(p, positions) != 0) {
+         fprintf(stderr, "%s: %s has 'positions: %s', but '%s' was "
+                 "used before\n", argv0, file, p, positions);
+         exit(1);
+      }
+      return;
+   }
+   positions = strdup(p);
+   /* strtok_r writes into the string it splits */
+   buf = strdup(p);
+   pos_count = 0;
+   for (tok = strtok_r(buf, " \t", &save); tok;
+        tok = strtok_r(0, " \t", &save)) {
+      if (pos_count == MAX_POS ||
+          (strcmp(tok, "instr") && strcmp(tok, "bb") &&
+           strcmp(tok, "line")))
+         fatal("unsupported 'positions: %s'", positions);
+      pos_has_line[pos_count++] = (strcmp(tok, "line") == 0);
+   }
+   free(buf);
+}
+
+static void add_events ( char* p )
+{
+   char *tok, *save;
+
+   for (tok = strtok_r(p, " \t", &save); tok;
+        tok = strtok_r(0, " \t", &save)) {
+      if (event_index(tok) >= 0) continue;
+      add_line(&events, &event_count, tok);
+   }
+}
+
+static void add_event_def ( char* line )
+{
+   char *p = skip_space(line + 6), *e = p;
+   Int i, len;
+
+   while (*e && !isspace((unsigned char)*e) && *e != ':' && *e != '=') e++;
+   len = e - p;
+   for (i = 0; i < event_def_count; i++) {
+      char* q = skip_space(event_defs[i] + 6);
+      if (strncmp(q, p, len) == 0 &&
+          (q[len] == 0 || isspace((unsigned char)q[len]) ||
+           q[len] == ':' || q[len] == '='))
+         return;
+   }
+   add_line(&event_defs, &event_def_count, line);
+}
+
+static void chomp ( char* line, ssize_t len )
+{
+   while (len > 0 && (line[len-1] == '\n' || line[len-1] == '\r'))
+      line[--len] = 0;
+}
+
+/* Body lines start with a position or a "key=" */
+static Bool is_body_line ( const char* line )
+{
+   const char* p = line;
+
+   if (isdigit((unsigned char)*p) || *p == '+' || *p == '-' || *p == '*')
+      return True;
+   while (islower((unsigned char)*p)) p++;
+   return (p > line && *p == '=');
+}
+
+/* Read the header of <file>, to get the union of event types before
+   any cost is summed up. Only the first file gives "cmd:" and "desc:" */
+static void scan_header ( const char* file, Bool first )
+{
+   FILE* fp = fopen(file, "r");
+   char* line = 0;
+   SizeT cap = 0;
+   ssize_t len;
+   Bool first_line = True;
+   Int merged = 1;
+
+   if (!fp) {
+      perror(file);
+      exit(1);
+   }
+   while ((len = getline(&line, &cap, fp)) >= 0) {
+      chomp(line, len);
+      if (first_line && strncmp(line, "callgrind-binary:", 17) == 0) {
+         fprintf(stderr, "%s: %s is in binary format, convert it with "
+                 "callgrind_convert first\n", argv0, file);
+         exit(1);
+      }
+      first_line = False;
+      if (is_body_line(line)) break;
+
+      if (strncmp(line, "positions:", 10) == 0)
+         set_positions(file, line + 10);
+      else if (strncmp(line, "events:", 7) == 0)
+         add_events(line + 7);
+      else if (strncmp(line, "event:", 6) == 0)
+         add_event_def(line);
+      else if (strncmp(line, "base:", 5) == 0)
+         fprintf(stderr, "%s: warning: %s is a delta dump, costs are "
+                 "merged as given\n", argv0, file);
+      else if (sscanf(line, "desc: Merged: %d files", &merged) == 1)
+         continue;
+      else if (!first) continue;
+      else if (strncmp(line, "cmd:", 4) == 0) {
+         if (!cmd) cmd = strdup(skip_space(line + 4));
+      }
+      else if (strncmp(line, "desc:", 5) == 0)
+         add_line(&descs, &desc_count, line);
+   }
+   if (!positions) set_positions(file, "line");
+   merged_count += merged;
+   free(line);
+   fclose(fp);
+}
+
+
+/*------------------------------------------------------------*/
+/*--- Cost entries                                         ---*/
+/*------------------------------------------------------------*/
+
+/* Key of a cost entry. Names are interned IDs. For calls, the target
+   is cob/cfi/cfn, for jumps jfi/jfn (cob is the object itself). */
+typedef struct {
+   Int   ob, fl, fn, rec, cxt;
+   Int   fi;
+   Int   kind;
+   Int   cob, cfi, cfn;
+   ULong pos[MAX_POS];
+   ULong tpos[MAX_POS];
+} Key;
+
+typedef struct _Entry Entry;
+struct _Entry {
+   Key    k;
+   Entry* next;
+   ULong  count;     /* calls/jumps, or followed conditional jumps */
+   ULong  execs;     /* executed conditional jumps */
+   ULong  cost[0];   /* event_count costs */
+};
+
+#define CHUNK_SIZE (1024*1024)
+
+typedef struct _Chunk Chunk;
+struct _Chunk {
+   Chunk* next;
+   ULong  data[0];
+};
+
+/* One table per worker thread */
+typedef struct {
+   Entry** bucket;
+   UWord   buckets, entries;
+   Chunk*  chunks;
+   char   *cur, *end;
+} Table;
+
+static SizeT entry_size ( void )
+{
+   return sizeof(Entry) + event_count * sizeof(ULong);
+}
+
+static Entry* new_entry ( Table* t )
+{
+   SizeT size = entry_size();
+   Entry* e;
+
+   if (t->cur + size > t->end) {
+      SizeT csize = (size > CHUNK_SIZE) ? size : CHUNK_SIZE;
+      Chunk* c = xmalloc(sizeof(Chunk) + csize);
+      c->next = t->chunks;
+      t->chunks = c;
+      t->cur = (char*) c->data;
+      t->end = t->cur + csize;
+   }
+   e = (Entry*) t->cur;
+   t->cur += size;
+   memset(e, 0, size);
+   return e;
+}
+
+static UWord key_hash ( const Key* k )
+{
+   const UInt* w = (const UInt*) k;
+   UWord h = 0;
+   UInt i;
+
+   for (i = 0; i < sizeof(Key) / sizeof(UInt); i++)
+      h = h * 31 + w[i];
+   return h ^ (h >> 17);
+}
+
+static void table_resize ( Table* t )
+{
+   UWord i, n = t->buckets ? 2 * t->buckets : 65536;
+   Entry** b = xcalloc(n, sizeof(Entry*));
+   Entry *e, *next;
+
+   for (i = 0; i < t->buckets; i++)
+      for (e = t->bucket[i]; e; e = next) {
+         UWord h = key_hash(&e->k) & (n-1);
+         next = e->next;
+         e->next = b[h];
+         b[h] = e;
+      }
+   free(t->bucket);
+   t->bucket = b;
+   t->buckets = n;
+}
+
+/* Entry for <k> in <t>; a new one is taken from <e> if given */
+static Entry* lookup ( Table* t, const Key* k, Entry* e )
+{
+   Entry* f;
+   UWord h;
+
+   if (t->entries >= t->buckets) table_resize(t);
+   h = key_hash(k) & (t->buckets-1);
+   for (f = t->bucket[h]; f; f = f->next)
+      if (memcmp(&f->k, k, sizeof(Key)) == 0) return f;
+
+   if (!e) {
+      e = new_entry(t);
+      e->k = *k;
+   }
+   e->next = t->bucket[h];
+   t->bucket[h] = e;
+   t->entries++;
+   return e;
+}
+
+/* Move all entries of <src> into <dst> */
+static void combine ( Table* dst, Table* src )
+{
+   Entry *e, *f, *next;
+   UWord i;
+   Int j;
+
+   for (i = 0; i < src->buckets; i++)
+      for (e = src->bucket[i]; e; e = next) {
+         next = e->next;
+         f = lookup(dst, &e->k, e);
+         if (f == e) continue;
+         f->count += e->count;
+         f->execs += e->execs;
+         for (j = 0; j < event_count; j++)
+            f->cost[j] += e->cost[j];
+      }
+   free(src->bucket);
+   src->bucket = 0;
+   src->buckets = src->entries = 0;
+}
+
+
+/*------------------------------------------------------------*/
+/*--- Parsing of one input file                            ---*/
+/*------------------------------------------------------------*/
+
+typedef struct {
+   const char* file;
+   UInt        lno;
+   Table*      t;
+
+   /* compression ID => interned name, per kind */
+   Int*  map[KINDS];
+   Int   map_size[KINDS];
+
+   /* event column => merged event index */
+   Int*  col;
+   Int   col_count;
+
+   /* current state */
+   Int   ob, fl, fi, fn, rec, cxt;
+   Int   cob, cfi, cfn, jfi, jfn;
+   Int   pending;
+   ULong count, execs;
+   ULong tpos[MAX_POS];
+   ULong last[MAX_POS];
+} Input;
+
+static Int unknown = NONE;     /* ID of "???" */
+static Int spontaneous = NONE; /* ID of "(spontaneous)" */
+
+__attribute__((noreturn))
+static void parse_error ( Input* in, const char* msg )
+{
+   fprintf(stderr, "%s: parse error: %s\n", argv0, msg);
+   fprintf(stderr, "%s: near %s line %u\n", argv0, in->file, in->lno);
+   exit(1);
+}
+
+/* Name given as "(id) name", "(id)" or "name" */
+static Int parse_name ( Input* in, Int kind, char* p )
+{
+   char* e;
+   long id;
+   Int i, name;
+
+   p = skip_space(p);
+   if (*p != '(' || !isdigit((unsigned char)p[1]))
+      return intern(p);
+
+   id = strtol(p+1, &e, 10);
+   if (*e != ')' || id < 0 || id > 0x7fffffff)
+      parse_error(in, "bad name compression");
+   e = skip_space(e+1);
+
+   if (*e == 0) {
+      if (id >= in->map_size[kind] || in->map[kind][id] == NONE)
+         parse_error(in, "undefined name compression");
+      return in->map[kind][id];
+   }
+
+   name = intern(e);
+   if (id >= in->map_size[kind]) {
+      Int n = in->map_size[kind] ? in->map_size[kind] : 256;
+      while (n <= id) n *= 2;
+      in->map[kind] = xrealloc(in->map[kind], n * sizeof(Int));
+      for (i = in->map_size[kind]; i < n; i++)
+         in->map[kind][i] = NONE;
+      in->map_size[kind] = n;
+   }
+   in->map[kind][id] = name;
+   return name;
+}
+
+static void set_columns ( Input* in, char* p )
+{
+   char *tok, *save;
+
+   in->col_count = 0;
+   for (tok = strtok_r(p, " \t", &save); tok;
+        tok = strtok_r(0, " \t", &save)) {
+      Int i = event_index(tok);
+      if (i < 0)
+         parse_error(in, "event type not given in the file header");
+      in->col = xrealloc(in->col, (in->col_count + 1) * sizeof(Int));
+      in->col[in->col_count++] = i;
+   }
+}
+
+static ULong parse_number ( Input* in, char** pp )
+{
+   char *p = *pp, *e;
+   ULong v;
+
+   if (p[0] == '0' && p[1] == 'x')
+      v = strtoull(p+2, &e, 16);
+   else
+      v = strtoull(p, &e, 10);
+   if (e == p || (*e && !isspace((unsigned char)*e) && *e != '/'))
+      parse_error(in, "bad number");
+   *pp = e;
+   return v;
+}
+
+/* Subpositions may be given relative to the last cost line */
+static void parse_pos ( Input* in, char** pp, ULong* pos )
+{
+   char* p;
+   Int i;
+
+   for (i = 0; i < pos_count; i++) {
+      p = skip_space(*pp);
+      if (*p == '*') {
+         pos[i] = in->last[i];
+         p++;
+      }
+      else if (*p == '+') {
+         p++;
+         pos[i] = in->last[i] + parse_number(in, &p);
+      }
+      else if (*p == '-') {
+         p++;
+         pos[i] = in->last[i] - parse_number(in, &p);
+      }
+      else if (isdigit((unsigned char)*p))
+         pos[i] = parse_number(in, &p);
+      else
+         parse_error(in, "missing position");
+      *pp = p;
+   }
+}
+
+/* A cost line. For calls and jumps, this gives the source position */
+static void cost_line ( Input* in, char* p )
+{
+   Key k;
+   Entry* e;
+   Int i;
+
+   memset(&k, 0, sizeof(Key));
+   k.ob   = in->ob;
+   k.fl   = in->fl;
+   k.fn   = in->fn;
+   k.rec  = in->rec;
+   k.cxt  = in->cxt;
+   k.fi   = in->fi;
+   k.kind = in->pending;
+   k.cob  = NONE;
+   k.cfi  = NONE;
+   k.cfn  = NONE;
+   parse_pos(in, &p, k.pos);
+
+   if (in->pending == E_CALL) {
+      k.cob = (in->cob != NONE) ? in->cob : in->ob;
+      k.cfi = (in->cfi != NONE) ? in->cfi : in->fi;
+      k.cfn = in->cfn;
+   }
+   else if (in->pending != E_COST) {
+      k.cob = in->ob;
+      k.cfi = (in->jfi != NONE) ? in->jfi : in->fi;
+      k.cfn = (in->jfn != NONE) ? in->jfn : in->fn;
+   }
+   if (in->pending != E_COST)
+      memcpy(k.tpos, in->tpos, sizeof(k.tpos));
+
+   e = lookup(in->t, &k, 0);
+   e->count += in->count;
+   e->execs += in->execs;
+
+   for (i = 0; i < in->col_count; i++) {
+      p = skip_space(p);
+      if (*p == 0) break;
+      e->cost[in->col[i]] += parse_number(in, &p);
+   }
+   if (*skip_space(p))
+      parse_error(in, "too many costs");
+
+   memcpy(in->last, k.pos, sizeof(k.pos));
+   if (in->pending == E_CALL) {
+      in->cob = NONE;
+      in->cfi = NONE;
+   }
+   else if (in->pending != E_COST) {
+      in->jfi = NONE;
+      in->jfn = NONE;
+   }
+   in->pending = E_COST;
+   in->count = in->execs = 0;
+}
+
+/* "calls=", "jump=" or "jcnd=" line, followed by a cost line */
+static void call_line ( Input* in, Int kind, char* p )
+{
+   if (in->pending != E_COST)
+      parse_error(in, "missing cost line after call or jump");
+   if (kind == E_CALL && in->cfn == NONE)
+      parse_error(in, "calls= without cfn=");
+
+   in->count = parse_number(in, &p);
+   in->execs = 0;
+   if (kind == E_JCND) {
+      p = skip_space(p);
+      if (*p == '/') p++;
+      in->execs = parse_number(in, &p);
+   }
+   parse_pos(in, &p, in->tpos);
+   in->pending = kind;
+}
+
+static Bool is_key ( const char* line, const char* key, char** value )
+{
+   SizeT len = strlen(key);
+
+   if (strncmp(line, key, len) != 0) return False;
+   *value = (char*) line + len;
+   return True;
+}
+
+static void parse_file ( Table* t, const char* file )
+{
+   FILE* fp = fopen(file, "r");
+   char *line = 0, *v;
+   SizeT cap = 0;
+   ssize_t len;
+   Input in;
+   Int i;
+
+   if (!fp) {
+      perror(file);
+      exit(1);
+   }
+   if (verbose)
+      fprintf(stderr, "%s: parsing %s\n", argv0, file);
+
+   memset(&in, 0, sizeof(in));
+   in.file = file;
+   in.t    = t;
+   in.ob   = in.fl = in.fi = in.fn = unknown;
+   in.cxt  = NONE;
+   in.cob  = in.cfi = in.cfn = in.jfi = in.jfn = NONE;
+   in.pending = E_COST;
+
+   while ((len = getline(&line, &cap, fp)) >= 0) {
+      in.lno++;
+      chomp(line, len);
+
+      if (line[0] == 0 || line[0] == '#')
+         continue;
+      if (isdigit((unsigned char)line[0]) || line[0] == '+' ||
+          line[0] == '-' || line[0] == '*') {
+         cost_line(&in, line);
+         continue;
+      }
+      if (in.pending != E_COST)
+         parse_error(&in, "missing cost line after call or jump");
+
+      if (is_key(line, "fn=", &v)) {
+         in.fn = parse_name(&in, K_FN, v);
+         in.fl = in.fi;
+      }
+      else if (is_key(line, "fl=", &v))
+         in.fl = in.fi = parse_name(&in, K_FL, v);
+      else if (is_key(line, "fi=", &v) || is_key(line, "fe=", &v))
+         in.fi = parse_name(&in, K_FL, v);
+      else if (is_key(line, "ob=", &v))
+         in.ob = parse_name(&in, K_OB, v);
+      else if (is_key(line, "cob=", &v))
+         in.cob = parse_name(&in, K_OB, v);
+      else if (is_key(line, "cfi=", &v) || is_key(line, "cfl=", &v))
+         in.cfi = parse_name(&in, K_FL, v);
+      else if (is_key(line, "cfn=", &v))
+         in.cfn = parse_name(&in, K_FN, v);
+      else if (is_key(line, "jfi=", &v))
+         in.jfi = parse_name(&in, K_FL, v);
+      else if (is_key(line, "jfn=", &v))
+         in.jfn = parse_name(&in, K_FN, v);
+      else if (is_key(line, "frfn=", &v)) {
+         in.cxt = parse_name(&in, K_FN, v);
+         if (in.cxt == spontaneous) in.cxt = NONE;
+      }
+      else if (is_key(line, "rec=", &v))
+         in.rec = atoi(v);
+      else if (is_key(line, "calls=", &v))
+         call_line(&in, E_CALL, v);
+      else if (is_key(line, "jump=", &v))
+         call_line(&in, E_JUMP, v);
+      else if (is_key(line, "jcnd=", &v))
+         call_line(&in, E_JCND, v);
+      else if (is_key(line, "events:", &v))
+         set_columns(&in, v);
+      else if (is_key(line, "positions:", &v))
+         set_positions(file, v);
+      else if (is_key(line, "ln=", &v) ||
+               is_key(line, "summary:", &v) ||
+               is_key(line, "totals:", &v) ||
+               strchr(line, ':')) {
+         /* summary and totals are recalculated, other header lines
+            were taken from the first file by scan_header() */
+      }
+      else
+         fprintf(stderr, "%s: warning: %s line %u malformed, ignoring\n",
+                 argv0, file, in.lno);
+   }
+   if (in.pending != E_COST)
+      parse_error(&in, "missing cost line after call or jump");
+
+   for (i = 0; i < KINDS; i++)
+      free(in.map[i]);
+   free(in.col);
+   free(line);
+   fclose(fp);
+}
+
+
+/*------------------------------------------------------------*/
+/*--- Worker threads                                       ---*/
+/*------------------------------------------------------------*/
+
+static char** files = 0;
+static Int    file_count = 0;
+static Int    next_file = 0;
+static pthread_mutex_t file_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void* worker ( void* arg )
+{
+   Table* t = (Table*) arg;
+   Int i;
+
+   while (1) {
+      pthread_mutex_lock(&file_lock);
+      i = next_file++;
+      pthread_mutex_unlock(&file_lock);
+      if (i >= file_count) break;
+      parse_file(t, files[i]);
+   }
+   return 0;
+}
+
+
+/*------------------------------------------------------------*/
+/*--- Output                                               ---*/
+/*------------------------------------------------------------*/
+
+/* Names are sorted by rank, to not depend on the order of interning */
+static Int* rank = 0;
+
+static int cmp_str ( const void* a, const void* b )
+{
+   return strcmp((*(Str* const*)a)->name, (*(Str* const*)b)->name);
+}
+
+static void rank_names ( void )
+{
+   Str** s = xmalloc(str_count * sizeof(Str*));
+   Int i;
+
+   memcpy(s, strs, str_count * sizeof(Str*));
+   qsort(s, str_count, sizeof(Str*), cmp_str);
+   rank = xmalloc(str_count * sizeof(Int));
+   for (i = 0; i < str_count; i++)
+      rank[s[i]->id] = i;
+   free(s);
+}
+
+#define CMP(a,b) if ((a) != (b)) return ((a) < (b)) ? -1 : 1
+#define CMP_NAME(a,b) \
+   CMP(((a) == NONE) ? -1 : rank[a], ((b) == NONE) ? -1 : rank[b])
+
+static int cmp_entry ( const void* pa, const void* pb )
+{
+   const Key* a = &(*(Entry* const*)pa)->k;
+   const Key* b = &(*(Entry* const*)pb)->k;
+   Int i;
+
+   CMP_NAME(a->ob, b->ob);
+   CMP_NAME(a->fl, b->fl);
+   CMP_NAME(a->fn, b->fn);
+   CMP(a->rec, b->rec);
+   CMP_NAME(a->cxt, b->cxt);
+   CMP_NAME(a->fi, b->fi);
+   for (i = 0; i < pos_count; i++)
+      CMP(a->pos[i], b->pos[i]);
+   CMP(a->kind, b->kind);
+   CMP_NAME(a->cob, b->cob);
+   CMP_NAME(a->cfi, b->cfi);
+   CMP_NAME(a->cfn, b->cfn);
+   for (i = 0; i < pos_count; i++)
+      CMP(a->tpos[i], b->tpos[i]);
+   return 0;
+}
+
+/* Compression IDs of the output, per kind; 0 if not yet written */
+static Int* out_id[KINDS];
+static Int  out_next[KINDS];
+
+static void write_name ( FILE* out, const char* key, Int kind, Int id )
+{
+   if (out_id[kind][id]) {
+      fprintf(out, "%s=(%d)\n", key, out_id[kind][id]);
+      return;
+   }
+   out_id[kind][id] = ++out_next[kind];
+   fprintf(out, "%s=(%d) %s\n", key, out_id[kind][id], strs[id]->name);
+}
+
+/* Positions are written compressed relative to <last>, as done by
+   Callgrind, but only within a function. Targets of calls and jumps
+   are written absolute. */
+static void write_pos ( FILE* out, const ULong* pos, ULong* last )
+{
+   Int i;
+
+   for (i = 0; i < pos_count; i++) {
+      if (last && last[i] > 0 &&
+          pos[i] < last[i] + 100 && pos[i] + 100 > last[i]) {
+         if (pos[i] > last[i])
+            fprintf(out, "+%llu ", pos[i] - last[i]);
+         else if (pos[i] == last[i])
+            fprintf(out, "* ");
+         else
+            fprintf(out, "-%llu ", last[i] - pos[i]);
+      }
+      else if (pos_has_line[i])
+         fprintf(out, "%llu ", pos[i]);
+      else
+         fprintf(out, "0x%llx ", pos[i]);
+      if (last) last[i] = pos[i];
+   }
+}
+
+static void write_costs ( FILE* out, const ULong* cost )
+{
+   Int i, n = event_count;
+
+   while (n > 0 && cost[n-1] == 0) n--;
+   for (i = 0; i < n; i++)
+      fprintf(out, (i > 0) ? " %llu" : "%llu", cost[i]);
+   fprintf(out, "\n");
+}
+
+static void write_total_line ( FILE* out, const char* key,
+                               const ULong* cost )
+{
+   Int i;
+
+   fprintf(out, "%s:", key);
+   for (i = 0; i < event_count; i++)
+      fprintf(out, " %llu", cost[i]);
+   fprintf(out, "\n");
+}
+
+static void write_output ( FILE* out, Table* t )
+{
+   Entry **all, *e;
+   ULong* totals = xcalloc(event_count, sizeof(ULong));
+   ULong last[MAX_POS];
+   Int ob = NONE, fl = NONE, fi = NONE, fn = NONE, rec = 0, cxt = NONE;
+   UWord i, n = 0;
+   Int j;
+
+   all = xmalloc((t->entries + 1) * sizeof(Entry*));
+   for (i = 0; i < t->buckets; i++)
+      for (e = t->bucket[i]; e; e = e->next)
+         all[n++] = e;
+   rank_names();
+   qsort(all, n, sizeof(Entry*), cmp_entry);
+
+   for (i = 0; i < n; i++)
+      if (all[i]->k.kind == E_COST)
+         for (j = 0; j < event_count; j++)
+            totals[j] += all[i]->cost[j];
+
+   for (j = 0; j < KINDS; j++)
+      out_id[j] = xcalloc(str_count, sizeof(Int));
+
+   fprintf(out, "version: 1\ncreator: callgrind_merge\n");
+   if (cmd) fprintf(out, "cmd: %s\n", cmd);
+   fprintf(out, "\n");
+   for (j = 0; j < desc_count; j++)
+      fprintf(out, "%s\n", descs[j]);
+   fprintf(out, "desc: Merged: %d files\n", merged_count);
+   fprintf(out, "\npositions: %s\n", positions);
+   for (j = 0; j < event_def_count; j++)
+      fprintf(out, "%s\n", event_defs[j]);
+   fprintf(out, "events:");
+   for (j = 0; j < event_count; j++)
+      fprintf(out, " %s", events[j]);
+   fprintf(out, "\n");
+   write_total_line(out, "summary", totals);
+   fprintf(out, "\n");
+
+   memset(last, 0, sizeof(last));
+   for (i = 0; i < n; i++) {
+      Key* k = &all[i]->k;
+
+      if (k->ob != ob || k->fl != fl || k->fn != fn ||
+          k->rec != rec || k->cxt != cxt) {
+         fprintf(out, "\n");
+         memset(last, 0, sizeof(last));
+         if (k->rec != rec) {
+            fprintf(out, "rec=%d\n", k->rec);
+            rec = k->rec;
+         }
+         if (k->cxt != cxt) {
+            if (k->cxt == NONE)
+               fprintf(out, "frfn=(spontaneous)\n");
+            else
+               write_name(out, "frfn", K_FN, k->cxt);
+            cxt = k->cxt;
+         }
+         if (k->ob != ob) {
+            write_name(out, "ob", K_OB, k->ob);
+            ob = k->ob;
+         }
+         if (k->fl != fl || fi != fl) {
+            write_name(out, "fl", K_FL, k->fl);
+            fl = fi = k->fl;
+         }
+         write_name(out, "fn", K_FN, k->fn);
+         fn = k->fn;
+      }
+      if (k->fi != fi) {
+         write_name(out, (k->fi == fl) ? "fe" : "fi", K_FL, k->fi);
+         fi = k->fi;
+      }
+
+      switch (k->kind) {
+      case E_CALL:
+         if (k->cob != ob) write_name(out, "cob", K_OB, k->cob);
+         if (k->cfi != fi) write_name(out, "cfi", K_FL, k->cfi);
+         write_name(out, "cfn", K_FN, k->cfn);
+         fprintf(out, "calls=%llu ", all[i]->count);
+         write_pos(out, k->tpos, 0);
+         fprintf(out, "\n");
+         break;
+      case E_JUMP:
+      case E_JCND:
+         if (k->cfi != fi) write_name(out, "jfi", K_FL, k->cfi);
+         if (k->cfn != fn) write_name(out, "jfn", K_FN, k->cfn);
+         if (k->kind == E_JUMP)
+            fprintf(out, "jump=%llu ", all[i]->count);
+         else
+            fprintf(out, "jcnd=%llu/%llu ", all[i]->count, all[i]->execs);
+         write_pos(out, k->tpos, 0);
+         fprintf(out, "\n");
+         break;
+      default:
+         break;
+      }
+
+      write_pos(out, k->pos, last);
+      if (k->kind == E_JUMP || k->kind == E_JCND)
+         fprintf(out, "\n");
+      else
+         write_costs(out, all[i]->cost);
+   }
+
+   fprintf(out, "\n");
+   write_total_line(out, "totals", totals);
+   free(all);
+   free(totals);
+}
+
+
+/*------------------------------------------------------------*/
+/*--- main                                                 ---*/
+/*------------------------------------------------------------*/
+
+static void usage ( void )
+{
+   fprintf(stderr, "%s: Merges multiple callgrind output files into one\n",
+                   argv0);
+   fprintf(stderr, "%s: usage: %s [-v] [-j threads] [-o outfile] "
+                   "[files-to-merge]\n", argv0, argv0);
+   exit(1);
+}
+
+int main ( int argc, char** argv )
+{
+   const char* outfilename = 0;
+   Table* tables;
+   pthread_t* threads;
+   FILE* out;
+   long jobs = 0;
+   Int i;
+
+   if (argc > 0)
+      argv0 = argv[0];
+   files = xmalloc(argc * sizeof(char*));
+
+   for (i = 1; i < argc; i++) {
+      if (strcmp(argv[i], "-o") == 0 && i+1 < argc)
+         outfilename = argv[++i];
+      else if (strcmp(argv[i], "-j") == 0 && i+1 < argc) {
+         jobs = atol(argv[++i]);
+         if (jobs < 1) usage();
+      }
+      else if (strcmp(argv[i], "-v") == 0)
+         verbose = True;
+      else if (argv[i][0] == '-')
+         usage();
+      else
+         files[file_count++] = argv[i];
+   }
+   if (file_count == 0)
+      usage();
+
+   if (jobs == 0) {
+      jobs = sysconf(_SC_NPROCESSORS_ONLN);
+      if (jobs < 1) jobs = 1;
+   }
+   if (jobs > file_count) jobs = file_count;
+
+   for (i = 0; i < file_count; i++)
+      scan_header(files[i], i == 0);
+   if (event_count == 0)
+      fatal("no 'events:' line found in %s", files[0]);
+
+   unknown = intern("???");
+   spontaneous = intern("(spontaneous)");
+
+   tables  = xcalloc(jobs, sizeof(Table));
+   threads = xcalloc(jobs, sizeof(pthread_t));
+   for (i = 1; i < jobs; i++)
+      if (pthread_create(&threads[i], 0, worker, &tables[i]) != 0)
+         fatal("can not create thread");
+   worker(&tables[0]);
+   for (i = 1; i < jobs; i++) {
+      pthread_join(threads[i], 0);
+      combine(&tables[0], &tables[i]);
+   }
+
+   if (verbose)
+      fprintf(stderr, "%s: writing %s\n",
+                      argv0, outfilename ? outfilename : "(stdout)");
+   out = outfilename ? fopen(outfilename, "w") : stdout;
+   if (!out) {
+      perror(outfilename);
+      exit(1);
+   }
+   write_output(out, &tables[0]);
+   if (ferror(out) || (out != stdout && fclose(out) != 0)) {
+      perror(outfilename ? outfilename : "(stdout)");
+      exit(1);
+   }
+   return 0;
+}
+
+/*--------------------------------------------------------------------*/
+/*--- end                                        callgrind_merge.c ---*/
+/*--------------------------------------------------------------------*/
@@ -263,8 +263,7 @@ void CLG_(push_call_stack)(BBCC* from, UInt jmp, BBCC* to, Addr sp, Bool skip)
 	/* a call from nonskipped to skipped */
 	CLG_(current_state).nonskipped = from;
 	if (!CLG_(current_state).nonskipped->skipped) {
-	  CLG_(init_cost_lz)( CLG_(sets).full,
-			     &CLG_(current_state).nonskipped->skipped);
+	  CLG_(init_skipped_cost)( CLG_(current_state).nonskipped );
 	  CLG_(stat).distinct_skips++;
 	}
     }
@@ -352,6 +351,7 @@ void CLG_(pop_call_stack)()
 	   * the ret_counter is used to check if a BBCC dump is needed.
 	   */
 	  jcc->from->ret_counter++;
+	  CLG_(mark_dirty_bbcc)(jcc->from);
 	}
 	CLG_(stat).ret_counter++;
 
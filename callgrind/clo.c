@@ -418,9 +418,16 @@ Bool CLG_(process_cmd_line_option)(const HChar* arg)
 
    else if VG_BOOL_CLO(arg, "--combine-dumps", CLG_(clo).combine_dumps) {}
 
+   else if VG_BOOL_CLO(arg, "--async-dump", CLG_(clo).async_dump) {}
+   else if VG_BOOL_CLO(arg, "--delta-dumps", CLG_(clo).delta_dumps) {}
+   else if VG_BOOL_CLO(arg, "--live-stats", CLG_(clo).live_stats) {}
+   else if VG_BOOL_CLO(arg, "--dump-index", CLG_(clo).dump_index) {}
+
    else if VG_BOOL_CLO(arg, "--collect-atstart", CLG_(clo).collect_atstart) {}
 
    else if VG_BOOL_CLO(arg, "--instr-atstart", CLG_(clo).instrument_atstart) {}
+   else if VG_BOOL_CLO(arg, "--fast-instr-toggle",
+                            CLG_(clo).fast_instr_toggle) {}
 
    else if VG_BOOL_CLO(arg, "--separate-threads", CLG_(clo).separate_threads) {}
 
@@ -501,6 +508,21 @@ Bool CLG_(process_cmd_line_option)(const HChar* arg)
        fnc->separate_callers = n;
    }
 
+   else if VG_STR_CLO(arg, "--max-context-memory", tmp_str) {
+       HChar* s;
+       ULong n = VG_(strtoll10)(tmp_str, &s);
+       switch(*s) {
+       case 'k': case 'K': n <<= 10; s++; break;
+       case 'm': case 'M': n <<= 20; s++; break;
+       case 'g': case 'G': n <<= 30; s++; break;
+       default: break;
+       }
+       if ((s == tmp_str) || *s)
+	   VG_(fmsg_bad_option)(arg,
+               "expected --max-context-memory=<number>[k|m|g]\n");
+       CLG_(clo).max_context_memory = n;
+   }
+
    else if VG_STREQN(15, arg, "--separate-recs") {
        fn_config* fnc;
        HChar* s;
@@ -512,6 +534,15 @@ Bool CLG_(process_cmd_line_option)(const HChar* arg)
 
    else if VG_STR_CLO(arg, "--callgrind-out-file", CLG_(clo).out_format) {}
 
+   else if VG_STR_CLO(arg, "--out-format", tmp_str) {
+       if (VG_(strcmp)(tmp_str, "text") == 0)
+	   CLG_(clo).binary_format = False;
+       else if (VG_(strcmp)(tmp_str, "binary") == 0)
+	   CLG_(clo).binary_format = True;
+       else
+	   VG_(fmsg_bad_option)(arg, "expected --out-format=text|binary\n");
+   }
+
    else if VG_BOOL_CLO(arg, "--mangle-names", CLG_(clo).mangle_names) {}
 
    else if VG_BOOL_CLO(arg, "--skip-direct-rec",
@@ -523,17 +554,32 @@ Bool CLG_(process_cmd_line_option)(const HChar* arg)
    else if VG_BOOL_CLO(arg, "--dump-bb",    CLG_(clo).dump_bb) {}
 
    else if VG_INT_CLO( arg, "--dump-every-bb", CLG_(clo).dump_every_bb) {}
+   else if VG_BINT_CLO(arg, "--max-instructions",
+                       CLG_(clo).max_instructions, 0, 0x7FFFFFFFFFFFFFFFLL) {}
 
    else if VG_BOOL_CLO(arg, "--collect-alloc",   CLG_(clo).collect_alloc) {}
    else if VG_BOOL_CLO(arg, "--collect-systime", CLG_(clo).collect_systime) {}
    else if VG_BOOL_CLO(arg, "--collect-bus",     CLG_(clo).collect_bus) {}
+   else if VG_BOOL_CLO(arg, "--collect-mix",     CLG_(clo).collect_mix) {}
+   else if VG_STR_CLO(arg,  "--cost-model",      CLG_(clo).cost_model) {}
    /* for option compatibility with cachegrind */
    else if VG_BOOL_CLO(arg, "--cache-sim",       CLG_(clo).simulate_cache) {}
    /* compatibility alias, deprecated option */
    else if VG_BOOL_CLO(arg, "--simulate-cache",  CLG_(clo).simulate_cache) {}
    /* for option compatibility with cachegrind */
    else if VG_BOOL_CLO(arg, "--branch-sim",      CLG_(clo).simulate_branch) {}
+   else if VG_BOOL_CLO(arg, "--count-only",      CLG_(clo).count_only) {}
+   else if VG_BOOL_CLO(arg, "--release-at-instr-off",
+                       CLG_(clo).release_at_instr_off) {}
    else if VG_BOOL_CLO(arg, "--collect-openclose", CLG_(clo).collect_openclose) {}
+   else if VG_STR_CLO(arg, "--collect-openfile", CLG_(clo).collect_openfile) {}
+   else if VG_STR_CLO(arg, "--collect-closefile", CLG_(clo).collect_closefile) {}
+   else if VG_STR_CLO(arg, "--collect-window", tmp_str) {
+       if (!CLG_(add_collect_window)(tmp_str))
+	   VG_(fmsg_bad_option)(arg,
+               "expected --collect-window=<name>:open=<file>,close=<file>"
+               " with a unique name\n");
+   }
    else {
        Bool isCachesimOption = (*CLG_(cachesim).parse_opt)(arg);
 
@@ -552,11 +598,16 @@ void CLG_(print_usage)(void)
    VG_(printf)(
 "\n   dump creation options:\n"
 "    --callgrind-out-file=<f>  Output file name [callgrind.out.%%p]\n"
+"    --out-format=text|binary  Format of profile dump [text]\n"
 "    --dump-line=no|yes        Dump source lines of costs? [yes]\n"
 "    --dump-instr=no|yes       Dump instruction address of costs? [no]\n"
 "    --compress-strings=no|yes Compress strings in profile dump? [yes]\n"
 "    --compress-pos=no|yes     Compress positions in profile dump? [yes]\n"
 "    --combine-dumps=no|yes    Concat all dumps into same file [no]\n"
+"    --async-dump=no|yes       Write dumps from a forked process [no]\n"
+"    --delta-dumps=no|yes      Reference previous dump as base of a dump [no]\n"
+"    --live-stats=no|yes       Publish counters for callgrind_control --watch [no]\n"
+"    --dump-index=no|yes       Write an index file next to each dump [no]\n"
 #if CLG_EXPERIMENTAL
 "    --compress-events=no|yes  Compress events in profile dump? [no]\n"
 "    --dump-bb=no|yes          Dump basic block address of costs? [no]\n"
@@ -570,20 +621,36 @@ void CLG_(print_usage)(void)
 "    --dump-before=<func>      Dump when entering function\n"
 "    --zero-before=<func>      Zero all costs when entering function\n"
 "    --dump-after=<func>       Dump when leaving function\n"
+"    --max-instructions=<count>  Dump and terminate the program after\n"
+"                              <count> instructions [0=never]\n"
 #if CLG_EXPERIMENTAL
 "    --dump-objs=no|yes        Dump static object information [no]\n"
 #endif
 
 "\n   data collection options:\n"
 "    --instr-atstart=no|yes    Do instrumentation at callgrind start [yes]\n"
+"    --fast-instr-toggle=no|yes  Keep translations when switching\n"
+"                              instrumentation on/off [no]\n"
+"    --release-at-instr-off=no|yes  Dump and free all cost centers\n"
+"                              when switching instrumentation off [no]\n"
 "    --collect-atstart=no|yes  Collect at process/thread start [yes]\n"
 "    --toggle-collect=<func>   Toggle collection on enter/leave function\n"
 "    --collect-jumps=no|yes    Collect jumps? [no]\n"
 "    --collect-bus=no|yes      Collect global bus events? [no]\n"
+"    --collect-mix=no|yes      Collect instruction mix (loads, stores, ...)? [no]\n"
+"    --cost-model=<model>      Collect estimated cycles, using weights from\n"
+"                              builtin <model> (skylake, zen2) or file\n"
 #if CLG_EXPERIMENTAL
 "    --collect-alloc=no|yes    Collect memory allocation info? [no]\n"
 #endif
 "    --collect-systime=no|yes  Collect system call time info? [no]\n"
+"    --count-only=no|yes       Only count instructions, no call graph [no]\n"
+"    --collect-openclose=no|yes  Collect from opening openfile until last\n"
+"                              close of closefile [no]\n"
+"    --collect-openfile=<file> Openfile of --collect-openclose [input.txt]\n"
+"    --collect-closefile=<file> Closefile of --collect-openclose [output.txt]\n"
+"    --collect-window=<name>:open=<file>,close=<file>\n"
+"                              Collect and count Ir in a named window\n"
 
 "\n   cost entity separation options:\n"
 "    --separate-threads=no|yes Separate data per thread [no]\n"
@@ -591,6 +658,8 @@ void CLG_(print_usage)(void)
 "    --separate-callers<n>=<f> Separate <n> callers for function <f>\n"
 "    --separate-recs=<n>       Separate function recursions up to level [2]\n"
 "    --separate-recs<n>=<f>    Separate <n> recursions for function <f>\n"
+"    --max-context-memory=<size>[k|m|g]  Fold new contexts and recursion\n"
+"                              levels if above this size [0=unlimited]\n"
 "    --skip-plt=no|yes         Ignore calls to/from PLT sections? [yes]\n"
 "    --skip-direct-rec=no|yes  Ignore direct recursions? [yes]\n"
 "    --fn-skip=<function>      Ignore calls to/from function?\n"
@@ -631,7 +700,12 @@ void CLG_(set_clo_defaults)(void)
 
   /* dump options */
   CLG_(clo).out_format       = 0;
+  CLG_(clo).binary_format    = False;
   CLG_(clo).combine_dumps    = False;
+  CLG_(clo).async_dump       = False;
+  CLG_(clo).delta_dumps      = False;
+  CLG_(clo).live_stats       = False;
+  CLG_(clo).dump_index       = False;
   CLG_(clo).compress_strings = True;
   CLG_(clo).compress_mangled = False;
   CLG_(clo).compress_events  = False;
@@ -643,6 +717,7 @@ void CLG_(set_clo_defaults)(void)
   CLG_(clo).dump_bbs         = False;
 
   CLG_(clo).dump_every_bb    = 0;
+  CLG_(clo).max_instructions = 0;
 
   /* Collection */
   CLG_(clo).separate_threads = False;
@@ -651,16 +726,22 @@ void CLG_(set_clo_defaults)(void)
   CLG_(clo).collect_alloc    = False;
   CLG_(clo).collect_systime  = False;
   CLG_(clo).collect_bus      = False;
+  CLG_(clo).collect_mix      = False;
+  CLG_(clo).cost_model       = 0;
 
   CLG_(clo).skip_plt         = True;
   CLG_(clo).separate_callers = 0;
   CLG_(clo).separate_recursions = 2;
+  CLG_(clo).max_context_memory = 0;
   CLG_(clo).skip_direct_recursion = False;
 
   /* Instrumentation */
   CLG_(clo).instrument_atstart = True;
   CLG_(clo).simulate_cache = False;
   CLG_(clo).simulate_branch = False;
+  CLG_(clo).count_only = False;
+  CLG_(clo).fast_instr_toggle = False;
+  CLG_(clo).release_at_instr_off = False;
 
   /* Call graph */
   CLG_(clo).pop_on_jump = False;
@@ -672,4 +753,6 @@ void CLG_(set_clo_defaults)(void)
   
   /* count between Open/Close */
   CLG_(clo).collect_openclose = False;
+  CLG_(clo).collect_openfile  = "input.txt";
+  CLG_(clo).collect_closefile = "output.txt";
 }
@@ -34,7 +34,7 @@
 /*------------------------------------------------------------*/
 
 #define N_FNSTACK_INITIAL_ENTRIES 500
-#define N_CXT_INITIAL_ENTRIES 2537
+#define N_CXT_INITIAL_ENTRIES 4096
 
 fn_stack CLG_(current_fn_stack);
 
@@ -67,75 +67,6 @@ void CLG_(set_current_fn_stack)(fn_stack* s)
   CLG_(current_fn_stack).top    = s->top;
 }
 
-static cxt_hash cxts;
-
-void CLG_(init_cxt_table)()
-{
-   Int i;
-   
-   cxts.size    = N_CXT_INITIAL_ENTRIES;
-   cxts.entries = 0;
-   cxts.table   = (Context**) CLG_MALLOC("cl.context.ict.1",
-                                         cxts.size * sizeof(Context*));
-
-   for (i = 0; i < cxts.size; i++)
-     cxts.table[i] = 0;
-}
-
-cxt_hash* CLG_(get_cxt_hash)()
-{
-  return &cxts;
-}
-
-/* double size of cxt table  */
-static void resize_cxt_table(void)
-{
-    UInt i, new_size, conflicts1 = 0, conflicts2 = 0;
-    Context **new_table, *curr, *next;
-    UInt new_idx;
-
-    new_size  = 2* cxts.size +3;
-    new_table = (Context**) CLG_MALLOC("cl.context.rct.1",
-                                       new_size * sizeof(Context*));
-
-    if (!new_table) return;
-
-    for (i = 0; i < new_size; i++)
-      new_table[i] = NULL;
-
-    for (i = 0; i < cxts.size; i++) {
-        if (cxts.table[i] == NULL) continue;
-
-        curr = cxts.table[i];
-        while (NULL != curr) {
-            next = curr->next;
-
-            new_idx = (UInt) (curr->hash % new_size);
-
-            curr->next = new_table[new_idx];
-            new_table[new_idx] = curr;
-            if (curr->next) {
-                conflicts1++;
-                if (curr->next->next)
-                    conflicts2++;
-            }
-
-            curr = next;
-        }
-    }
-
-    VG_(free)(cxts.table);
-
-
-    CLG_DEBUG(0, "Resize Context Hash: %d => %d (entries %d, conflicts %d/%d)\n",
-             cxts.size, new_size,
-             cxts.entries, conflicts1, conflicts2);
-
-    cxts.size  = new_size;
-    cxts.table = new_table;
-    CLG_(stat).cxt_hash_resizes++;
-}
-
 __inline__
 static UWord cxt_hash_val(fn_node** fn, UInt size)
 {
@@ -169,13 +100,50 @@ static Bool is_cxt(UWord hash, fn_node** fn, Context* cxt)
     return True;
 }
 
+/* Context hash table, with keys hash value and top function.
+ * The full function list of a context is compared in <cxt_eq>,
+ * given the current function stack as <arg>.
+ */
+static cxt_hash cxts;
+
+/* Contexts are never freed; they are shared by all threads */
+static cc_arena cxt_arena;
+
+static Bool cxt_eq(void* entry, UWord hash, UWord top_fn, void* fn)
+{
+    return is_cxt(hash, (fn_node**) fn, (Context*) entry);
+}
+
+void CLG_(init_cxt_table)()
+{
+   CLG_(init_hash)(&(cxts.table), "cl.context.ict.1",
+		   N_CXT_INITIAL_ENTRIES, cxt_eq,
+		   &(CLG_(stat).cxt_hash_resizes));
+   CLG_(init_arena)(&cxt_arena, "cl.context.nc.1");
+}
+
+cxt_hash* CLG_(get_cxt_hash)()
+{
+  return &cxts;
+}
+
 /**
  * Allocate new Context structure
  */
+/* With --max-context-memory, is the budget for contexts and BBCC
+ * clones used up? Then, new contexts are folded into the context
+ * of the function alone, and new recursion levels into the first. */
+Bool CLG_(context_memory_full)(void)
+{
+    return (CLG_(clo).max_context_memory > 0) &&
+	   (CLG_(stat).context_memory + CLG_(stat).clone_memory >=
+	    CLG_(clo).max_context_memory);
+}
+
 static Context* new_cxt(fn_node** fn)
 {
     Context* cxt;
-    UInt idx, offset;
+    UInt offset;
     UWord hash;
     int size, recs;
     fn_node* top_fn;
@@ -188,13 +156,8 @@ static Context* new_cxt(fn_node** fn)
     recs = top_fn->separate_recursions;
     if (recs<1) recs=1;
 
-    /* check fill degree of context hash table and resize if needed (>80%) */
-    cxts.entries++;
-    if (10 * cxts.entries / cxts.size > 8)
-        resize_cxt_table();
-
-    cxt = (Context*) CLG_MALLOC("cl.context.nc.1",
-                                sizeof(Context)+sizeof(fn_node*)*size);
+    cxt = (Context*) CLG_(arena_alloc)(&cxt_arena,
+                                       sizeof(Context)+sizeof(fn_node*)*size);
 
     // hash value calculation similar to cxt_hash_val(), but additionally
     // copying function pointers in one run
@@ -215,11 +178,10 @@ static Context* new_cxt(fn_node** fn)
 
     CLG_(stat).context_counter += recs;
     CLG_(stat).distinct_contexts++;
+    CLG_(stat).context_memory += sizeof(Context)+sizeof(fn_node*)*size;
 
     /* insert into Context hash table */
-    idx = (UInt) (hash % cxts.size);
-    cxt->next = cxts.table[idx];
-    cxts.table[idx] = cxt;
+    CLG_(hash_insert)(&(cxts.table), hash, (UWord)cxt->fn[0], cxt);
 
 #if CLG_ENABLE_DEBUG
     CLG_DEBUGIF(3) {
@@ -235,7 +197,7 @@ static Context* new_cxt(fn_node** fn)
 Context* CLG_(get_cxt)(fn_node** fn)
 {
     Context* cxt;
-    UInt size, idx;
+    UInt size;
     UWord hash;
 
     CLG_ASSERT(fn != 0);
@@ -248,22 +210,31 @@ Context* CLG_(get_cxt)(fn_node** fn)
 
     hash = cxt_hash_val(fn, size);
 
-    if ( ((cxt = (*fn)->last_cxt) != 0) && is_cxt(hash, fn, cxt)) {
+    /* the LRU also hits if the context last folded is seen again:
+     * folding is final, as the context memory never shrinks */
+    if ( ((cxt = (*fn)->last_cxt) != 0) &&
+	 (is_cxt(hash, fn, cxt) ||
+	  ((cxt == (*fn)->pure_cxt) && (hash == (*fn)->folded_hash))) ) {
         CLG_DEBUG(5, "- get_cxt: %p\n", cxt);
         return cxt;
     }
 
     CLG_(stat).cxt_lru_misses++;
 
-    idx = (UInt) (hash % cxts.size);
-    cxt = cxts.table[idx];
+    cxt = (Context*) CLG_(hash_lookup)(&(cxts.table), hash, (UWord)(*fn),
+				       fn);
 
-    while(cxt) {
-        if (is_cxt(hash,fn,cxt)) break;
-        cxt = cxt->next;
+    if (!cxt && (size > 1) && (*(fn-1) != 0) && CLG_(context_memory_full)()) {
+        /* fold into context of the function alone */
+        CLG_ASSERT((*fn)->pure_cxt != 0);
+        if (!(*fn)->folded) {
+            (*fn)->folded = True;
+            CLG_(stat).folded_contexts++;
+        }
+        (*fn)->folded_hash = hash;
+        cxt = (*fn)->pure_cxt;
     }
-
-    if (!cxt)
+    else if (!cxt)
         cxt = new_cxt(fn);
 
     (*fn)->last_cxt = cxt;
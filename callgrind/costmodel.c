@@ -0,0 +1,222 @@
+/*--------------------------------------------------------------------*/
+/*--- Callgrind                                                    ---*/
+/*---                                                  costmodel.c ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Callgrind, a Valgrind tool for call tracing.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+#include "global.h"
+
+/*------------------------------------------------------------*/
+/*--- Static cycle estimation (--cost-model)               ---*/
+/*------------------------------------------------------------*/
+
+/* A cost model gives a weight in cycles to each instruction class of
+ * the instruction mix (see EG_MIX), and optionally to VEX IR operations.
+ * If an instruction uses one or more of the IR operations with a weight,
+ * the largest of these weights is used instead of the weight of its
+ * class. Weights are folded into per-BB tallies at instrumentation time,
+ * which are summed up as event "Cy" on leaving a BB, as done for "Ir".
+ *
+ * A model is a text with one "<name> <weight>" pair per line, where
+ * <name> is an instruction class (Ld, St, Alu, Fp, Simd, Div, Atom, Br)
+ * or an IR operation (e.g. DivU64 or Iop_DivU64). Lines starting
+ * with '#' are comments. Classes not given get weight 1.
+ */
+
+#define MAX_WEIGHT 0xffff
+
+static UShort class_weight[MIX_EVENTS];
+
+typedef struct _op_weight op_weight;
+struct _op_weight {
+   const HChar* name;
+   IROp op;
+   UShort weight;
+};
+
+#define OPW(n) { #n, Iop_##n, 0 }
+
+/* IR operations which can get a weight */
+static op_weight op_weights[] = {
+   OPW(Mul32), OPW(Mul64),
+   OPW(MullS32), OPW(MullU32), OPW(MullS64), OPW(MullU64),
+   OPW(DivU32), OPW(DivS32), OPW(DivU64), OPW(DivS64),
+   OPW(DivU32E), OPW(DivS32E), OPW(DivU64E), OPW(DivS64E),
+   OPW(DivModU64to32), OPW(DivModS64to32),
+   OPW(DivModU128to64), OPW(DivModS128to64), OPW(DivModS64to64),
+   OPW(AddF32), OPW(SubF32), OPW(MulF32), OPW(DivF32), OPW(SqrtF32),
+   OPW(AddF64), OPW(SubF64), OPW(MulF64), OPW(DivF64), OPW(SqrtF64),
+   OPW(MulF64r32), OPW(DivF64r32),
+   OPW(MulF128), OPW(DivF128), OPW(SqrtF128),
+   OPW(Mul32Fx4), OPW(Mul64Fx2), OPW(Mul32F0x4), OPW(Mul64F0x2),
+   OPW(Mul32Fx8), OPW(Mul64Fx4),
+   OPW(Div32Fx4), OPW(Div64Fx2), OPW(Div32F0x4), OPW(Div64F0x2),
+   OPW(Div32Fx8), OPW(Div64Fx4),
+   OPW(Sqrt32Fx4), OPW(Sqrt64Fx2), OPW(Sqrt32F0x4), OPW(Sqrt64F0x2),
+   OPW(Sqrt32Fx8), OPW(Sqrt64Fx4),
+   { 0, Iop_INVALID, 0 }
+};
+
+/* Builtin models, using rough latencies of the microarchitectures */
+static const HChar* builtin_models[][2] = {
+   { "skylake",
+     "Ld 5\nSt 1\nAlu 1\nFp 4\nSimd 4\nDiv 20\nAtom 18\nBr 1\n"
+     "Mul32 3\nMul64 3\nMullS32 3\nMullU32 3\nMullS64 4\nMullU64 4\n"
+     "DivU32 26\nDivS32 26\nDivU64 42\nDivS64 42\n"
+     "DivModU64to32 26\nDivModS64to32 26\n"
+     "DivModU128to64 42\nDivModS128to64 42\nDivModS64to64 42\n"
+     "DivF32 11\nDivF64 14\nSqrtF32 12\nSqrtF64 18\n"
+     "Div32Fx4 11\nDiv64Fx2 14\nDiv32F0x4 11\nDiv64F0x2 14\n"
+     "Div32Fx8 11\nDiv64Fx4 14\n"
+     "Sqrt32Fx4 12\nSqrt64Fx2 18\nSqrt32F0x4 12\nSqrt64F0x2 18\n"
+     "Sqrt32Fx8 12\nSqrt64Fx4 18\n" },
+   { "zen2",
+     "Ld 4\nSt 1\nAlu 1\nFp 3\nSimd 3\nDiv 15\nAtom 8\nBr 1\n"
+     "Mul32 3\nMul64 3\nMullS32 3\nMullU32 3\nMullS64 3\nMullU64 3\n"
+     "DivU32 25\nDivS32 25\nDivU64 41\nDivS64 41\n"
+     "DivModU64to32 25\nDivModS64to32 25\n"
+     "DivModU128to64 45\nDivModS128to64 45\nDivModS64to64 45\n"
+     "DivF32 10\nDivF64 13\nSqrtF32 14\nSqrtF64 20\n"
+     "Div32Fx4 10\nDiv64Fx2 13\nDiv32F0x4 10\nDiv64F0x2 13\n"
+     "Div32Fx8 10\nDiv64Fx4 13\n"
+     "Sqrt32Fx4 14\nSqrt64Fx2 20\nSqrt32F0x4 14\nSqrt64F0x2 20\n"
+     "Sqrt32Fx8 14\nSqrt64Fx4 20\n" },
+   { 0, 0 }
+};
+
+static Bool set_weight(const HChar* name, UShort weight)
+{
+   Int i;
+
+   for(i = 0; i < MIX_EVENTS; i++)
+      if (VG_(strcmp)(CLG_(mix_events)[i], name) == 0) {
+	 class_weight[i] = weight;
+	 return True;
+      }
+
+   if (VG_(strncmp)(name, "Iop_", 4) == 0) name += 4;
+   for(i = 0; op_weights[i].name; i++)
+      if (VG_(strcmp)(op_weights[i].name, name) == 0) {
+	 op_weights[i].weight = weight;
+	 return True;
+      }
+
+   return False;
+}
+
+/* Parse model <text>; on error, terminate with message */
+static void parse_model(HChar* text)
+{
+   HChar *line, *name, *w, *end, *save1, *save2;
+   Long weight;
+   Int lineno = 0;
+
+   for(line = VG_(strtok_r)(text, "\n", &save1); line;
+       line = VG_(strtok_r)(0, "\n", &save1)) {
+      lineno++;
+      name = VG_(strtok_r)(line, " \t\r", &save2);
+      if (!name || name[0] == '#') continue;
+
+      w = VG_(strtok_r)(0, " \t\r", &save2);
+      weight = w ? VG_(strtoll10)(w, &end) : -1;
+      if (!w || *end || weight < 0 || weight > MAX_WEIGHT)
+	 VG_(fmsg_bad_option)("--cost-model",
+			      "Line %d: expected '<name> <weight>' with "
+			      "weight between 0 and %d\n",
+			      lineno, MAX_WEIGHT);
+      if (!set_weight(name, (UShort)weight))
+	 VG_(fmsg_bad_option)("--cost-model",
+			      "Line %d: unknown instruction class or "
+			      "operation '%s'\n", lineno, name);
+   }
+}
+
+static HChar* read_model_file(const HChar* file)
+{
+   SysRes res;
+   struct vg_stat st;
+   HChar* text;
+   Int fd, size, n;
+
+   res = VG_(open)(file, VKI_O_RDONLY, 0);
+   if (sr_isError(res))
+      VG_(fmsg_bad_option)("--cost-model",
+			   "Can not open cost model file '%s'\n", file);
+   fd = (Int) sr_Res(res);
+
+   if (VG_(fstat)(fd, &st) != 0)
+      VG_(fmsg_bad_option)("--cost-model",
+			   "Can not read cost model file '%s'\n", file);
+   size = (Int) st.size;
+
+   text = (HChar*) CLG_MALLOC("cl.costmodel.rmf.1", size + 1);
+   n = VG_(read)(fd, text, size);
+   VG_(close)(fd);
+   if (n != size)
+      VG_(fmsg_bad_option)("--cost-model",
+			   "Can not read cost model file '%s'\n", file);
+   text[size] = 0;
+
+   return text;
+}
+
+/* Set up the model given with --cost-model: a builtin name or a file */
+void CLG_(init_cost_model)(void)
+{
+   const HChar* model = CLG_(clo).cost_model;
+   HChar* text = 0;
+   Int i;
+
+   if (!model) return;
+
+   for(i = 0; i < MIX_EVENTS; i++)
+      class_weight[i] = 1;
+
+   for(i = 0; builtin_models[i][0]; i++)
+      if (VG_(strcmp)(builtin_models[i][0], model) == 0) {
+	 text = VG_(strdup)("cl.costmodel.icm.1", builtin_models[i][1]);
+	 break;
+      }
+   if (!text)
+      text = read_model_file(model);
+
+   parse_model(text);
+   VG_(free)(text);
+}
+
+UShort CLG_(class_weight)(UChar cl)
+{
+   CLG_ASSERT(cl < MIX_EVENTS);
+   return class_weight[cl];
+}
+
+/* Weight of IR operation <op>, or 0 if the model gives none.
+ * Only called at instrumentation time. */
+UShort CLG_(op_weight)(IROp op)
+{
+   Int i;
+
+   for(i = 0; op_weights[i].name; i++)
+      if (op_weights[i].op == op) return op_weights[i].weight;
+   return 0;
+}
@@ -31,6 +31,7 @@
 
 #include "pub_tool_threadstate.h"
 #include "pub_tool_libcfile.h"
+#include "pub_tool_vkiscnums.h"
 
 
 /* Dump Part Counter */
@@ -39,6 +40,8 @@ static Int out_counter = 0;
 static HChar* out_file = 0;
 static HChar* out_directory = 0;
 static Bool dumps_initialized = False;
+/* PID of the profiled process, also written from asynchronous dumpers */
+static Int dump_pid = 0;
 
 /* Command */
 static HChar cmdbuf[BUF_LEN];
@@ -143,61 +146,422 @@ void init_fpos(FnPos* p)
 }
 
 
-#if 0
-static __inline__
-static void my_fwrite(Int fd, const HChar* buf, Int len)
-{
-	VG_(write)(fd, buf, len);
-}
-#else
-
 #define FWRITE_BUFSIZE 32000
 #define FWRITE_THROUGH 10000
 static HChar fwrite_buf[FWRITE_BUFSIZE];
 static Int fwrite_pos;
 static Int fwrite_fd = -1;
+/* bytes written to <fwrite_fd> before the buffer, for the dump index */
+static ULong fwrite_offset = 0;
 
 static __inline__
 void fwrite_flush(void)
 {
-    if ((fwrite_fd>=0) && (fwrite_pos>0))
+    if ((fwrite_fd>=0) && (fwrite_pos>0)) {
 	VG_(write)(fwrite_fd, fwrite_buf, fwrite_pos);
+	fwrite_offset += fwrite_pos;
+    }
     fwrite_pos = 0;
 }
 
-static void my_fwrite(Int fd, const HChar* buf, Int len)
+/* Make room for <len> bytes in the write buffer for <fd>;
+ * returns the position to write to. <len> must be < FWRITE_BUFSIZE.
+ */
+static __inline__
+HChar* fwrite_reserve(Int fd, Int len)
 {
     if (fwrite_fd != fd) {
 	fwrite_flush();
 	fwrite_fd = fd;
+	fwrite_offset = 0;
     }
+    if (FWRITE_BUFSIZE - fwrite_pos <= len) fwrite_flush();
+    return fwrite_buf + fwrite_pos;
+}
+
+static void fwrite_raw(Int fd, const HChar* buf, Int len)
+{
     if (len > FWRITE_THROUGH) {
+	fwrite_reserve(fd, 0);
 	fwrite_flush();
 	VG_(write)(fd, buf, len);
+	fwrite_offset += len;
 	return;
     }
-    if (FWRITE_BUFSIZE - fwrite_pos <= len) fwrite_flush();
-    VG_(strncpy)(fwrite_buf + fwrite_pos, buf, len);
+    VG_(memcpy)(fwrite_reserve(fd, len), buf, len);
     fwrite_pos += len;
 }
-#endif
 
 
-static void print_obj(HChar* buf, obj_node* obj)
+/* Binary output format (--out-format=binary).
+ *
+ * The file starts with the line BIN_MAGIC, followed by records, each
+ * starting with a tag byte. Numbers are BER compressed integers
+ * (7 bits per byte, most significant group first, high bit set on all
+ * bytes but the last one), signed numbers are zigzag encoded before.
+ * Positions are written as differences to the previously written
+ * position; names refer to a fixed table of name specification keys.
+ * A line end not following a cost record is a BIN_EOL record, anything
+ * else is written verbatim in BIN_TEXT records.
+ * callgrind_convert translates back to the text format.
+ */
+#define BIN_MAGIC   "callgrind-binary: 1\n"
+#define BIN_NUM_MAX 10  /* maximal length of an encoded 64-bit number */
+
+#define BIN_TEXT  1 /* <len> <bytes>: verbatim text */
+#define BIN_NAME  2 /* <key> <id+1> <len> <bytes>: "<key>=(<id>) <name>" */
+#define BIN_POS   3 /* <delta per position column>: position */
+#define BIN_COST  4 /* <n> <n values>: event counts, ends a line */
+#define BIN_CALLS 5 /* <count>: "calls=<count> " */
+#define BIN_JUMP  6 /* <count>: "jump=<count> " */
+#define BIN_JCND  7 /* <followed> <executed>: "jcnd=<followed>/<executed> " */
+#define BIN_EOL   8 /* "\n" */
+
+/* Keys of name specifications, index is written in BIN_NAME */
+static const HChar* bin_name_key[] = {
+    "ob", "fl", "fi", "fe", "fn", "cob", "cfi", "cfn", "jfi", "jfn", "frfn", 0
+};
+
+/* Last position written, as reference for BIN_POS deltas */
+static AddrPos bin_last;
+
+static __inline__
+HChar* bin_num(HChar* p, ULong v)
+{
+    HChar tmp[BIN_NUM_MAX];
+    Int n = 0;
+
+    do {
+	tmp[n++] = (HChar)(v & 0x7f);
+	v >>= 7;
+    } while(v);
+    while(n>1) *p++ = tmp[--n] | 0x80;
+    *p++ = tmp[0];
+    return p;
+}
+
+static __inline__
+HChar* bin_snum(HChar* p, Long v)
+{
+    return bin_num(p, (v<0) ? ((~(ULong)v) << 1) | 1 : ((ULong)v) << 1);
+}
+
+static void bin_name(Int fd, const HChar* tag, Int id, const HChar* name)
+{
+    Int key, len = name ? VG_(strlen)(name) : 0;
+    HChar* p;
+
+    for(key=0; bin_name_key[key]; key++)
+	if (VG_(strcmp)(bin_name_key[key], tag) == 0) break;
+    CLG_ASSERT(bin_name_key[key] != 0);
+
+    p = fwrite_reserve(fd, 1 + 3*BIN_NUM_MAX);
+    *p++ = BIN_NAME;
+    p = bin_num(p, key);
+    p = bin_num(p, id+1);
+    p = bin_num(p, len);
+    fwrite_pos = p - fwrite_buf;
+    fwrite_raw(fd, name, len);
+}
+
+static void bin_pos(Int fd, AddrPos* curr)
+{
+    HChar* p = fwrite_reserve(fd, 1 + 3*BIN_NUM_MAX);
+
+    *p++ = BIN_POS;
+    if (CLG_(clo).dump_instr)
+	p = bin_snum(p, (Long)(curr->addr - bin_last.addr));
+    if (CLG_(clo).dump_bb)
+	p = bin_snum(p, (Long)(curr->bb_addr - bin_last.bb_addr));
+    if (CLG_(clo).dump_line)
+	p = bin_snum(p, (Long)curr->line - (Long)bin_last.line);
+    fwrite_pos = p - fwrite_buf;
+
+    bin_last.addr    = curr->addr;
+    bin_last.bb_addr = curr->bb_addr;
+    bin_last.line    = curr->line;
+}
+
+/* Same as CLG_(sprint_mappingcost): trailing zero values are skipped */
+static void bin_cost(Int fd, EventMapping* em, ULong* c)
+{
+    Int i, n = 0;
+    HChar* p;
+
+    if (c && em->size>0) {
+	for(n=em->size; n>1; n--)
+	    if (c[em->entry[n-1].offset] != 0) break;
+    }
+    p = fwrite_reserve(fd, 1 + (n+1)*BIN_NUM_MAX);
+    *p++ = BIN_COST;
+    p = bin_num(p, n);
+    for(i=0; i<n; i++)
+	p = bin_num(p, c[em->entry[i].offset]);
+    fwrite_pos = p - fwrite_buf;
+}
+
+static void bin_counts(Int fd, HChar tag, ULong c1, ULong c2)
+{
+    HChar* p = fwrite_reserve(fd, 1 + 2*BIN_NUM_MAX);
+
+    *p++ = tag;
+    p = bin_num(p, c1);
+    if (tag == BIN_JCND) p = bin_num(p, c2);
+    fwrite_pos = p - fwrite_buf;
+}
+
+/* Write text; in the binary format as BIN_TEXT or BIN_EOL record */
+static void my_fwrite(Int fd, const HChar* buf, Int len)
+{
+    if (CLG_(clo).binary_format) {
+	HChar* p = fwrite_reserve(fd, 1 + BIN_NUM_MAX);
+	if (len == 1 && buf[0] == '\n') {
+	    *p = BIN_EOL;
+	    fwrite_pos++;
+	    return;
+	}
+	*p++ = BIN_TEXT;
+	fwrite_pos = bin_num(p, len) - fwrite_buf;
+    }
+    fwrite_raw(fd, buf, len);
+}
+
+/* Dump index (--dump-index=yes).
+ *
+ * Next to a dump <file>, an index <file>.idx is written. For each
+ * function block of the dump ("fn=" up to the next function), it gives
+ * the byte range of the costs in the dump, the self cost per source
+ * file and all calls with their inclusive cost. Names are referenced
+ * by their compression IDs; all name definitions of the dump are
+ * copied into the index. Thus, tools get function totals and the call
+ * graph from the small index, and read only the byte ranges of the
+ * dump they need for source annotation.
+ *
+ * The index body is collected in memory while dumping, tracking the
+ * names written with fprint_name() in the same way as a reader of the
+ * dump does.
+ */
+
+static HChar* index_buf = 0;
+static Int index_size = 0, index_used = 0;
+static Bool index_active = False;
+
+/* IDs of current object, file (fl/fi/fe), function, called file and
+ * called function as last written into the dump. index_cfile is -1
+ * if no "cfi=" was given for the next call */
+static Int index_ob, index_file, index_fn, index_cfile, index_cfn;
+
+/* self cost of the current block, per file */
+static Int  index_self_count = 0, index_self_max = 0;
+static Int* index_self_file = 0;
+static FullCost* index_self_cost = 0;
+static Bool index_in_block = False;
+
+static void index_append(const HChar* s, Int len)
+{
+    if (index_used + len > index_size) {
+	index_size = 2 * index_size + len + 4096;
+	index_buf = (HChar*) VG_(realloc)("cl.dump.idx.1", index_buf,
+					  index_size);
+    }
+    VG_(memcpy)(index_buf + index_used, s, len);
+    index_used += len;
+}
+
+static void index_append_cost(const HChar* prefix, FullCost c)
+{
+    HChar buf[COSTS_LEN + 64];
+    Int p;
+
+    p = VG_(sprintf)(buf, "%s", prefix);
+    p += CLG_(sprint_mappingcost)(buf+p, CLG_(dumpmap), c);
+    buf[p++] = '\n';
+    index_append(buf, p);
+}
+
+/* Current offset in dump file <fd> */
+static __inline__ ULong index_offset(Int fd)
+{
+    CLG_ASSERT(fwrite_fd == fd);
+    return fwrite_offset + fwrite_pos;
+}
+
+/* Start the index for dump file <fd>, which was just opened */
+static void index_start(Int fd)
+{
+    fwrite_reserve(fd, 0);
+    fwrite_offset = 0;
+
+    index_used = 0;
+    index_ob = index_file = index_fn = index_cfile = index_cfn = -1;
+    index_self_count = 0;
+    index_in_block = False;
+    index_active = True;
+}
+
+/* Called for every name written into the dump as <line> of <len>
+ * bytes; <defined> is True if the line gives the name for <id> */
+static void index_name(const HChar* tag, Int id, Bool defined,
+		       const HChar* line, Int len)
+{
+    /* copy definitions of names as string table */
+    if (defined) index_append(line, len);
+
+    if ((VG_(strcmp)(tag, "fl") == 0) || (VG_(strcmp)(tag, "fi") == 0) ||
+	(VG_(strcmp)(tag, "fe") == 0))
+	index_file = id;
+    else if (VG_(strcmp)(tag, "fn") == 0)  index_fn = id;
+    else if (VG_(strcmp)(tag, "ob") == 0)  index_ob = id;
+    else if (VG_(strcmp)(tag, "cfi") == 0) index_cfile = id;
+    else if (VG_(strcmp)(tag, "cfn") == 0) index_cfn = id;
+}
+
+/* Self cost <c> at current file, before being added to dump totals */
+static void index_self(FullCost c)
+{
+    Int i;
+
+    for(i = 0; i < index_self_count; i++)
+	if (index_self_file[i] == index_file) break;
+
+    if (i == index_self_count) {
+	if (i == index_self_max) {
+	    index_self_max = 2 * index_self_max + 8;
+	    index_self_file = (Int*) VG_(realloc)("cl.dump.idx.2",
+						  index_self_file,
+						  index_self_max * sizeof(Int));
+	    index_self_cost = (FullCost*) VG_(realloc)("cl.dump.idx.3",
+						      index_self_cost,
+						      index_self_max *
+						      sizeof(FullCost));
+	    VG_(memset)(index_self_cost + i, 0,
+			(index_self_max - i) * sizeof(FullCost));
+	}
+	index_self_file[i] = index_file;
+	CLG_(init_cost_lz)( CLG_(sets).full, &(index_self_cost[i]) );
+	CLG_(zero_cost)( CLG_(sets).full, index_self_cost[i] );
+	index_self_count++;
+    }
+    CLG_(add_cost)( CLG_(sets).full, index_self_cost[i], c );
+}
+
+/* A call written with "cfn=". <has_cost> is False if no "calls=" line
+ * (and no cost) was written. Calls still active at dump time have cost
+ * with a <count> of 0 */
+static void index_call(Bool has_cost, ULong count, FullCost c)
+{
+    HChar buf[64];
+
+    if (index_cfile >= 0)
+	VG_(sprintf)(buf, "call: %d %d %d %llu ",
+		     index_file, index_cfile, index_cfn, count);
+    else
+	VG_(sprintf)(buf, "call: %d - %d %llu ", index_file, index_cfn, count);
+    if (has_cost)
+	index_append_cost(buf, c);
+    else {
+	buf[VG_(strlen)(buf)-1] = '\n';
+	index_append(buf, VG_(strlen)(buf));
+    }
+    index_cfile = -1;
+}
+
+/* Close current block at offset <end>, and start a new one at
+ * <start> if <start> is not 0 */
+static void index_block(ULong end, ULong start)
+{
+    HChar buf[64];
+    Int i;
+
+    if (index_in_block) {
+	for(i = 0; i < index_self_count; i++) {
+	    VG_(sprintf)(buf, "self: %d ", index_self_file[i]);
+	    index_append_cost(buf, index_self_cost[i]);
+	}
+	VG_(sprintf)(buf, "end: %llu\n", end);
+	index_append(buf, VG_(strlen)(buf));
+    }
+    index_self_count = 0;
+    index_in_block = (start > 0);
+    if (!index_in_block) return;
+
+    VG_(sprintf)(buf, "block: %llu %d %d %d\n",
+		 start, index_ob, index_file, index_fn);
+    index_append(buf, VG_(strlen)(buf));
+}
+
+/* Write index for the dump <name> of <size> bytes */
+static void index_write(const HChar* name, ULong size)
+{
+    HChar buf[COSTS_LEN + 64];
+    HChar* idx_name;
+    SysRes res;
+    Int fd, p;
+
+    index_active = False;
+
+    idx_name = (HChar*) CLG_MALLOC("cl.dump.idx.4", VG_(strlen)(name) + 5);
+    VG_(sprintf)(idx_name, "%s.idx", name);
+    res = VG_(open)(idx_name, VKI_O_CREAT|VKI_O_WRONLY|VKI_O_TRUNC,
+		    VKI_S_IRUSR|VKI_S_IWUSR);
+    if (sr_isError(res)) {
+	VG_(message)(Vg_UserMsg, "Warning: can not write index file %s\n",
+		     idx_name);
+	VG_(free)(idx_name);
+	return;
+    }
+    fd = (Int) sr_Res(res);
+
+    p = VG_(sprintf)(buf, "callgrind-index: 1\nsize: %llu\nevents: ", size);
+    p += CLG_(sprint_eventmapping)(buf+p, CLG_(dumpmap));
+    buf[p++] = '\n';
+    VG_(write)(fd, buf, p);
+    VG_(write)(fd, index_buf, index_used);
+    VG_(close)(fd);
+    VG_(free)(idx_name);
+}
+
+
+/* Write a name specification "<tag>=(<id>) <name>".
+ * <id> is -1 if string compression is off, <name> is 0 if the
+ * name already was given for <id>.
+ */
+static void fprint_name(Int fd, const HChar* tag, Int id, const HChar* name)
 {
-    //int n;
+    Int p;
+
+    if (CLG_(clo).binary_format) {
+	bin_name(fd, tag, id, name);
+	return;
+    }
+
+    p = VG_(sprintf)(outbuf, "%s=", tag);
+    if (id >= 0)
+	p += VG_(sprintf)(outbuf+p, name ? "(%d) " : "(%d)", id);
+    if (name)
+	p += VG_(sprintf)(outbuf+p, "%s", name);
+    outbuf[p++] = '\n';
+    my_fwrite(fd, outbuf, p);
+
+    if (index_active) index_name(tag, id, name != 0, outbuf, p);
+}
+
 
+/* Buffer for mangled function names */
+static HChar mangled_buf[sizeof(outbuf)];
+
+/*
+ * tag can be "ob", "cob"
+ */
+static void print_obj(Int fd, const HChar* tag, obj_node* obj)
+{
     if (CLG_(clo).compress_strings) {
 	CLG_ASSERT(obj_dumped != 0);
-	if (obj_dumped[obj->number])
-	    /*n =*/ VG_(sprintf)(buf, "(%d)\n", obj->number);
-	else {
-	    /*n =*/ VG_(sprintf)(buf, "(%d) %s\n",
-			     obj->number, obj->name);
-	}
+	fprint_name(fd, tag, obj->number,
+		    obj_dumped[obj->number] ? 0 : obj->name);
     }
     else
-	/*n =*/ VG_(sprintf)(buf, "%s\n", obj->name);
+	fprint_name(fd, tag, -1, obj->name);
 
 #if 0
     /* add mapping parameters the first time a object is dumped
@@ -212,46 +576,43 @@ static void print_obj(HChar* buf, obj_node* obj)
 #endif
 }
 
-static void print_file(HChar* buf, file_node* file)
+/*
+ * tag can be "fl", "fi", "fe", "cfi", "jfi"
+ */
+static void print_file(Int fd, const HChar* tag, file_node* file)
 {
     if (CLG_(clo).compress_strings) {
 	CLG_ASSERT(file_dumped != 0);
 	if (file_dumped[file->number])
-	    VG_(sprintf)(buf, "(%d)\n", file->number);
+	    fprint_name(fd, tag, file->number, 0);
 	else {
-	    VG_(sprintf)(buf, "(%d) %s\n",
-			 file->number, file->name);
+	    fprint_name(fd, tag, file->number, file->name);
 	    file_dumped[file->number] = True;
 	}
     }
     else
-	VG_(sprintf)(buf, "%s\n", file->name);
+	fprint_name(fd, tag, -1, file->name);
 }
 
 /*
- * tag can be "fn", "cfn", "jfn"
+ * tag can be "fn", "cfn", "jfn", "frfn"
  */
-static void print_fn(Int fd, HChar* buf, const HChar* tag, fn_node* fn)
+static void print_fn(Int fd, const HChar* tag, fn_node* fn)
 {
-    int p;
-    p = VG_(sprintf)(buf, "%s=",tag);
     if (CLG_(clo).compress_strings) {
 	CLG_ASSERT(fn_dumped != 0);
 	if (fn_dumped[fn->number])
-	    p += VG_(sprintf)(buf+p, "(%d)\n", fn->number);
+	    fprint_name(fd, tag, fn->number, 0);
 	else {
-	    p += VG_(sprintf)(buf+p, "(%d) %s\n",
-			      fn->number, fn->name);
+	    fprint_name(fd, tag, fn->number, fn->name);
 	    fn_dumped[fn->number] = True;
 	}
     }
     else
-	p += VG_(sprintf)(buf+p, "%s\n", fn->name);
-
-    my_fwrite(fd, buf, p);
+	fprint_name(fd, tag, -1, fn->name);
 }
 
-static void print_mangled_fn(Int fd, HChar* buf, const HChar* tag, 
+static void print_mangled_fn(Int fd, const HChar* tag, 
 			     Context* cxt, int rec_index)
 {
     int p, i;
@@ -263,9 +624,7 @@ static void print_mangled_fn(Int fd, HChar* buf, const HChar* tag,
 
 	CLG_ASSERT(cxt_dumped != 0);
 	if (cxt_dumped[cxt->base_number+rec_index]) {
-	    p = VG_(sprintf)(buf, "%s=(%d)\n",
-			     tag, cxt->base_number + rec_index);
-	    my_fwrite(fd, buf, p);
+	    fprint_name(fd, tag, cxt->base_number + rec_index, 0);
 	    return;
 	}
 
@@ -275,9 +634,7 @@ static void print_mangled_fn(Int fd, HChar* buf, const HChar* tag,
 	    CLG_ASSERT(cxt->fn[i-1]->pure_cxt != 0);
 	    n = cxt->fn[i-1]->pure_cxt->base_number;
 	    if (cxt_dumped[n]) continue;
-	    p = VG_(sprintf)(buf, "%s=(%d) %s\n",
-			     tag, n, cxt->fn[i-1]->name);
-	    my_fwrite(fd, buf, p);
+	    fprint_name(fd, tag, n, cxt->fn[i-1]->name);
 
 	    cxt_dumped[n] = True;
 	    last = cxt->fn[i-1]->pure_cxt;
@@ -285,44 +642,40 @@ static void print_mangled_fn(Int fd, HChar* buf, const HChar* tag,
 	/* If the last context was the context to print, we are finished */
 	if ((last == cxt) && (rec_index == 0)) return;
 
-	p = VG_(sprintf)(buf, "%s=(%d) (%d)", tag,
-			 cxt->base_number + rec_index,
+	p = VG_(sprintf)(mangled_buf, "(%d)",
 			 cxt->fn[0]->pure_cxt->base_number);
 	if (rec_index >0)
-	    p += VG_(sprintf)(buf+p, "'%d", rec_index +1);
+	    p += VG_(sprintf)(mangled_buf+p, "'%d", rec_index +1);
 	for(i=1;i<cxt->size;i++)
-	    p += VG_(sprintf)(buf+p, "'(%d)", 
+	    p += VG_(sprintf)(mangled_buf+p, "'(%d)", 
 			      cxt->fn[i]->pure_cxt->base_number);
-	p += VG_(sprintf)(buf+p, "\n");
-	my_fwrite(fd, buf, p);
+	fprint_name(fd, tag, cxt->base_number + rec_index, mangled_buf);
 
 	cxt_dumped[cxt->base_number+rec_index] = True;
 	return;
     }
 
 
-    p = VG_(sprintf)(buf, "%s=", tag);
     if (CLG_(clo).compress_strings) {
 	CLG_ASSERT(cxt_dumped != 0);
 	if (cxt_dumped[cxt->base_number+rec_index]) {
-	    p += VG_(sprintf)(buf+p, "(%d)\n", cxt->base_number + rec_index);
-	    my_fwrite(fd, buf, p);
+	    fprint_name(fd, tag, cxt->base_number + rec_index, 0);
 	    return;
 	}
-	else {
-	    p += VG_(sprintf)(buf+p, "(%d) ", cxt->base_number + rec_index);
-	    cxt_dumped[cxt->base_number+rec_index] = True;
-	}
     }
 
-    p += VG_(sprintf)(buf+p, "%s", cxt->fn[0]->name);
+    p = VG_(sprintf)(mangled_buf, "%s", cxt->fn[0]->name);
     if (rec_index >0)
-	p += VG_(sprintf)(buf+p, "'%d", rec_index +1);
+	p += VG_(sprintf)(mangled_buf+p, "'%d", rec_index +1);
     for(i=1;i<cxt->size;i++)
-	p += VG_(sprintf)(buf+p, "'%s", cxt->fn[i]->name);
+	p += VG_(sprintf)(mangled_buf+p, "'%s", cxt->fn[i]->name);
 
-    p += VG_(sprintf)(buf+p, "\n");
-    my_fwrite(fd, buf, p);
+    if (CLG_(clo).compress_strings) {
+	fprint_name(fd, tag, cxt->base_number + rec_index, mangled_buf);
+	cxt_dumped[cxt->base_number+rec_index] = True;
+    }
+    else
+	fprint_name(fd, tag, -1, mangled_buf);
 }
 
 
@@ -366,7 +719,7 @@ static Bool print_fn_pos(int fd, FnPos* last, BBCC* bbcc)
 		}
 	    }
 	    else if (last_from != curr_from) {
-		print_fn(fd,outbuf,"frfn", curr_from);
+		print_fn(fd, "frfn", curr_from);
 		res = True;
 	    }
 	    last->cxt = bbcc->cxt;
@@ -374,24 +727,20 @@ static Bool print_fn_pos(int fd, FnPos* last, BBCC* bbcc)
     }
 
     if (last->obj != bbcc->cxt->fn[0]->file->obj) {
-	VG_(sprintf)(outbuf, "ob=");
-	print_obj(outbuf+3, bbcc->cxt->fn[0]->file->obj);
-	my_fwrite(fd, outbuf, VG_(strlen)(outbuf));
+	print_obj(fd, "ob", bbcc->cxt->fn[0]->file->obj);
 	last->obj = bbcc->cxt->fn[0]->file->obj;
 	res = True;
     }
 
     if (last->file != bbcc->cxt->fn[0]->file) {
-	VG_(sprintf)(outbuf, "fl=");
-	print_file(outbuf+3, bbcc->cxt->fn[0]->file);
-	my_fwrite(fd, outbuf, VG_(strlen)(outbuf));
+	print_file(fd, "fl", bbcc->cxt->fn[0]->file);
 	last->file = bbcc->cxt->fn[0]->file;
 	res = True;
     }
 
     if (!CLG_(clo).mangle_names) {
 	if (last->fn != bbcc->cxt->fn[0]) {
-	    print_fn(fd,outbuf, "fn", bbcc->cxt->fn[0]);
+	    print_fn(fd, "fn", bbcc->cxt->fn[0]);
 	    last->fn = bbcc->cxt->fn[0];
 	    res = True;
 	}
@@ -401,7 +750,7 @@ static Bool print_fn_pos(int fd, FnPos* last, BBCC* bbcc)
 	if ((last->rec_index != bbcc->rec_index) ||
 	    (last->cxt != bbcc->cxt)) {
 
-	    print_mangled_fn(fd, outbuf, "fn", bbcc->cxt, bbcc->rec_index);
+	    print_mangled_fn(fd, "fn", bbcc->cxt, bbcc->rec_index);
 	    last->fn = bbcc->cxt->fn[0];
 	    last->rec_index = bbcc->rec_index;
 	    res = True;
@@ -415,73 +764,40 @@ static Bool print_fn_pos(int fd, FnPos* last, BBCC* bbcc)
     return res;
 }
 
-/* the debug lookup cache is useful if BBCC for same BB are
- * dumped directly in a row. This is a direct mapped cache.
- */
-#define DEBUG_CACHE_SIZE 1777
-
-static Addr       debug_cache_addr[DEBUG_CACHE_SIZE];
-static file_node* debug_cache_file[DEBUG_CACHE_SIZE];
-static int        debug_cache_line[DEBUG_CACHE_SIZE];
-static Bool       debug_cache_info[DEBUG_CACHE_SIZE];
-
-static __inline__
-void init_debug_cache(void)
-{
-    int i;
-    for(i=0;i<DEBUG_CACHE_SIZE;i++) {
-	debug_cache_addr[i] = 0;
-	debug_cache_file[i] = 0;
-	debug_cache_line[i] = 0;
-	debug_cache_info[i] = 0;
-    }
-}
-
+/* Source position of instruction <instr> of the BB of <bbcc>.
+ * Positions are looked up once per BB (see CLG_(init_bb_pos)): when
+ * instrumenting with --dump-line=yes, else at the first dump */
 static /* __inline__ */
-Bool get_debug_pos(BBCC* bbcc, Addr addr, AddrPos* p)
+Bool get_debug_pos(BBCC* bbcc, UInt instr, AddrPos* p)
 {
-    HChar file[FILENAME_LEN];
-    HChar dir[FILENAME_LEN];
-    Bool found_file_line, found_dirname;
-
-    int cachepos = addr % DEBUG_CACHE_SIZE;
-    
-    if (debug_cache_addr[cachepos] == addr) {
-	p->line = debug_cache_line[cachepos];
-	p->file = debug_cache_file[cachepos];
-	found_file_line = debug_cache_info[cachepos];
+    BB* bb = bbcc->bb;
+    Addr addr = bb_addr(bb);
+    PosRun* r;
+    Bool found_file_line;
+
+    if ((bb->pos == 0) && (bb->instr_count > 0))
+	CLG_(init_bb_pos)(bb);
+
+    if (bb->pos_count > 0) {
+	r = CLG_(get_bb_pos)(bb, instr);
+	p->file = r->file;
+	p->line = r->line;
+	found_file_line = r->found;
+	addr += bb->instr[instr].instr_offset;
     }
     else {
-	found_file_line = VG_(get_filename_linenum)(addr,
-						    file, FILENAME_LEN,
-						    dir, FILENAME_LEN,
-						    &found_dirname,
-						    &(p->line));
-	if (!found_file_line) {
-	    VG_(strcpy)(file, "???");
-	    p->line = 0;
-	}
-	if (found_dirname) {
-	    // +1 for the '/'.
-	    CLG_ASSERT(VG_(strlen)(dir) + VG_(strlen)(file) + 1 < FILENAME_LEN);
-	    VG_(strcat)(dir, "/");     // Append '/'
-	    VG_(strcat)(dir, file);    // Append file to dir
-	    VG_(strcpy)(file, dir);    // Move dir+file to file
-	}
-	p->file    = CLG_(get_file_node)(bbcc->bb->obj, file);
-
-	debug_cache_info[cachepos] = found_file_line;
-	debug_cache_addr[cachepos] = addr;
-	debug_cache_line[cachepos] = p->line;
-	debug_cache_file[cachepos] = p->file;
+	/* BB without instructions */
+	p->file = bbcc->cxt->fn[0]->file;
+	p->line = 0;
+	found_file_line = False;
     }
 
     /* Address offset from bbcc start address */
-    p->addr = addr - bbcc->bb->obj->offset;
-    p->bb_addr = bbcc->bb->offset;
+    p->addr = addr - bb->obj->offset;
+    p->bb_addr = bb->offset;
 
     CLG_DEBUG(3, "  get_debug_pos(%#lx): BB %#lx, fn '%s', file '%s', line %u\n",
-	     addr, bb_addr(bbcc->bb), bbcc->cxt->fn[0]->name,
+	     addr, bb_addr(bb), bbcc->cxt->fn[0]->name,
 	     p->file->name, p->line);
 
     return found_file_line;
@@ -529,12 +845,7 @@ static void fprint_apos(Int fd, AddrPos* curr, AddrPos* last, file_node* func_fi
     if (curr->file != last->file) {
 
 	/* if we switch back to orig file, use fe=... */
-	if (curr->file == func_file)
-	    VG_(sprintf)(outbuf, "fe=");
-	else
-	    VG_(sprintf)(outbuf, "fi=");
-	print_file(outbuf+3, curr->file);
-	my_fwrite(fd, outbuf, VG_(strlen)(outbuf));
+	print_file(fd, (curr->file == func_file) ? "fe" : "fi", curr->file);
     }
 
     if (CLG_(clo).dump_bbs) {
@@ -556,6 +867,11 @@ static void fprint_apos(Int fd, AddrPos* curr, AddrPos* last, file_node* func_fi
 static
 void fprint_pos(Int fd, AddrPos* curr, AddrPos* last)
 {
+    if (CLG_(clo).binary_format) {
+	bin_pos(fd, curr);
+	return;
+    }
+
     if (0) //CLG_(clo).dump_bbs)
 	VG_(sprintf)(outbuf, "%lu ", curr->addr - curr->bb_addr);
     else {
@@ -617,7 +933,13 @@ void fprint_pos(Int fd, AddrPos* curr, AddrPos* last)
 static
 void fprint_cost(int fd, EventMapping* es, ULong* cost)
 {
-  int p = CLG_(sprint_mappingcost)(outbuf, es, cost);
+  int p;
+
+  if (CLG_(clo).binary_format) {
+    bin_cost(fd, es, cost);
+    return;
+  }
+  p = CLG_(sprint_mappingcost)(outbuf, es, cost);
   VG_(sprintf)(outbuf+p, "\n");
   my_fwrite(fd, outbuf, VG_(strlen)(outbuf));
   return;
@@ -642,6 +964,7 @@ static void fprint_fcost(Int fd, AddrCost* c, AddrPos* last)
   copy_apos( last, &(c->p) ); /* update last to current position */
 
   fprint_cost(fd, CLG_(dumpmap), c->cost);
+  if (index_active) index_self(c->cost);
 
   /* add cost to total */
   CLG_(add_and_zero_cost)( CLG_(sets).full, dump_total_cost, c->cost );
@@ -664,7 +987,7 @@ static void fprint_jcc(Int fd, jCC* jcc, AddrPos* curr, AddrPos* last, ULong eco
     CLG_ASSERT(jcc->to !=0);
     CLG_ASSERT(jcc->from !=0);
     
-    if (!get_debug_pos(jcc->to, bb_addr(jcc->to->bb), &target)) {
+    if (!get_debug_pos(jcc->to, 0, &target)) {
 	/* if we don't have debug info, don't switch to file "???" */
 	target.file = last->file;
     }
@@ -690,30 +1013,33 @@ static void fprint_jcc(Int fd, jCC* jcc, AddrPos* curr, AddrPos* last, ULong eco
 	 * which change the stack, and thus context
 	 */
 	if (last->file != target.file) {
-	    VG_(sprintf)(outbuf, "jfi=");
-	    print_file(outbuf+4, target.file);
-	    my_fwrite(fd, outbuf, VG_(strlen)(outbuf));
+	    print_file(fd, "jfi", target.file);
 	}
 	
 	if (jcc->from->cxt != jcc->to->cxt) {
 	    if (CLG_(clo).mangle_names)
-		print_mangled_fn(fd, outbuf, "jfn",
+		print_mangled_fn(fd, "jfn",
 				 jcc->to->cxt, jcc->to->rec_index);
 	    else
-		print_fn(fd, outbuf, "jfn", jcc->to->cxt->fn[0]);
+		print_fn(fd, "jfn", jcc->to->cxt->fn[0]);
 	}
 	    
-	if (jcc->jmpkind == jk_CondJump) {
-	    /* format: jcnd=<followed>/<executions> <target> */
-	    VG_(sprintf)(outbuf, "jcnd=%llu/%llu ",
-			 jcc->call_counter, ecounter);
-	}
+	if (CLG_(clo).binary_format)
+	    bin_counts(fd, (jcc->jmpkind == jk_CondJump) ? BIN_JCND : BIN_JUMP,
+		       jcc->call_counter, ecounter);
 	else {
-	    /* format: jump=<jump count> <target> */
-	    VG_(sprintf)(outbuf, "jump=%llu ",
-			 jcc->call_counter);
+	    if (jcc->jmpkind == jk_CondJump) {
+		/* format: jcnd=<followed>/<executions> <target> */
+		VG_(sprintf)(outbuf, "jcnd=%llu/%llu ",
+			     jcc->call_counter, ecounter);
+	    }
+	    else {
+		/* format: jump=<jump count> <target> */
+		VG_(sprintf)(outbuf, "jump=%llu ",
+			     jcc->call_counter);
+	    }
+	    my_fwrite(fd, outbuf, VG_(strlen)(outbuf));
 	}
-	my_fwrite(fd, outbuf, VG_(strlen)(outbuf));
 		
 	fprint_pos(fd, &target, last);
 	my_fwrite(fd, "\n", 1);
@@ -729,37 +1055,39 @@ static void fprint_jcc(Int fd, jCC* jcc, AddrPos* curr, AddrPos* last, ULong eco
     
     /* object of called position different to object of this function?*/
     if (jcc->from->cxt->fn[0]->file->obj != obj) {
-	VG_(sprintf)(outbuf, "cob=");
-	print_obj(outbuf+4, obj);
-	my_fwrite(fd, outbuf, VG_(strlen)(outbuf));
+	print_obj(fd, "cob", obj);
     }
 
     /* file of called position different to current file? */
     if (last->file != file) {
-	VG_(sprintf)(outbuf, "cfi=");
-	print_file(outbuf+4, file);
-	my_fwrite(fd, outbuf, VG_(strlen)(outbuf));
+	print_file(fd, "cfi", file);
     }
 
     if (CLG_(clo).mangle_names)
-	print_mangled_fn(fd, outbuf, "cfn", jcc->to->cxt, jcc->to->rec_index);
+	print_mangled_fn(fd, "cfn", jcc->to->cxt, jcc->to->rec_index);
     else
-	print_fn(fd, outbuf, "cfn", jcc->to->cxt->fn[0]);
+	print_fn(fd, "cfn", jcc->to->cxt->fn[0]);
 
     if (!CLG_(is_zero_cost)( CLG_(sets).full, jcc->cost)) {
-      VG_(sprintf)(outbuf, "calls=%llu ", 
-		   jcc->call_counter);
-	my_fwrite(fd, outbuf, VG_(strlen)(outbuf));
+	if (CLG_(clo).binary_format)
+	    bin_counts(fd, BIN_CALLS, jcc->call_counter, 0);
+	else {
+	    VG_(sprintf)(outbuf, "calls=%llu ", jcc->call_counter);
+	    my_fwrite(fd, outbuf, VG_(strlen)(outbuf));
+	}
 
 	fprint_pos(fd, &target, last);
 	my_fwrite(fd, "\n", 1);	
 	fprint_pos(fd, curr, last);
 	fprint_cost(fd, CLG_(dumpmap), jcc->cost);
+	if (index_active) index_call(True, jcc->call_counter, jcc->cost);
 
 	CLG_(init_cost)( CLG_(sets).full, jcc->cost );
 
 	jcc->call_counter = 0;
     }
+    else if (index_active)
+	index_call(False, 0, 0);
 }
 
 
@@ -770,6 +1098,17 @@ static void fprint_jcc(Int fd, jCC* jcc, AddrPos* curr, AddrPos* last, ULong eco
 static AddrCost ccSum[2];
 static int currSum;
 
+/* Reset execution counters of a BBCC after its costs were dumped */
+static void zero_bbcc_counters(BBCC* bbcc)
+{
+  Int i;
+
+  bbcc->ecounter_sum = 0;
+  for(i=0; i<=bbcc->bb->cjmp_count; i++)
+    bbcc->jmp[i].ecounter = 0;
+  bbcc->ret_counter = 0;
+}
+
 /*
  * Print all costs of a BBCC:
  * - FCCs of instructions
@@ -783,7 +1122,7 @@ static Bool fprint_bbcc(Int fd, BBCC* bbcc, AddrPos* last)
   Bool something_written = False;
   jCC* jcc;
   AddrCost *currCost, *newCost;
-  Int jcc_count = 0, instr, i, jmp;
+  Int jcc_count = 0, instr, jmp;
   BB* bb = bbcc->bb;
 
   CLG_ASSERT(bbcc->cxt != 0);
@@ -804,8 +1143,7 @@ static Bool fprint_bbcc(Int fd, BBCC* bbcc, AddrPos* last)
     /* get debug info of current instruction address and dump cost
      * if CLG_(clo).dump_bbs or file/line has changed
      */
-    if (!get_debug_pos(bbcc, bb_addr(bb) + instr_info->instr_offset, 
-		       &(newCost->p))) {
+    if (!get_debug_pos(bbcc, instr, &(newCost->p))) {
       /* if we don't have debug info, don't switch to file "???" */
       newCost->p.file = bbcc->cxt->fn[0]->file;
     }
@@ -844,7 +1182,7 @@ static Bool fprint_bbcc(Int fd, BBCC* bbcc, AddrPos* last)
 		fprint_apos(fd, &(currCost->p), last, bbcc->cxt->fn[0]->file);
 		fprint_fcost(fd, currCost, last);
 	    }
-	    get_debug_pos(bbcc, bb_addr(bb)+instr_info->instr_offset, &(currCost->p));
+	    get_debug_pos(bbcc, instr, &(currCost->p));
 	    fprint_apos(fd, &(currCost->p), last, bbcc->cxt->fn[0]->file);
 	    something_written = True;
 	    for(jcc=bbcc->jmp[jmp].jcc_list; jcc; jcc=jcc->next_from) {
@@ -882,7 +1220,8 @@ static Bool fprint_bbcc(Int fd, BBCC* bbcc, AddrPos* last)
       fprint_fcost(fd, currCost, last);
     }
     
-    get_debug_pos(bbcc, bb_jmpaddr(bb), &(currCost->p));
+    get_debug_pos(bbcc, (bb->instr_count > 0) ? bb->instr_count-1 : 0,
+		  &(currCost->p));
     fprint_apos(fd, &(currCost->p), last, bbcc->cxt->fn[0]->file);
     something_written = True;
     
@@ -923,10 +1262,7 @@ static Bool fprint_bbcc(Int fd, BBCC* bbcc, AddrPos* last)
     CLG_ASSERT(something_written);
   }
   
-  bbcc->ecounter_sum = 0;
-  for(i=0; i<=bbcc->bb->cjmp_count; i++)
-    bbcc->jmp[i].ecounter = 0;
-  bbcc->ret_counter = 0;
+  zero_bbcc_counters(bbcc);
   
   CLG_DEBUG(1, "- fprint_bbcc: JCCs %d\n", jcc_count);
   
@@ -1208,9 +1544,9 @@ BBCC** prepare_dump(void)
 
     prepare_count = 0;
     
-    /* if we do not separate among threads, this gives all */
-    /* count number of BBCCs with >0 executions */
-    CLG_(forall_bbccs)(hash_addCount);
+    /* if we do not separate among threads, this gives all.
+     * Only BBCCs changed since last dump can have >0 executions */
+    CLG_(forall_dirty_bbccs)(hash_addCount);
 
     /* even if we do not separate among threads,
      * call stacks are separated */
@@ -1226,7 +1562,7 @@ BBCC** prepare_dump(void)
       (BBCC**) CLG_MALLOC("cl.dump.pd.1",
                           (prepare_count+1) * sizeof(BBCC*));    
 
-    CLG_(forall_bbccs)(hash_addPtr);
+    CLG_(forall_dirty_bbccs)(hash_addPtr);
 
     if (CLG_(clo).separate_threads)
       cs_addPtr(0);
@@ -1256,6 +1592,12 @@ static void fprint_cost_ln(int fd, const HChar* prefix,
 {
     int p;
 
+    if (CLG_(clo).binary_format) {
+	my_fwrite(fd, prefix, VG_(strlen)(prefix));
+	bin_cost(fd, em, cost);
+	return;
+    }
+
     p = VG_(sprintf)(outbuf, "%s", prefix);
     p += CLG_(sprint_mappingcost)(outbuf + p, em, cost);
     VG_(sprintf)(outbuf + p, "\n");
@@ -1265,6 +1607,40 @@ static void fprint_cost_ln(int fd, const HChar* prefix,
 static ULong bbs_done = 0;
 static HChar* filename = 0;
 
+/* Cost since last dump of the thread to be dumped */
+static void summary_cost(FullCost sum)
+{
+   CLG_(zero_cost)(CLG_(sets).full, sum);
+   if (CLG_(clo).separate_threads) {
+     thread_info* ti = CLG_(get_current_thread)();
+     CLG_(add_diff_cost)(CLG_(sets).full, sum, ti->lastdump_cost,
+			   ti->states.entry[0]->cost);
+   }
+   else {
+     /* This function is called once for thread 1, where
+      * all costs are summed up when not dumping separate per thread.
+      * But this is not true for summary: we need to add all threads.
+      */
+     int t;
+     thread_info** thr = CLG_(get_threads)();
+     for(t=1;t<VG_N_THREADS;t++) {
+       if (!thr[t]) continue;
+       CLG_(add_diff_cost)(CLG_(sets).full, sum,
+			  thr[t]->lastdump_cost,
+			  thr[t]->states.entry[0]->cost);
+     }
+   }
+}
+
+static void init_dump_total_cost(FullCost summary)
+{
+   CLG_(init_cost_lz)( CLG_(sets).full, &dump_total_cost );
+
+   /* With --count-only, there are no BBCCs to sum up into totals */
+   if (CLG_(clo).count_only)
+       CLG_(copy_cost)( CLG_(sets).full, dump_total_cost, summary );
+}
+
 static
 void file_err(void)
 {
@@ -1278,12 +1654,13 @@ void file_err(void)
  * Create a new dump file and write header.
  *
  * Naming: <CLG_(clo).filename_base>.<pid>[.<part>][-<tid>]
- *         <part> is skipped for final dump (trigger==0)
+ *         <part> is skipped for final dump
  *         <tid>  is skipped for thread 1 with CLG_(clo).separate_threads=no
  *
  * Returns the file descriptor, and -1 on error (no write permission)
  */
-static int new_dumpfile(HChar buf[BUF_LEN], int tid, const HChar* trigger)
+static int new_dumpfile(HChar buf[BUF_LEN], int tid, const HChar* trigger,
+			Bool final)
 {
     Bool appending = False;
     int i, fd;
@@ -1296,7 +1673,7 @@ static int new_dumpfile(HChar buf[BUF_LEN], int tid, const HChar* trigger)
     if (!CLG_(clo).combine_dumps) {
 	i = VG_(sprintf)(filename, "%s", out_file);
     
-	if (trigger)
+	if (!final)
 	    i += VG_(sprintf)(filename+i, ".%d", out_counter);
 
 	if (CLG_(clo).separate_threads)
@@ -1321,6 +1698,7 @@ static int new_dumpfile(HChar buf[BUF_LEN], int tid, const HChar* trigger)
 	}
     }
     fd = (Int) sr_Res(res);
+    if (CLG_(clo).dump_index) index_start(fd);
 
     CLG_DEBUG(2, "  new_dumpfile '%s'\n", filename);
 
@@ -1329,6 +1707,11 @@ static int new_dumpfile(HChar buf[BUF_LEN], int tid, const HChar* trigger)
 
 
     if (!appending) {
+	if (CLG_(clo).binary_format) {
+	    fwrite_raw(fd, BIN_MAGIC, VG_(strlen)(BIN_MAGIC));
+	    init_apos(&bin_last, 0, 0, 0);
+	}
+
 	/* version */
 	VG_(sprintf)(buf, "version: 1\n");
 	my_fwrite(fd, buf, VG_(strlen)(buf));
@@ -1338,7 +1721,7 @@ static int new_dumpfile(HChar buf[BUF_LEN], int tid, const HChar* trigger)
 	my_fwrite(fd, buf, VG_(strlen)(buf));
 
 	/* "pid:" line */
-	VG_(sprintf)(buf, "pid: %d\n", VG_(getpid)());
+	VG_(sprintf)(buf, "pid: %d\n", dump_pid);
 	my_fwrite(fd, buf, VG_(strlen)(buf));
 
 	/* "cmd:" line */
@@ -1354,6 +1737,27 @@ static int new_dumpfile(HChar buf[BUF_LEN], int tid, const HChar* trigger)
 	my_fwrite(fd, buf, VG_(strlen)(buf));
     }
 
+    /* "base:" line: dump with costs up to the start of this one */
+    if (CLG_(clo).delta_dumps && !CLG_(clo).combine_dumps) {
+	thread_info* ti = CLG_(get_current_thread)();
+	const HChar* base = VG_(strrchr)(out_file, '/');
+
+	if (ti->lastdump_part > 0) {
+	    base = base ? base+1 : out_file;
+	    my_fwrite(fd, "base: ", 6);
+	    my_fwrite(fd, base, VG_(strlen)(base));
+	    i = VG_(sprintf)(buf, ".%d", ti->lastdump_part);
+	    if (CLG_(clo).separate_threads)
+		i += VG_(sprintf)(buf+i, "-%02d", tid);
+	    VG_(sprintf)(buf+i, "\n");
+	    my_fwrite(fd, buf, VG_(strlen)(buf));
+	}
+    }
+
+    /* cost of this dump, for estimates and "summary:" line */
+    sum = CLG_(get_eventset_cost)( CLG_(sets).full );
+    summary_cost(sum);
+
     /* "desc:" lines */
     if (!appending) {
 	my_fwrite(fd, "\n", 1);
@@ -1383,6 +1787,9 @@ static int new_dumpfile(HChar buf[BUF_LEN], int tid, const HChar* trigger)
 
 	(*CLG_(cachesim).getdesc)(buf);
 	my_fwrite(fd, buf, VG_(strlen)(buf));
+	/* estimates of sampled simulation are for the Ir of this dump */
+	for(i = 0; CLG_(sample_desc)(buf, i, sum[fullOffset(EG_IR)]); i++)
+	    my_fwrite(fd, buf, VG_(strlen)(buf));
     }
 
     VG_(sprintf)(buf, "\ndesc: Timerange: Basic block %llu - %llu\n",
@@ -1393,6 +1800,20 @@ static int new_dumpfile(HChar buf[BUF_LEN], int tid, const HChar* trigger)
 		 trigger ? trigger : "Program termination");
     my_fwrite(fd, buf, VG_(strlen)(buf));
 
+    if (CLG_(clo).max_context_memory > 0) {
+	VG_(sprintf)(buf, "desc: Folded: %d contexts, %d recursion levels "
+		     "(limit %llu bytes)\n",
+		     CLG_(stat).folded_contexts, CLG_(stat).folded_recursions,
+		     CLG_(clo).max_context_memory);
+	my_fwrite(fd, buf, VG_(strlen)(buf));
+    }
+
+    /* Ir counters of collection windows */
+    for (i = 0; i < CLG_(collect_window_count)(); i++) {
+	CLG_(sprint_collect_window)(buf, i);
+	my_fwrite(fd, buf, VG_(strlen)(buf));
+    }
+
 #if 0
    /* Output function specific config
     * FIXME */
@@ -1442,31 +1863,11 @@ static int new_dumpfile(HChar buf[BUF_LEN], int tid, const HChar* trigger)
    my_fwrite(fd, "\n", 1);
 
    /* summary lines */
-   sum = CLG_(get_eventset_cost)( CLG_(sets).full );
-   CLG_(zero_cost)(CLG_(sets).full, sum);
-   if (CLG_(clo).separate_threads) {
-     thread_info* ti = CLG_(get_current_thread)();
-     CLG_(add_diff_cost)(CLG_(sets).full, sum, ti->lastdump_cost,
-			   ti->states.entry[0]->cost);
-   }
-   else {
-     /* This function is called once for thread 1, where
-      * all costs are summed up when not dumping separate per thread.
-      * But this is not true for summary: we need to add all threads.
-      */
-     int t;
-     thread_info** thr = CLG_(get_threads)();
-     for(t=1;t<VG_N_THREADS;t++) {
-       if (!thr[t]) continue;
-       CLG_(add_diff_cost)(CLG_(sets).full, sum,
-			  thr[t]->lastdump_cost,
-			  thr[t]->states.entry[0]->cost);
-     }
-   }
    fprint_cost_ln(fd, "summary: ", CLG_(dumpmap), sum);
+   if (index_active) index_append_cost("summary: ", sum);
 
    /* all dumped cost will be added to total_fcc */
-   CLG_(init_cost_lz)( CLG_(sets).full, &dump_total_cost );
+   init_dump_total_cost(sum);
 
    my_fwrite(fd, "\n\n",2);
 
@@ -1479,6 +1880,9 @@ static int new_dumpfile(HChar buf[BUF_LEN], int tid, const HChar* trigger)
 
 static void close_dumpfile(int fd)
 {
+    const HChar* name = filename;
+    ULong size = 0;
+
     if (fd <0) return;
 
     fprint_cost_ln(fd, "totals: ", CLG_(dumpmap),
@@ -1487,6 +1891,11 @@ static void close_dumpfile(int fd)
     CLG_(add_cost_lz)(CLG_(sets).full, 
 		     &CLG_(total_cost), dump_total_cost);
 
+    if (index_active) {
+	index_append_cost("totals: ", dump_total_cost);
+	size = index_offset(fd);
+    }
+
     fwrite_flush();    
     VG_(close)(fd);
 
@@ -1496,14 +1905,38 @@ static void close_dumpfile(int fd)
 	    VG_(message)(Vg_DebugMsg, "Warning: Can not rename .%s to %s\n",
 			 filename, filename);
        }
+	else
+	    name = filename+1;
    }
+
+    if (index_active) index_write(name, size);
 }
 
 
+/* set counters of last dump */
+static void set_lastdump_cost(thread_info* ti)
+{
+  CLG_(copy_cost)( CLG_(sets).full, ti->lastdump_cost,
+		  CLG_(current_state).cost );
+  ti->lastdump_part = out_counter;
+
+  /* With --count-only, totals are the summary of all threads */
+  if (CLG_(clo).count_only && !CLG_(clo).separate_threads) {
+    int t;
+    thread_info** thr = CLG_(get_threads)();
+    for(t=1;t<VG_N_THREADS;t++) {
+      if (!thr[t] || (thr[t] == ti)) continue;
+      CLG_(copy_cost)( CLG_(sets).full, thr[t]->lastdump_cost,
+		      thr[t]->states.entry[0]->cost );
+    }
+  }
+}
+
 /* Helper for print_bbccs */
 
 static Int   print_fd;
 static const HChar* print_trigger;
+static Bool  print_final;
 static HChar print_buf[BUF_LEN];
 
 static void print_bbccs_of_thread(thread_info* ti)
@@ -1511,10 +1944,12 @@ static void print_bbccs_of_thread(thread_info* ti)
   BBCC **p, **array;
   FnPos lastFnPos;
   AddrPos lastAPos;
+  ULong block_end = 0;
 
   CLG_DEBUG(1, "+ print_bbccs(tid %d)\n", CLG_(current_tid));
 
-  print_fd = new_dumpfile(print_buf, CLG_(current_tid), print_trigger);
+  print_fd = new_dumpfile(print_buf, CLG_(current_tid), print_trigger,
+			  print_final);
   if (print_fd <0) {
     CLG_DEBUG(1, "- print_bbccs(tid %d): No output...\n", CLG_(current_tid));
     return;
@@ -1539,18 +1974,19 @@ static void print_bbccs_of_thread(thread_info* ti)
       
       if (ccSum[currSum].p.file != lastFnPos.cxt->fn[0]->file) {
 	/* switch back to file of function */
-	VG_(sprintf)(print_buf, "fe=");
-	print_file(print_buf+3, lastFnPos.cxt->fn[0]->file);
-	my_fwrite(print_fd, print_buf, VG_(strlen)(print_buf));
+	print_file(print_fd, "fe", lastFnPos.cxt->fn[0]->file);
       }
       my_fwrite(print_fd, "\n", 1);
     }
     
     if (*p == 0) break;
-    
+
+    if (index_active) block_end = index_offset(print_fd);
     if (print_fn_pos(print_fd, &lastFnPos, *p)) {
       
       /* new function */
+      if (index_active)
+	index_block(block_end, index_offset(print_fd));
       init_apos(&lastAPos, 0, 0, (*p)->cxt->fn[0]->file);
       init_fcost(&ccSum[0], 0, 0, 0);
       init_fcost(&ccSum[1], 0, 0, 0);
@@ -1578,25 +2014,26 @@ static void print_bbccs_of_thread(thread_info* ti)
     
     p++;
   }
+  if (index_active) index_block(index_offset(print_fd), 0);
 
   close_dumpfile(print_fd);
   if (array) VG_(free)(array);
   
-  /* set counters of last dump */
-  CLG_(copy_cost)( CLG_(sets).full, ti->lastdump_cost,
-		  CLG_(current_state).cost );
+  set_lastdump_cost(ti);
+  CLG_(clear_dirty_bbccs)();
 
   CLG_DEBUG(1, "- print_bbccs(tid %d)\n", CLG_(current_tid));
 }
 
 
-static void print_bbccs(const HChar* trigger, Bool only_current_thread)
+static void print_bbccs(const HChar* trigger, Bool only_current_thread,
+			Bool final)
 {
   init_dump_array();
-  init_debug_cache();
 
   print_fd = -1;
   print_trigger = trigger;
+  print_final = final;
 
   if (!CLG_(clo).separate_threads) {
     /* All BBCC/JCC costs is stored for thread 1 */
@@ -1615,7 +2052,188 @@ static void print_bbccs(const HChar* trigger, Bool only_current_thread)
 }
 
 
-void CLG_(dump_profile)(const HChar* trigger, Bool only_current_thread)
+/*------------------------------------------------------------*/
+/*--- Asynchronous dumping                                 ---*/
+/*------------------------------------------------------------*/
+
+/* With --async-dump=yes, a dump is written by a forked child process,
+ * working on a copy-on-write snapshot of all cost centers. Meanwhile,
+ * the parent only does the state changes of a dump: counters are
+ * zeroed and dumped costs are added to the totals, without sorting,
+ * debug info lookup and formatting.
+ */
+
+#define ASYNC_DUMPERS_MAX 4
+
+static Int dumper_pid[ASYNC_DUMPERS_MAX];
+static Int dumpers = 0;
+
+/* Returns False if dumper <pid> is still running */
+static Bool reap_dumper(Int pid, Bool block)
+{
+   Int res, status = 0, options = block ? 0 : VKI_WNOHANG;
+
+#if defined(VGO_linux)
+   options |= __VKI_WCLONE;
+#endif
+   res = VG_(waitpid)(pid, &status, options);
+   if (res == 0) return False;
+
+   /* on error, it is not our child (e.g. after a fork of the client) */
+   if ((res == pid) && (status != 0))
+      VG_(message)(Vg_UserMsg,
+		   "Warning: asynchronous dump process %d failed\n", pid);
+   return True;
+}
+
+/* Remove finished dumpers; if <max> are still running, wait for
+ * the oldest ones to finish */
+static void reap_dumpers(Int max)
+{
+   Int i, j;
+
+   for(i = 0, j = 0; i < dumpers; i++) {
+      if (reap_dumper(dumper_pid[i], dumpers - i > max)) continue;
+      dumper_pid[j++] = dumper_pid[i];
+   }
+   dumpers = j;
+}
+
+/* Parent side of an asynchronous dump for a BBCC: same state changes as
+ * in fprint_bbcc(), without writing */
+static void zero_dumped_bbcc(BBCC* bbcc)
+{
+  BB* bb = bbcc->bb;
+  ULong ecounter = bbcc->ecounter_sum;
+  UInt instr, jmp = 0;
+  Int i;
+  jCC* jcc;
+
+  /* self cost is moved into dump totals */
+  for(instr=0; instr<bb->instr_count; instr++) {
+    (*CLG_(cachesim).add_icost)(dump_total_cost, bbcc,
+				&(bb->instr[instr]), ecounter);
+
+    if (jmp < bb->cjmp_count)
+      if (bb->jmp[jmp].instr == instr) {
+	ecounter -= bbcc->jmp[jmp].ecounter;
+	jmp++;
+      }
+  }
+  if (bbcc->skipped)
+    CLG_(add_and_zero_cost)( CLG_(sets).full,
+			     dump_total_cost, bbcc->skipped );
+
+  for(i=0; i<=bb->cjmp_count; i++) {
+    for(jcc=bbcc->jmp[i].jcc_list; jcc; jcc=jcc->next_from) {
+      if (jcc->jmpkind != jk_Call)
+	jcc->call_counter = 0;
+      else if (!CLG_(is_zero_cost)( CLG_(sets).full, jcc->cost )) {
+	CLG_(init_cost)( CLG_(sets).full, jcc->cost );
+	jcc->call_counter = 0;
+      }
+    }
+  }
+  zero_bbcc_counters(bbcc);
+}
+
+/* BBCCs included in a dump, see hash_addPtr() */
+static void zero_dumped_bbcc_with_cost(BBCC* bbcc)
+{
+  if ((bbcc->ecounter_sum == 0) &&
+      (bbcc->ret_counter == 0)) return;
+
+  zero_dumped_bbcc(bbcc);
+}
+
+/* BBCCs with active calls are dumped even without own cost,
+ * see cs_addPtr() */
+static void zero_dumped_call_stack(thread_info* ti)
+{
+  Int i;
+
+  for(i = 0; i < CLG_(current_call_stack).sp; i++) {
+    call_entry* e = &(CLG_(current_call_stack).entry[i]);
+    if (e->jcc == 0) continue;
+
+    zero_dumped_bbcc(e->jcc->from);
+  }
+}
+
+/* Parent side of an asynchronous dump for a thread,
+ * see print_bbccs_of_thread() */
+static void zero_dumped_bbccs_of_thread(thread_info* ti)
+{
+  static FullCost sum = 0;
+
+  CLG_(init_cost_lz)( CLG_(sets).full, &sum );
+  summary_cost(sum);
+  init_dump_total_cost(sum);
+
+  /* active calls get the costs up to now, as in prepare_dump() */
+  if (CLG_(clo).separate_threads)
+    cs_addCount(0);
+  else
+    CLG_(forall_threads)(cs_addCount);
+
+  CLG_(forall_dirty_bbccs)(zero_dumped_bbcc_with_cost);
+  if (CLG_(clo).separate_threads)
+    zero_dumped_call_stack(0);
+  else
+    CLG_(forall_threads)(zero_dumped_call_stack);
+
+  CLG_(add_cost_lz)(CLG_(sets).full,
+		    &CLG_(total_cost), dump_total_cost);
+  set_lastdump_cost(ti);
+  CLG_(clear_dirty_bbccs)();
+}
+
+static void zero_dumped_bbccs(Bool only_current_thread)
+{
+  if (!CLG_(clo).separate_threads) {
+    Int orig_tid = CLG_(current_tid);
+
+    CLG_(switch_thread)(1);
+    zero_dumped_bbccs_of_thread( CLG_(get_current_thread)() );
+    CLG_(switch_thread)(orig_tid);
+  }
+  else if (only_current_thread)
+    zero_dumped_bbccs_of_thread( CLG_(get_current_thread)() );
+  else
+    CLG_(forall_threads)(zero_dumped_bbccs_of_thread);
+}
+
+/* Write profile from a forked process. Returns False if not possible */
+static Bool print_bbccs_async(const HChar* trigger,
+			      Bool only_current_thread)
+{
+  Int pid;
+
+  reap_dumpers(ASYNC_DUMPERS_MAX-1);
+
+  pid = VG_(fork_helper)();
+  if (pid < 0) return False;
+
+  if (pid == 0) {
+    /* child: write and exit, without any further action of the tool */
+    print_bbccs(trigger, only_current_thread, False);
+    VG_(exit)(0);
+  }
+
+  dumper_pid[dumpers++] = pid;
+  zero_dumped_bbccs(only_current_thread);
+
+  return True;
+}
+
+/* Wait for all asynchronous dumps to be written */
+void CLG_(wait_async_dumps)()
+{
+  reap_dumpers(0);
+}
+
+static void dump_profile(const HChar* trigger, Bool only_current_thread,
+			 Bool final)
 {
    CLG_DEBUG(2, "+ dump_profile(Trigger '%s')\n",
 	    trigger ? trigger : "Prg.Term.");
@@ -1629,7 +2247,13 @@ void CLG_(dump_profile)(const HChar* trigger, Bool only_current_thread)
 
    out_counter++;
 
-   print_bbccs(trigger, only_current_thread);
+   /* appending to the same file has to be done in order */
+   if (!CLG_(clo).async_dump || final || CLG_(clo).combine_dumps ||
+       !print_bbccs_async(trigger, only_current_thread)) {
+       CLG_(wait_async_dumps)();
+       print_bbccs(trigger, only_current_thread, final);
+   }
+   CLG_(sample_reset_estimates)();
 
    bbs_done = CLG_(stat).bb_executions++;
 
@@ -1637,6 +2261,19 @@ void CLG_(dump_profile)(const HChar* trigger, Bool only_current_thread)
      VG_(message)(Vg_DebugMsg, "Dumping done.\n");
 }
 
+void CLG_(dump_profile)(const HChar* trigger, Bool only_current_thread)
+{
+   dump_profile(trigger, only_current_thread, trigger == 0);
+}
+
+/* Last dump of a run, written to the file without part suffix.
+ * <trigger> is 0 for normal program termination.
+ */
+void CLG_(dump_final_profile)(const HChar* trigger)
+{
+   dump_profile(trigger, False, True);
+}
+
 /* Copy command to cmd buffer. We want to original command line
  * (can change at runtime)
  */
@@ -1682,14 +2319,13 @@ void CLG_(init_dumps)()
    Int lastSlash, i;
    SysRes res;
 
-   static int thisPID = 0;
    int currentPID = VG_(getpid)();
-   if (currentPID == thisPID) {
+   if (currentPID == dump_pid) {
        /* already initialized, and no PID change */
        CLG_ASSERT(out_file != 0);
        return;
    }
-   thisPID = currentPID;
+   dump_pid = currentPID;
    
    if (!CLG_(clo).out_format)
      CLG_(clo).out_format = DEFAULT_OUTFORMAT;
@@ -29,7 +29,7 @@
 #include "global.h"
 
 /* This should be 2**MAX_EVENTGROUP_COUNT */
-#define MAX_EVENTSET_COUNT 1024
+#define MAX_EVENTSET_COUNT 2048
 
 static EventGroup* eventGroup[MAX_EVENTGROUP_COUNT];
 static EventSet* eventSetTable[MAX_EVENTSET_COUNT];
@@ -110,6 +110,17 @@ EventGroup* CLG_(register_event_group4)(int id, const HChar* n1,
     return eg;
 }
 
+EventGroup* CLG_(register_event_groupN)(int id, int n, const HChar** names)
+{
+    EventGroup* eg = new_event_group(id, n);
+    int i;
+
+    for(i=0; i<n; i++)
+	eg->name[i] = names[i];
+
+    return eg;
+}
+
 EventGroup* CLG_(get_event_group)(int id)
 {
     CLG_ASSERT(id>=0 && id<MAX_EVENTGROUP_COUNT);
@@ -43,7 +43,7 @@
  * A group can appear at most once in a event set.
  */
 
-#define MAX_EVENTGROUP_COUNT 10
+#define MAX_EVENTGROUP_COUNT 11
 
 typedef struct _EventGroup EventGroup;
 struct _EventGroup {
@@ -58,6 +58,7 @@ EventGroup* CLG_(register_event_group3)(int id, const HChar*, const HChar*,
                                         const HChar*);
 EventGroup* CLG_(register_event_group4)(int id, const HChar*, const HChar*,
                                         const HChar*, const HChar*);
+EventGroup* CLG_(register_event_groupN)(int id, int n, const HChar**);
 EventGroup* CLG_(get_event_group)(int id);
 
 /* Event sets are defined by event groups they consist of. */
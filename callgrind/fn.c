@@ -202,42 +202,94 @@ static Bool search_runtime_resolve(obj_node* obj)
 /*--- Object/File/Function hash entry operations           ---*/
 /*------------------------------------------------------------*/
 
-/* Object hash table, fixed */
-static obj_node* obj_table[N_OBJ_ENTRIES];
+/* Names are interned: each distinct string is stored only once, such
+ * that names can be compared by pointer. Object, file and function
+ * nodes are found in global tables keyed by their interned name and
+ * parent node. All tables grow as needed (see hash.c).
+ */
+static hash_table str_table;
+static hash_table obj_table;
+static hash_table file_table;
+static hash_table fn_table;
 
-void CLG_(init_obj_table)()
-{
-    Int i;
-    for (i = 0; i < N_OBJ_ENTRIES; i++)
-	obj_table[i] = 0;
-}
+static cc_arena str_arena;
 
-#define HASH_CONSTANT   256
+#define N_STR_INITIAL_ENTRIES  1024
+#define N_OBJ_INITIAL_ENTRIES  64
+#define N_FILE_INITIAL_ENTRIES 1024
+#define N_FN_INITIAL_ENTRIES   4096
 
-static UInt str_hash(const HChar *s, UInt table_size)
+static UWord str_hash(const HChar *s)
 {
-    int hash_value = 0;
+    UWord hash_value = 0;
     for ( ; *s; s++)
-        hash_value = (HASH_CONSTANT * hash_value + *s) % table_size;
+        hash_value = hash_value * 31 + (UChar)*s;
     return hash_value;
 }
 
+static Bool str_eq(void* entry, UWord hash, UWord unused, void* s)
+{
+    return VG_(strcmp)((const HChar*) entry, (const HChar*) s) == 0;
+}
+
+static Bool obj_eq(void* entry, UWord name, UWord unused, void* arg)
+{
+    return ((obj_node*) entry)->name == (const HChar*) name;
+}
+
+static Bool file_eq(void* entry, UWord name, UWord obj, void* arg)
+{
+    file_node* file = (file_node*) entry;
+    return (file->name == (const HChar*) name) &&
+	   (file->obj == (obj_node*) obj);
+}
+
+static Bool fn_eq(void* entry, UWord name, UWord file, void* arg)
+{
+    fn_node* fn = (fn_node*) entry;
+    return (fn->name == (const HChar*) name) &&
+	   (fn->file == (file_node*) file);
+}
+
+void CLG_(init_obj_table)()
+{
+    CLG_(init_hash)(&str_table, "cl.fn.iot.1", N_STR_INITIAL_ENTRIES,
+		    str_eq, 0);
+    CLG_(init_hash)(&obj_table, "cl.fn.iot.2", N_OBJ_INITIAL_ENTRIES,
+		    obj_eq, 0);
+    CLG_(init_hash)(&file_table, "cl.fn.iot.3", N_FILE_INITIAL_ENTRIES,
+		    file_eq, 0);
+    CLG_(init_hash)(&fn_table, "cl.fn.iot.4", N_FN_INITIAL_ENTRIES,
+		    fn_eq, 0);
+    CLG_(init_arena)(&str_arena, "cl.fn.is.1");
+}
+
+/* Unique copy of string <s> */
+const HChar* CLG_(intern_string)(const HChar* s)
+{
+    UWord hash = str_hash(s);
+    HChar* str;
+
+    str = (HChar*) CLG_(hash_lookup)(&str_table, hash, 0, (void*)s);
+    if (str) return str;
+
+    str = (HChar*) CLG_(arena_alloc)(&str_arena, VG_(strlen)(s)+1);
+    VG_(strcpy)(str, s);
+    CLG_(hash_insert)(&str_table, hash, 0, str);
+    return str;
+}
+
 
 static const HChar* anonymous_obj = "???";
 
 static __inline__ 
-obj_node* new_obj_node(DebugInfo* di, obj_node* next)
+obj_node* new_obj_node(DebugInfo* di, const HChar* name)
 {
    Int i;
    obj_node* obj;
 
    obj = (obj_node*) CLG_MALLOC("cl.fn.non.1", sizeof(obj_node));
-   obj->name  = di ? VG_(strdup)( "cl.fn.non.2",
-                                  VG_(DebugInfo_get_filename)(di) )
-                   : anonymous_obj;
-   for (i = 0; i < N_FILE_ENTRIES; i++) {
-      obj->files[i] = NULL;
-   }
+   obj->name  = name;
    CLG_(stat).distinct_objs ++;
    obj->number  = CLG_(stat).distinct_objs;
    /* JRS 2008 Feb 19: maybe rename .start/.size/.offset to
@@ -246,7 +298,6 @@ obj_node* new_obj_node(DebugInfo* di, obj_node* next)
    obj->start   = di ? VG_(DebugInfo_get_text_avma)(di) : 0;
    obj->size    = di ? VG_(DebugInfo_get_text_size)(di) : 0;
    obj->offset  = di ? VG_(DebugInfo_get_text_bias)(di) : 0;
-   obj->next    = next;
 
    // not only used for debug output (see static.c)
    obj->last_slash_pos = 0;
@@ -256,6 +307,8 @@ obj_node* new_obj_node(DebugInfo* di, obj_node* next)
 	i++;
    }
 
+   CLG_(hash_insert)(&obj_table, (UWord)name, 0, obj);
+
    if (runtime_resolve_addr == 0) search_runtime_resolve(obj);
 
    return obj;
@@ -264,42 +317,32 @@ obj_node* new_obj_node(DebugInfo* di, obj_node* next)
 obj_node* CLG_(get_obj_node)(DebugInfo* di)
 {
     obj_node*    curr_obj_node;
-    UInt         objname_hash;
     const HChar* obj_name;
     
-    obj_name = di ? VG_(DebugInfo_get_filename)(di) : anonymous_obj;
+    obj_name = CLG_(intern_string)(di ? VG_(DebugInfo_get_filename)(di)
+				      : anonymous_obj);
 
     /* lookup in obj hash */
-    objname_hash = str_hash(obj_name, N_OBJ_ENTRIES);
-    curr_obj_node = obj_table[objname_hash];
-    while (NULL != curr_obj_node && 
-	   VG_(strcmp)(obj_name, curr_obj_node->name) != 0) {
-	curr_obj_node = curr_obj_node->next;
-    }
-    if (NULL == curr_obj_node) {
-	obj_table[objname_hash] = curr_obj_node = 
-	    new_obj_node(di, obj_table[objname_hash]);
-    }
+    curr_obj_node = (obj_node*) CLG_(hash_lookup)(&obj_table,
+						  (UWord)obj_name, 0, 0);
+    if (NULL == curr_obj_node)
+	curr_obj_node = new_obj_node(di, obj_name);
 
     return curr_obj_node;
 }
 
 
 static __inline__ 
-file_node* new_file_node(HChar filename[FILENAME_LEN],
-			 obj_node* obj, file_node* next)
+file_node* new_file_node(const HChar* filename, obj_node* obj)
 {
-  Int i;
   file_node* file = (file_node*) CLG_MALLOC("cl.fn.nfn.1",
                                            sizeof(file_node));
-  file->name  = VG_(strdup)("cl.fn.nfn.2", filename);
-  for (i = 0; i < N_FN_ENTRIES; i++) {
-    file->fns[i] = NULL;
-  }
+  file->name  = filename;
   CLG_(stat).distinct_files++;
   file->number  = CLG_(stat).distinct_files;
   file->obj     = obj;
-  file->next      = next;
+
+  CLG_(hash_insert)(&file_table, (UWord)filename, (UWord)obj, file);
   return file;
 }
 
@@ -307,21 +350,15 @@ file_node* new_file_node(HChar filename[FILENAME_LEN],
 file_node* CLG_(get_file_node)(obj_node* curr_obj_node,
                                HChar filename[FILENAME_LEN])
 {
-    file_node* curr_file_node;
-    UInt       filename_hash;
+    file_node*   curr_file_node;
+    const HChar* name = CLG_(intern_string)(filename);
 
     /* lookup in file hash */
-    filename_hash = str_hash(filename, N_FILE_ENTRIES);
-    curr_file_node = curr_obj_node->files[filename_hash];
-    while (NULL != curr_file_node && 
-	   VG_(strcmp)(filename, curr_file_node->name) != 0) {
-	curr_file_node = curr_file_node->next;
-    }
-    if (NULL == curr_file_node) {
-	curr_obj_node->files[filename_hash] = curr_file_node = 
-	    new_file_node(filename, curr_obj_node, 
-			  curr_obj_node->files[filename_hash]);
-    }
+    curr_file_node = (file_node*) CLG_(hash_lookup)(&file_table,
+						    (UWord)name,
+						    (UWord)curr_obj_node, 0);
+    if (NULL == curr_file_node)
+	curr_file_node = new_file_node(name, curr_obj_node);
 
     return curr_file_node;
 }
@@ -330,19 +367,18 @@ file_node* CLG_(get_file_node)(obj_node* curr_obj_node,
 static void resize_fn_array(void);
 
 static __inline__ 
-fn_node* new_fn_node(HChar fnname[FILENAME_LEN],
-		     file_node* file, fn_node* next)
+fn_node* new_fn_node(const HChar* fnname, file_node* file)
 {
     fn_node* fn = (fn_node*) CLG_MALLOC("cl.fn.nfnnd.1",
                                          sizeof(fn_node));
-    fn->name = VG_(strdup)("cl.fn.nfnnd.2", fnname);
+    fn->name = fnname;
 
     CLG_(stat).distinct_fns++;
     fn->number   = CLG_(stat).distinct_fns;
     fn->last_cxt = 0;
     fn->pure_cxt = 0;
+    fn->folded_hash = 0;
     fn->file     = file;
-    fn->next     = next;
 
     fn->dump_before  = False;
     fn->dump_after   = False;
@@ -353,6 +389,7 @@ fn_node* new_fn_node(HChar fnname[FILENAME_LEN],
     fn->is_malloc    = False;
     fn->is_realloc   = False;
     fn->is_free      = False;
+    fn->folded       = False;
 
     fn->group        = 0;
     fn->separate_callers    = CLG_(clo).separate_callers;
@@ -365,6 +402,7 @@ fn_node* new_fn_node(HChar fnname[FILENAME_LEN],
     if (CLG_(stat).distinct_fns >= current_fn_active.size)
 	resize_fn_array();
 
+    CLG_(hash_insert)(&fn_table, (UWord)fnname, (UWord)file, fn);
     return fn;
 }
 
@@ -376,23 +414,17 @@ static
 fn_node* get_fn_node_infile(file_node* curr_file_node,
 			    HChar fnname[FN_NAME_LEN])
 {
-    fn_node* curr_fn_node;
-    UInt     fnname_hash;
+    fn_node*     curr_fn_node;
+    const HChar* name;
 
     CLG_ASSERT(curr_file_node != 0);
 
     /* lookup in function hash */
-    fnname_hash = str_hash(fnname, N_FN_ENTRIES);
-    curr_fn_node = curr_file_node->fns[fnname_hash];
-    while (NULL != curr_fn_node && 
-	   VG_(strcmp)(fnname, curr_fn_node->name) != 0) {
-	curr_fn_node = curr_fn_node->next;
-    }
-    if (NULL == curr_fn_node) {
-	curr_file_node->fns[fnname_hash] = curr_fn_node = 
-            new_fn_node(fnname, curr_file_node,
-			curr_file_node->fns[fnname_hash]);
-    }
+    name = CLG_(intern_string)(fnname);
+    curr_fn_node = (fn_node*) CLG_(hash_lookup)(&fn_table, (UWord)name,
+						(UWord)curr_file_node, 0);
+    if (NULL == curr_fn_node)
+	curr_fn_node = new_fn_node(name, curr_file_node);
 
     return curr_fn_node;
 }
@@ -57,7 +57,12 @@ struct _CommandLineOptions {
 
   /* Dump format options */
   const HChar* out_format;  /* Format string for callgrind output file name */
+  Bool binary_format;       /* Dump in binary instead of text format? */
   Bool combine_dumps;       /* Dump trace parts into same file? */
+  Bool async_dump;          /* Write dumps from a forked process? */
+  Bool delta_dumps;         /* Reference previous dump as base? */
+  Bool live_stats;          /* Publish counters in a shared file? */
+  Bool dump_index;          /* Write an index file next to each dump? */
   Bool compress_strings;
   Bool compress_events;
   Bool compress_pos;
@@ -70,11 +75,13 @@ struct _CommandLineOptions {
   
   /* Dump generation options */
   ULong dump_every_bb;     /* Dump every xxx BBs. */
+  ULong max_instructions;  /* Terminate after xxx instructions. */
   
   /* Collection options */
   Bool separate_threads; /* Separate threads in dump? */
   Int  separate_callers; /* Separate dependent on how many callers? */
   Int  separate_recursions; /* Max level of recursions to separate */
+  ULong max_context_memory; /* Fold new contexts above this size [bytes] */
   Bool skip_plt;         /* Skip functions in PLT section? */
   Bool skip_direct_recursion; /* Increment direct recursions the level? */
 
@@ -85,11 +92,18 @@ struct _CommandLineOptions {
   Bool collect_systime;  /* Collect time for system calls */
 
   Bool collect_bus;      /* Collect global bus events */
+  Bool collect_mix;      /* Collect instruction mix */
+  const HChar* cost_model; /* Builtin model or file for cycle estimation */
 
   /* Instrument options */
   Bool instrument_atstart;  /* Instrument at start? */
   Bool simulate_cache;      /* Call into cache simulator ? */
   Bool simulate_branch;     /* Call into branch prediction simulator ? */
+  Bool count_only;          /* Only inline Ir counting, no call graph ? */
+  Bool fast_instr_toggle;   /* Guard instrumentation instead of discarding
+                               translations on toggle ? */
+  Bool release_at_instr_off; /* Dump and free cost centers when switching
+                                instrumentation off ? */
 
   /* Call graph generation */
   Bool pop_on_jump;       /* Handle a jump between functions as ret+call */
@@ -116,6 +130,10 @@ struct _CommandLineOptions {
 /* Minimum cache line size allowed */
 #define MIN_LINE_SIZE   16
 
+/* Exit code when terminating because of --max-instructions,
+ * the same as used by timeout(1) */
+#define MAX_INSTRUCTIONS_EXITCODE       124
+
 /* Size of various buffers used for storing strings */
 #define FILENAME_LEN                    VKI_PATH_MAX
 #define FN_NAME_LEN                    4096 /* for C++ code :-) */
@@ -198,6 +216,8 @@ struct _Statistics {
   Int  fn_array_resizes;
   Int  call_stack_resizes;
   Int  fn_stack_resizes;
+  Int  arena_chunks;
+  Int  cc_releases;
 
   Int  full_debug_BBs;
   Int  file_line_debug_BBs;
@@ -207,6 +227,12 @@ struct _Statistics {
   Int  jcc_lru_misses;
   Int  cxt_lru_misses;
   Int  bbcc_clones;
+
+  /* for --max-context-memory */
+  ULong context_memory;    /* Contexts */
+  ULong clone_memory;      /* BBCC clones for contexts/recursion levels */
+  Int  folded_contexts;
+  Int  folded_recursions;
 };
 
 
@@ -253,8 +279,7 @@ typedef enum {
  * <next_from> in the JCC struct.
  *
  * For fast lookup, JCCs are reachable with a hash table, keyed by
- * the (from_bbcc,to) pair. <next_hash> is used for the JCC chain
- * of one hash table entry.
+ * the (from_bbcc,jmp,to) triple.
  *
  * Cost <sum> holds event counts for already returned executions.
  * <last> are the event counters at last enter of the subroutine.
@@ -267,7 +292,6 @@ typedef enum {
 
 struct _jCC {
   ClgJumpKind jmpkind; /* jk_Call, jk_Jump, jk_CondJump */
-  jCC* next_hash;   /* for hash entry chain */
   jCC* next_from;   /* next JCC from a BBCC */
   BBCC *from, *to;  /* call arc from/to this BBCC */
   UInt jmp;         /* jump no. in source */
@@ -287,10 +311,25 @@ struct _InstrInfo {
   UInt instr_size;
   UInt cost_offset;
   EventSet* eventset;
+  UChar mix;           /* instruction class (MIX_*), with --collect-mix */
+  UShort weight;       /* estimated cycles, with --cost-model */
 };
 
 
 
+/*
+ * Source position of a run of instructions in a BB, starting at
+ * instruction <first> up to the start of the next run
+ */
+typedef struct _PosRun PosRun;
+struct _PosRun {
+  UInt first;
+  UInt line;
+  file_node* file;
+  Bool found;          /* False if there is no debug info */
+};
+
+
 /*
  * Info for a side exit in a BB
  */
@@ -320,7 +359,6 @@ struct _CJmpInfo {
 struct _BB {
   obj_node*  obj;         /* ELF object of BB */
   PtrdiffT   offset;      /* offset of BB in ELF object file */
-  BB*        next;       /* chaining for a hash entry */
 
   VgSectKind sect_kind;  /* section of this BB, e.g. PLT */
   UInt       instr_count;
@@ -338,6 +376,13 @@ struct _BB {
   CJmpInfo*  jmp;         /* array of info for condition jumps,
 			   * allocated directly after this struct */
   Bool       cjmp_inverted; /* is last side exit actually fall through? */
+  UShort*    mix;         /* with --collect-mix: per side exit, number of
+			   * instructions of each class up to the exit,
+			   * allocated directly after the jmp array */
+  UInt*      cycles;      /* with --cost-model: per side exit, estimated
+			   * cycles up to the exit, allocated at the end */
+  UInt       pos_count;   /* number of source position runs */
+  PosRun*    pos;         /* source positions of instructions, sorted */
 
   UInt       instr_len;
   UInt       cost_count;
@@ -364,7 +409,6 @@ struct _BB {
 struct _Context {
     UInt size;        // number of function dependencies
     UInt base_number; // for context compression & dump array
-    Context* next;    // entry chaining for hash
     UWord hash;       // for faster lookup...
     fn_node* fn[0];
 };
@@ -408,13 +452,14 @@ struct _BBCC {
     
     BBCC*    next_bbcc;    /* Chain of BBCCs for same BB */
     BBCC*    lru_next_bbcc; /* BBCC executed next the last time */
+    BBCC*    next_dirty;   /* Chain of BBCCs changed since last dump */
+    UInt     epoch;        /* dump epoch when last put into dirty chain */
     
     jCC*     lru_from_jcc; /* Temporary: Cached for faster access (LRU) */
     jCC*     lru_to_jcc;   /* Temporary: Cached for faster access (LRU) */
     FullCost skipped;      /* cost for skipped functions called from 
 			    * jmp_addr. Allocated lazy */
     
-    BBCC*    next;         /* entry chain in hash */
     ULong*   cost;         /* start of 64bit costs for this BBCC */
     ULong    ecounter_sum; /* execution counter for first instruction of BB */
     JmpData  jmp[0];
@@ -426,12 +471,12 @@ struct _BBCC {
  */
 
 struct _fn_node {
-  HChar*     name;
+  const HChar* name;   /* interned */
   UInt       number;
   Context*   last_cxt; /* LRU info */
   Context*   pure_cxt; /* the context with only the function itself */
+  UWord      folded_hash; /* LRU info: last context folded into pure_cxt */
   file_node* file;     /* reverse mapping for 2nd hash */
-  fn_node* next;
 
   Bool dump_before :1;
   Bool dump_after :1;
@@ -444,6 +489,8 @@ struct _fn_node {
   Bool is_realloc :1;
   Bool is_free :1;
 
+  Bool folded :1; /* new contexts folded into pure_cxt (max_context_memory) */
+
   Int  group;
   Int  separate_callers;
   Int  separate_recursions;
@@ -454,17 +501,15 @@ struct _fn_node {
 
 /* Quite arbitrary fixed hash sizes */
 
-#define   N_OBJ_ENTRIES         47
-#define  N_FILE_ENTRIES         53
-#define    N_FN_ENTRIES         87
 #define N_BBCC2_ENTRIES         37
 
+/* Object, file and function nodes are found via global hash tables,
+ * keyed by their interned name and the parent node (see fn.c) */
+
 struct _file_node {
-   HChar*     name;
-   fn_node*   fns[N_FN_ENTRIES];
+   const HChar* name;  /* interned */
    UInt       number;
    obj_node*  obj;
-   file_node* next;
 };
 
 /* If an object is dlopened multiple times, we hope that <name> is unique;
@@ -472,16 +517,14 @@ struct _file_node {
  * zero when object is unmapped (possible at dump time).
  */
 struct _obj_node {
-   const HChar* name;
+   const HChar* name;  /* interned */
    UInt       last_slash_pos;
 
    Addr       start;  /* Start address of text segment mapping */
    SizeT      size;   /* Length of mapping */
    PtrdiffT   offset; /* Offset between symbol address and file offset */
 
-   file_node* files[N_FILE_ENTRIES];
    UInt       number;
-   obj_node*  next;
 };
 
 /* an entry in the callstack
@@ -529,39 +572,90 @@ struct _exec_state {
   Context* cxt;
   
   Int   jmps_passed; /* number of conditional jumps passed in last BB */
+  Int   ir_passed;   /* instructions executed in last BB (--count-only) */
   BBCC* bbcc;      /* last BB executed */
   BBCC* nonskipped;
 
   Int call_stack_bottom; /* Index into fn_stack */
 };
 
+/* Open addressing hash table, used for BBs, BBCCs, JCCs and contexts.
+ *
+ * Slots are probed linearly. Each slot holds the full hash value of
+ * its entry inline, so probing only touches the slot array; an entry
+ * is only dereferenced to compare its key if the hash value matches.
+ * When growing, the old slot array is kept and moved over in small
+ * steps on following insertions, to avoid long pauses.
+ */
+typedef struct _hash_slot hash_slot;
+struct _hash_slot {
+  UWord hash;
+  void* entry;         /* 0 for empty slot */
+};
+
+typedef struct _hash_table hash_table;
+struct _hash_table {
+  UInt size, entries;  /* size is a power of 2 */
+  hash_slot* slots;
+  UInt old_size, old_pos;
+  hash_slot* old_slots; /* slots still to be moved over, or 0 */
+  /* does entry have given key? <arg> is passed through from lookup */
+  Bool (*eq)(void* entry, UWord key1, UWord key2, void* arg);
+  const HChar* cc;     /* cost centre for allocations */
+  Int* resizes;        /* resize statistics counter */
+};
+
+/* Arena for cost center objects (BBs, BBCCs, JCCs, contexts and their
+ * cost arrays). Objects are cut from large chunks, with a free list
+ * per object size for reuse. All objects of an arena can be released
+ * at once.
+ */
+#define ARENA_ALIGN    16
+#define ARENA_CLASSES  128  /* sizes with free lists: below 2 kB */
+
+typedef struct _ArenaChunk ArenaChunk;
+typedef struct _cc_arena cc_arena;
+struct _cc_arena {
+  const HChar* cc;     /* cost centre for allocations */
+  ArenaChunk* chunks;  /* all chunks, for bulk release */
+  HChar *current, *end; /* free space in current chunk */
+  void* free[ARENA_CLASSES]; /* free lists, indexed by size/ARENA_ALIGN */
+};
+
 /* Global state structures */
 typedef struct _bb_hash bb_hash;
 struct _bb_hash {
-  UInt size, entries;
-  BB** table;
+  hash_table table;
 };
 
 typedef struct _cxt_hash cxt_hash;
 struct _cxt_hash {
-  UInt size, entries;
-  Context** table;
+  hash_table table;
 };  
 
+/* Set of file descriptors, as bitmap indexed by fd */
+typedef struct _fdset fdset;
+struct _fdset {
+  UInt size, entries; /* fds covered by bitmap, fds in set */
+  UWord* bits;
+};
+
 /* Thread specific state structures, i.e. parts of a thread state.
  * There are variables for the current state of each part,
  * on which a thread state is copied at thread switch.
  */
 typedef struct _bbcc_hash bbcc_hash;
 struct _bbcc_hash {
-  UInt size, entries;
-  BBCC** table;
+  hash_table table;
+  cc_arena* arena;     /* BBCCs, recursion arrays and their costs */
+  BBCC* dirty;         /* BBCCs with counters changed in this epoch */
+  UInt epoch;          /* incremented at each dump */
 };
 
 typedef struct _jcc_hash jcc_hash;
 struct _jcc_hash {
-  UInt size, entries;
-  jCC** table;
+  hash_table table;
+  cc_arena* arena;     /* JCCs and their costs */
   jCC* spontaneous;
 };
 
@@ -613,6 +707,7 @@ struct _thread_info {
 
   /* dump statistics */
   FullCost lastdump_cost;    /* Cost at last dump */
+  Int lastdump_part;         /* Part number of last dump, 0 if none */
   FullCost sighandler_cost;
 
   /* thread specific data structure containers */
@@ -683,8 +778,18 @@ struct cachesim_if
     const HChar *log_1I0D_name, *log_2I0D_name, *log_3I0D_name;
     const HChar *log_1I1Dr_name, *log_1I1Dw_name;
     const HChar *log_0I1Dr_name, *log_0I1Dw_name;
+
+    // only update simulator state, for warm-up with sampled simulation
+    void (*warm_1I)(InstrInfo*) VG_REGPARM(1);
+    void (*warm_0I1Dr)(InstrInfo*, Addr, Word) VG_REGPARM(3);
+    void (*warm_0I1Dw)(InstrInfo*, Addr, Word) VG_REGPARM(3);
 };
 
+// phases of sampled simulation (--sample-period)
+#define SAMPLE_FASTFWD 0
+#define SAMPLE_WARMUP  1
+#define SAMPLE_DETAIL  2
+
 // set by setup_bbcc at start of every BB, and needed by log_* helpers
 extern Addr   CLG_(bb_base);
 extern ULong* CLG_(cost_base);
@@ -699,6 +804,19 @@ extern ULong* CLG_(cost_base);
 #define EG_BUS   6
 #define EG_ALLOC 7
 #define EG_SYS   8
+#define EG_MIX   9
+#define EG_CYC   10
+
+// Instruction classes, in order of events in group EG_MIX
+#define MIX_LD     0
+#define MIX_ST     1
+#define MIX_ALU    2
+#define MIX_FP     3
+#define MIX_SIMD   4
+#define MIX_DIV    5
+#define MIX_ATOM   6
+#define MIX_BR     7
+#define MIX_EVENTS 8
 
 struct event_sets {
     EventSet *base, *full;
@@ -722,7 +840,19 @@ void CLG_(print_debug_usage)(void);
 
 /* from sim.c */
 extern struct cachesim_if CLG_(cachesim);
+extern const HChar* CLG_(mix_events)[MIX_EVENTS];
+extern Bool  CLG_(sampling);
+extern UChar CLG_(sample_phase);
+extern Long  CLG_(sample_left);
 void CLG_(init_eventsets)(void);
+void CLG_(sample_next_phase)(void);
+void CLG_(sample_reset_estimates)(void);
+Bool CLG_(sample_desc)(HChar* buf, Int i, ULong ir);
+
+/* from costmodel.c */
+void CLG_(init_cost_model)(void);
+UShort CLG_(class_weight)(UChar cl);
+UShort CLG_(op_weight)(IROp op);
 
 /* from main.c */
 Bool CLG_(get_debug_info)(Addr, HChar filename[FILENAME_LEN],
@@ -730,15 +860,38 @@ Bool CLG_(get_debug_info)(Addr, HChar filename[FILENAME_LEN],
 void CLG_(collectBlockInfo)(IRSB* bbIn, UInt*, UInt*, Bool*);
 void CLG_(set_instrument_state)(const HChar*,Bool);
 void CLG_(dump_profile)(const HChar* trigger,Bool only_current_thread);
+void CLG_(dump_final_profile)(const HChar* trigger);
+void CLG_(wait_async_dumps)(void);
 void CLG_(zero_all_cost)(Bool only_current_thread);
 Int CLG_(get_dump_counter)(void);
 void CLG_(fini)(Int exitcode);
+void CLG_(max_instructions_reached)(void);
+
+/* from hash.c */
+void  CLG_(init_hash)(hash_table* h, const HChar* cc, UInt size,
+		      Bool (*eq)(void* entry, UWord key1, UWord key2, void* arg),
+		      Int* resizes);
+void* CLG_(hash_lookup)(hash_table* h, UWord key1, UWord key2, void* arg);
+void  CLG_(hash_insert)(hash_table* h, UWord key1, UWord key2, void* entry);
+Bool  CLG_(hash_remove)(hash_table* h, UWord key1, UWord key2, void* entry);
+void* CLG_(hash_next)(hash_table* h, UInt* pos);
+void  CLG_(hash_clear)(hash_table* h);
+
+/* from arena.c */
+void      CLG_(init_arena)(cc_arena* a, const HChar* cc);
+cc_arena* CLG_(new_arena)(const HChar* cc);
+void*     CLG_(arena_alloc)(cc_arena* a, SizeT size);
+void      CLG_(arena_free)(cc_arena* a, void* p, SizeT size);
+void      CLG_(arena_release)(cc_arena* a);
 
 /* from bb.c */
 void CLG_(init_bb_hash)(void);
 bb_hash* CLG_(get_bb_hash)(void);
 BB*  CLG_(get_bb)(Addr addr, IRSB* bb_in, Bool *seen_before);
 void CLG_(delete_bb)(Addr addr);
+void CLG_(forget_bbccs)(void);
+void CLG_(init_bb_pos)(BB* bb);
+PosRun* CLG_(get_bb_pos)(BB* bb, UInt instr);
 
 static __inline__ Addr bb_addr(BB* bb)
  { return bb->offset + bb->obj->offset; }
@@ -754,6 +907,7 @@ void CLG_(set_current_fn_array)(fn_array*);
 UInt* CLG_(get_fn_entry)(Int n);
 
 void      CLG_(init_obj_table)(void);
+const HChar* CLG_(intern_string)(const HChar* s);
 obj_node* CLG_(get_obj_node)(DebugInfo* si);
 file_node* CLG_(get_file_node)(obj_node*, HChar* filename);
 fn_node*  CLG_(get_fn_node)(BB* bb);
@@ -764,7 +918,12 @@ void CLG_(copy_current_bbcc_hash)(bbcc_hash* dst);
 bbcc_hash* CLG_(get_current_bbcc_hash)(void);
 void CLG_(set_current_bbcc_hash)(bbcc_hash*);
 void CLG_(forall_bbccs)(void (*func)(BBCC*));
+void CLG_(forall_dirty_bbccs)(void (*func)(BBCC*));
+void CLG_(mark_dirty_bbcc)(BBCC* bbcc);
+void CLG_(clear_dirty_bbccs)(void);
 void CLG_(zero_bbcc)(BBCC* bbcc);
+void CLG_(init_skipped_cost)(BBCC* bbcc);
+void CLG_(release_current_bbccs)(void);
 BBCC* CLG_(get_bbcc)(BB* bb);
 BBCC* CLG_(clone_bbcc)(BBCC* orig, Context* cxt, Int rec_index);
 void CLG_(setup_bbcc)(BB* bb) VG_REGPARM(1);
@@ -776,6 +935,7 @@ void CLG_(copy_current_jcc_hash)(jcc_hash* dst);
 jcc_hash* CLG_(get_current_jcc_hash)(void);
 void CLG_(set_current_jcc_hash)(jcc_hash*);
 jCC* CLG_(get_jcc)(BBCC* from, UInt, BBCC* to);
+void CLG_(release_current_jccs)(void);
 
 /* from callstack.c */
 void CLG_(init_call_stack)(call_stack*);
@@ -797,6 +957,7 @@ void CLG_(init_cxt_table)(void);
 cxt_hash* CLG_(get_cxt_hash)(void);
 Context* CLG_(get_cxt)(fn_node** fn);
 void CLG_(push_cxt)(fn_node* fn);
+Bool CLG_(context_memory_full)(void);
 
 /* from threads.c */
 void CLG_(init_threads)(void);
@@ -805,6 +966,7 @@ thread_info* CLG_(get_current_thread)(void);
 void CLG_(switch_thread)(ThreadId tid);
 void CLG_(forall_threads)(void (*func)(thread_info*));
 void CLG_(run_thread)(ThreadId tid);
+void CLG_(release_cost_centers)(void);
 
 void CLG_(init_exec_state)(exec_state* es);
 void CLG_(init_exec_stack)(exec_stack*);
@@ -813,6 +975,37 @@ void CLG_(set_current_exec_stack)(exec_stack*);
 void CLG_(pre_signal)(ThreadId tid, Int sigNum, Bool alt_stack);
 void CLG_(post_signal)(ThreadId tid, Int sigNum);
 void CLG_(run_post_signal_on_call_stack_bottom)(void);
+ULong CLG_(get_thread_ir)(ThreadId t);
+void CLG_(add_thread_cost)(ThreadId t, FullCost sum);
+ULong CLG_(get_total_ir)(void);
+
+/* from openclose.c */
+void CLG_(init_fdset)(fdset*);
+Bool CLG_(fdset_contains)(fdset*, Int fd);
+Bool CLG_(fdset_add)(fdset*, Int fd);
+Bool CLG_(fdset_remove)(fdset*, Int fd);
+UInt CLG_(fdset_remove_range)(fdset*, UInt first, UInt last);
+Bool CLG_(add_collect_window)(const HChar* spec);
+Int CLG_(collect_window_count)(void);
+Int CLG_(sprint_collect_window)(HChar* buf, Int i);
+void CLG_(init_openclose)(void);
+void CLG_(pre_syscall_openclose)(ThreadId tid, UInt syscallno,
+                                 UWord* args, UInt nArgs);
+void CLG_(post_syscall_openclose)(ThreadId tid, UInt syscallno,
+                                  UWord* args, UInt nArgs, SysRes res);
+
+/* from region.c */
+void CLG_(region_begin)(ThreadId tid, const HChar* name);
+Bool CLG_(region_end)(ThreadId tid, const HChar* name);
+Int CLG_(get_counters)(ThreadId tid, ULong* buf, Int n);
+Int CLG_(get_region_counters)(const HChar* name, ULong* buf, Int n);
+void CLG_(print_regions)(void);
+
+/* from live.c */
+extern ULong CLG_(live_next_update);
+void CLG_(init_live_stats)(void);
+void CLG_(update_live_stats)(void);
+void CLG_(finish_live_stats)(void);
 
 /* from dump.c */
 extern FullCost CLG_(total_cost);
@@ -831,6 +1024,8 @@ extern EventMapping* CLG_(dumpmap);
 /* Function active counter array, indexed by function number */
 extern UInt* CLG_(fn_active_array);
 extern Bool CLG_(instrument_state);
+/* Instructions left until --max-instructions is reached */
+extern Long CLG_(instr_budget);
  /* min of L1 and LL cache line sizes */
 extern Int CLG_(min_line_size);
 
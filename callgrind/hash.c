@@ -0,0 +1,280 @@
+/*--------------------------------------------------------------------*/
+/*--- Callgrind                                                    ---*/
+/*---                                                       hash.c ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Callgrind, a Valgrind tool for call tracing.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+#include "global.h"
+
+/*------------------------------------------------------------*/
+/*--- Open addressing hash tables                          ---*/
+/*------------------------------------------------------------*/
+
+/* Entry of an old slot array which already was moved over.
+ * Lookups in the old slot array have to probe beyond such slots.
+ */
+#define HASH_MOVED ((void*)1)
+
+/* Number of old slots moved over on each insertion while growing.
+ * After doubling, the table is only 3/8 filled, so moving over is
+ * finished long before the next resize is needed.
+ */
+#define HASH_MOVE_STEP 16
+
+#if VG_WORDSIZE == 8
+#define HASH_MULT 0x9E3779B97F4A7C15ULL
+#else
+#define HASH_MULT 0x9E3779B9UL
+#endif
+
+/* Fibonacci hashing: the high bits of the multiplied key are used as
+ * slot index, as the low bits of pointer keys are mostly constant.
+ */
+static __inline__
+UWord hash_val(UWord key1, UWord key2)
+{
+    return (key1 * HASH_MULT + key2) * HASH_MULT;
+}
+
+static __inline__
+UInt slot_idx(UWord hash, UInt size)
+{
+    return (UInt)(hash >> (8 * sizeof(UWord) - 32)) & (size-1);
+}
+
+static hash_slot* new_slots(const HChar* cc, UInt size)
+{
+    hash_slot* slots;
+
+    slots = (hash_slot*) CLG_MALLOC(cc, size * sizeof(hash_slot));
+    VG_(memset)(slots, 0, size * sizeof(hash_slot));
+    return slots;
+}
+
+void CLG_(init_hash)(hash_table* h, const HChar* cc, UInt size,
+		     Bool (*eq)(void* entry, UWord key1, UWord key2, void* arg),
+		     Int* resizes)
+{
+    CLG_ASSERT((size > 0) && ((size & (size-1)) == 0));
+    CLG_ASSERT(eq != 0);
+
+    h->size      = size;
+    h->entries   = 0;
+    h->slots     = new_slots(cc, size);
+    h->old_size  = 0;
+    h->old_pos   = 0;
+    h->old_slots = 0;
+    h->eq        = eq;
+    h->cc        = cc;
+    h->resizes   = resizes;
+}
+
+static __inline__
+void* probe(hash_table* h, hash_slot* slots, UInt size, UWord hash,
+	    UWord key1, UWord key2, void* arg)
+{
+    UInt i = slot_idx(hash, size);
+    hash_slot* s;
+
+    while(1) {
+	s = &(slots[i]);
+	if (s->entry == 0) return 0;
+	if ((s->hash == hash) && (s->entry != HASH_MOVED) &&
+	    (*h->eq)(s->entry, key1, key2, arg))
+	    return s->entry;
+	i = (i+1) & (size-1);
+    }
+}
+
+/* Lookup the entry with given key. <arg> is passed to the compare
+ * function of the table, for keys not fully given by <key1>/<key2>.
+ */
+void* CLG_(hash_lookup)(hash_table* h, UWord key1, UWord key2, void* arg)
+{
+    UWord hash = hash_val(key1, key2);
+    void* entry;
+
+    entry = probe(h, h->slots, h->size, hash, key1, key2, arg);
+    if (!entry && h->old_slots)
+	entry = probe(h, h->old_slots, h->old_size, hash, key1, key2, arg);
+
+    return entry;
+}
+
+static __inline__
+void put(hash_slot* slots, UInt size, UWord hash, void* entry)
+{
+    UInt i = slot_idx(hash, size);
+
+    while(slots[i].entry != 0)
+	i = (i+1) & (size-1);
+
+    slots[i].hash  = hash;
+    slots[i].entry = entry;
+}
+
+static void move_old_slots(hash_table* h, UInt count)
+{
+    hash_slot* s;
+
+    while((count > 0) && (h->old_pos < h->old_size)) {
+	s = &(h->old_slots[h->old_pos]);
+	if ((s->entry != 0) && (s->entry != HASH_MOVED)) {
+	    put(h->slots, h->size, s->hash, s->entry);
+	    s->entry = HASH_MOVED;
+	}
+	h->old_pos++;
+	count--;
+    }
+
+    if (h->old_pos == h->old_size) {
+	VG_(free)(h->old_slots);
+	h->old_slots = 0;
+	h->old_size  = 0;
+	h->old_pos   = 0;
+    }
+}
+
+/* double size of slot array; old slots are moved over lazily */
+static void grow(hash_table* h)
+{
+    if (h->old_slots)
+	move_old_slots(h, h->old_size);
+
+    h->old_slots = h->slots;
+    h->old_size  = h->size;
+    h->old_pos   = 0;
+
+    h->size  = 2 * h->old_size;
+    h->slots = new_slots(h->cc, h->size);
+
+    CLG_DEBUG(0, "Resize hash '%s': %d => %d (entries %d)\n",
+	      h->cc, h->old_size, h->size, h->entries);
+
+    if (h->resizes) (*h->resizes)++;
+}
+
+/* Insert an entry. There must be no entry with the same key yet. */
+void CLG_(hash_insert)(hash_table* h, UWord key1, UWord key2, void* entry)
+{
+    CLG_ASSERT((entry != 0) && (entry != HASH_MOVED));
+
+    /* check fill degree and resize if needed (>75%) */
+    h->entries++;
+    if (4 * (ULong)h->entries > 3 * (ULong)h->size)
+	grow(h);
+
+    if (h->old_slots)
+	move_old_slots(h, HASH_MOVE_STEP);
+
+    put(h->slots, h->size, hash_val(key1, key2), entry);
+}
+
+/* Remove slot <i> by moving following entries of the probe sequence
+ * backwards, such that no lookup stops at the emptied slot too early.
+ */
+static void remove_slot(hash_slot* slots, UInt size, UInt i)
+{
+    UInt j = i, home;
+
+    while(1) {
+	j = (j+1) & (size-1);
+	if (slots[j].entry == 0) break;
+
+	/* entry at <j> can fill the hole at <i> if its home slot is not
+	 * cyclically in (i,j] */
+	home = slot_idx(slots[j].hash, size);
+	if (((j - home) & (size-1)) >= ((j - i) & (size-1))) {
+	    slots[i] = slots[j];
+	    i = j;
+	}
+    }
+    slots[i].entry = 0;
+}
+
+/* Remove a given entry. Returns False if not found. */
+Bool CLG_(hash_remove)(hash_table* h, UWord key1, UWord key2, void* entry)
+{
+    UWord hash = hash_val(key1, key2);
+    UInt i;
+
+    i = slot_idx(hash, h->size);
+    while(h->slots[i].entry != 0) {
+	if (h->slots[i].entry == entry) {
+	    remove_slot(h->slots, h->size, i);
+	    h->entries--;
+	    return True;
+	}
+	i = (i+1) & (h->size-1);
+    }
+
+    if (h->old_slots) {
+	i = slot_idx(hash, h->old_size);
+	while(h->old_slots[i].entry != 0) {
+	    if (h->old_slots[i].entry == entry) {
+		h->old_slots[i].entry = HASH_MOVED;
+		h->entries--;
+		return True;
+	    }
+	    i = (i+1) & (h->old_size-1);
+	}
+    }
+
+    return False;
+}
+
+/* Iterate over all entries: start with *pos = 0, returns 0 at end.
+ * The table must not be changed while iterating.
+ */
+void* CLG_(hash_next)(hash_table* h, UInt* pos)
+{
+    void* entry;
+
+    while(*pos < h->size) {
+	entry = h->slots[*pos].entry;
+	(*pos)++;
+	if (entry) return entry;
+    }
+
+    while(h->old_slots && (*pos - h->size < h->old_size)) {
+	entry = h->old_slots[*pos - h->size].entry;
+	(*pos)++;
+	if (entry && (entry != HASH_MOVED)) return entry;
+    }
+
+    return 0;
+}
+
+/* Remove all entries, keeping the current size */
+void CLG_(hash_clear)(hash_table* h)
+{
+    if (h->old_slots) {
+	VG_(free)(h->old_slots);
+	h->old_slots = 0;
+	h->old_size  = 0;
+	h->old_pos   = 0;
+    }
+
+    VG_(memset)(h->slots, 0, h->size * sizeof(hash_slot));
+    h->entries = 0;
+}
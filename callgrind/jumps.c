@@ -28,30 +28,48 @@
 
 #include "global.h"
 
-#define N_JCC_INITIAL_ENTRIES  4437
-
 /*------------------------------------------------------------*/
 /*--- Jump Cost Center (JCC) operations, including Calls   ---*/
 /*------------------------------------------------------------*/
 
-#define N_JCC_INITIAL_ENTRIES  4437
+#define N_JCC_INITIAL_ENTRIES  4096
 
 jcc_hash current_jccs;
 
-void CLG_(init_jcc_hash)(jcc_hash* jccs)
+/* First key of a JCC in the hash table.
+ * As <jmp> is below the number of JmpData entries allocated with
+ * BBCC <from>, this is unique for each (from, jmp) pair.
+ */
+__inline__
+static UWord jcc_key(BBCC* from, UInt jmp)
+{
+  return (UWord)from + jmp;
+}
+
+static Bool jcc_eq(void* entry, UWord from_jmp, UWord to, void* arg)
 {
-   Int i;
+   jCC* jcc = (jCC*) entry;
+   return (jcc_key(jcc->from, jcc->jmp) == from_jmp) &&
+          ((UWord)jcc->to == to);
+}
 
+void CLG_(init_jcc_hash)(jcc_hash* jccs)
+{
    CLG_ASSERT(jccs != 0);
 
-   jccs->size    = N_JCC_INITIAL_ENTRIES;
-   jccs->entries = 0;
-   jccs->table = (jCC**) CLG_MALLOC("cl.jumps.ijh.1",
-                                    jccs->size * sizeof(jCC*));
+   CLG_(init_hash)(&(jccs->table), "cl.jumps.ijh.1",
+		   N_JCC_INITIAL_ENTRIES, jcc_eq,
+		   &(CLG_(stat).jcc_hash_resizes));
+   jccs->arena = CLG_(new_arena)("cl.jumps.nj.1");
    jccs->spontaneous = 0;
+}
 
-   for (i = 0; i < jccs->size; i++)
-     jccs->table[i] = 0;
+/* Free all JCCs of current thread at once */
+void CLG_(release_current_jccs)()
+{
+   CLG_(hash_clear)(&(current_jccs.table));
+   CLG_(arena_release)(current_jccs.arena);
+   current_jccs.spontaneous = 0;
 }
 
 
@@ -59,102 +77,35 @@ void CLG_(copy_current_jcc_hash)(jcc_hash* dst)
 {
   CLG_ASSERT(dst != 0);
 
-  dst->size        = current_jccs.size;
-  dst->entries     = current_jccs.entries;
-  dst->table       = current_jccs.table;
-  dst->spontaneous = current_jccs.spontaneous;
+  *dst = current_jccs;
 }
 
 void CLG_(set_current_jcc_hash)(jcc_hash* h)
 {
   CLG_ASSERT(h != 0);
 
-  current_jccs.size        = h->size;
-  current_jccs.entries     = h->entries;
-  current_jccs.table       = h->table;
-  current_jccs.spontaneous = h->spontaneous;
-}
-
-__inline__
-static UInt jcc_hash_idx(BBCC* from, UInt jmp, BBCC* to, UInt size)
-{
-  return (UInt) ( (UWord)from + 7* (UWord)to + 13*jmp) % size;
-} 
-
-/* double size of jcc table  */
-static void resize_jcc_table(void)
-{
-    Int i, new_size, conflicts1 = 0, conflicts2 = 0;
-    jCC** new_table;
-    UInt new_idx;
-    jCC *curr_jcc, *next_jcc;
-
-    new_size  = 2* current_jccs.size +3;
-    new_table = (jCC**) CLG_MALLOC("cl.jumps.rjt.1",
-                                   new_size * sizeof(jCC*));
- 
-    if (!new_table) return;
- 
-    for (i = 0; i < new_size; i++)
-      new_table[i] = NULL;
- 
-    for (i = 0; i < current_jccs.size; i++) {
-	if (current_jccs.table[i] == NULL) continue;
- 
-	curr_jcc = current_jccs.table[i];
-	while (NULL != curr_jcc) {
-	    next_jcc = curr_jcc->next_hash;
-
-	    new_idx = jcc_hash_idx(curr_jcc->from, curr_jcc->jmp,
-				    curr_jcc->to, new_size);
-
-	    curr_jcc->next_hash = new_table[new_idx];
-	    new_table[new_idx] = curr_jcc;
-	    if (curr_jcc->next_hash) {
-		conflicts1++;
-		if (curr_jcc->next_hash->next_hash)
-		    conflicts2++;
-	    }
-
-	    curr_jcc = next_jcc;
-	}
-    }
-
-    VG_(free)(current_jccs.table);
-
-
-    CLG_DEBUG(0, "Resize JCC Hash: %d => %d (entries %d, conflicts %d/%d)\n",
-	     current_jccs.size, new_size,
-	     current_jccs.entries, conflicts1, conflicts2);
-
-    current_jccs.size  = new_size;
-    current_jccs.table = new_table;
-    CLG_(stat).jcc_hash_resizes++;
+  current_jccs = *h;
 }
 
-
-
 /* new jCC structure: a call was done to a BB of a BBCC 
  * for a spontaneous call, from is 0 (i.e. caller unknown)
  */
 static jCC* new_jcc(BBCC* from, UInt jmp, BBCC* to)
 {
    jCC* jcc;
-   UInt new_idx;
 
-   /* check fill degree of jcc hash table and resize if needed (>80%) */
-   current_jccs.entries++;
-   if (10 * current_jccs.entries / current_jccs.size > 8)
-       resize_jcc_table();
-
-   jcc = (jCC*) CLG_MALLOC("cl.jumps.nj.1", sizeof(jCC));
+   jcc = (jCC*) CLG_(arena_alloc)(current_jccs.arena, sizeof(jCC));
 
    jcc->from      = from;
    jcc->jmp       = jmp;
    jcc->to        = to;
    jcc->jmpkind   = jk_Call;
    jcc->call_counter = 0;
-   jcc->cost = 0;
+   /* allocated here instead of lazily, to keep it in the arena */
+   jcc->cost = (ULong*) CLG_(arena_alloc)(current_jccs.arena,
+					  CLG_(sets).full->size *
+					  sizeof(ULong));
+   CLG_(init_cost)( CLG_(sets).full, jcc->cost );
 
    /* insert into JCC chain of calling BBCC.
     * This list is only used at dumping time */
@@ -171,9 +122,8 @@ static jCC* new_jcc(BBCC* from, UInt jmp, BBCC* to)
    }
 
    /* insert into JCC hash table */
-   new_idx = jcc_hash_idx(from, jmp, to, current_jccs.size);
-   jcc->next_hash = current_jccs.table[new_idx];
-   current_jccs.table[new_idx] = jcc;
+   CLG_(hash_insert)(&(current_jccs.table),
+		     jcc_key(from, jmp), (UWord)to, jcc);
 
    CLG_(stat).distinct_jccs++;
 
@@ -190,7 +140,6 @@ static jCC* new_jcc(BBCC* from, UInt jmp, BBCC* to)
 jCC* CLG_(get_jcc)(BBCC* from, UInt jmp, BBCC* to)
 {
     jCC* jcc;
-    UInt idx;
 
     CLG_DEBUG(5, "+ get_jcc(bbcc %p/%d => bbcc %p)\n",
 		from, jmp, to);
@@ -212,15 +161,8 @@ jCC* CLG_(get_jcc)(BBCC* from, UInt jmp, BBCC* to)
 
     CLG_(stat).jcc_lru_misses++;
 
-    idx = jcc_hash_idx(from, jmp, to, current_jccs.size);
-    jcc = current_jccs.table[idx];
-
-    while(jcc) {
-	if ((jcc->from == from) &&
-	    (jcc->jmp == jmp) &&
-	    (jcc->to == to)) break;
-	jcc = jcc->next_hash;
-    }
+    jcc = (jCC*) CLG_(hash_lookup)(&(current_jccs.table),
+				   jcc_key(from, jmp), (UWord)to, 0);
 
     if (!jcc)
 	jcc = new_jcc(from, jmp, to);
@@ -0,0 +1,248 @@
+/*--------------------------------------------------------------------*/
+/*--- Callgrind                                                    ---*/
+/*---                                                       live.c ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Callgrind, a Valgrind tool for call tracing.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+#include "global.h"
+
+#include "pub_tool_threadstate.h"
+#include "pub_tool_aspacemgr.h"
+#include "pub_tool_clientstate.h"
+
+/*------------------------------------------------------------*/
+/*--- Live statistics page                                 ---*/
+/*------------------------------------------------------------*/
+
+/* With --live-stats=yes, counters are published in a file
+ * <tmpdir>/callgrind-live.<pid>, which is mapped shared into Valgrind.
+ * Observers (callgrind_control --watch) just read the file, without
+ * ever interrupting the supervised program.
+ *
+ * Layout of the page:
+ *  [0, LIVE_HEADER_SIZE)    text header, written once:
+ *                           "callgrind-live: 1", "pid:", "cmd:", "threads:",
+ *                           "offsets:" with the offsets of the parts below,
+ *                           "fields:" with names of the counter slots
+ *  LIVE_SLOTS_OFFSET        ULong counter slots, in order of "fields:"
+ *  LIVE_FN_OFFSET           name of the currently executed function
+ *  LIVE_THREADS_OFFSET      ULong Ir counter per thread ID
+ *
+ * The first slot is a sequence counter which is odd while the page is
+ * updated. A reader has to retry if it is odd or changed while reading.
+ */
+
+/* One page for the header: the command name is restricted to
+ * LIVE_HEADER_SIZE/2, and the field names need less than 1 kB */
+#define LIVE_HEADER_SIZE     4096
+#define LIVE_SLOTS_MAX       64
+#define LIVE_SLOTS_OFFSET    LIVE_HEADER_SIZE
+#define LIVE_FN_OFFSET       (LIVE_SLOTS_OFFSET + LIVE_SLOTS_MAX*sizeof(ULong))
+#define LIVE_FN_LEN          512
+#define LIVE_THREADS_OFFSET  (LIVE_FN_OFFSET + LIVE_FN_LEN)
+#define LIVE_SIZE            (LIVE_THREADS_OFFSET + VG_N_THREADS*sizeof(ULong))
+
+/* Basic blocks executed between updates */
+#define LIVE_UPDATE_BBS      4096
+
+static const HChar* live_fields[] = {
+   "seq", "total-ir", "instrumentation", "current-tid", "dump-counter",
+   "bb-executions", "call-counter", "jcnd-counter", "jump-counter",
+   "rec-call-counter", "ret-counter", "context-counter",
+   "bb-retranslations", "distinct-objs", "distinct-files",
+   "distinct-fns", "distinct-contexts", "distinct-bbs", "distinct-jccs",
+   "distinct-bbccs", "distinct-instrs", "distinct-skips",
+   "bb-hash-resizes", "bbcc-hash-resizes", "jcc-hash-resizes",
+   "cxt-hash-resizes", "fn-array-resizes", "call-stack-resizes",
+   "fn-stack-resizes", "arena-chunks", "cc-releases",
+   "full-debug-bbs", "file-line-debug-bbs", "fn-name-debug-bbs",
+   "no-debug-bbs", "bbcc-lru-misses", "jcc-lru-misses",
+   "cxt-lru-misses", "bbcc-clones",
+   0
+};
+
+/* First BB execution count for the next update; never if not active */
+ULong CLG_(live_next_update) = ~0ULL;
+
+static HChar* live_page = 0;
+static SizeT  live_size = 0;
+static Int    live_pid = 0;
+static HChar  live_file[256];
+
+static void live_header(void)
+{
+   HChar* h = live_page;
+   Int i, p;
+
+   p = VG_(sprintf)(h, "callgrind-live: 1\npid: %d\n", live_pid);
+   p += VG_(snprintf)(h+p, LIVE_HEADER_SIZE/2 - p, "cmd: %s",
+		      VG_(args_the_exename));
+   p += VG_(sprintf)(h+p, "\nthreads: %d\noffsets: %d %d %d\nfields:",
+		     VG_N_THREADS, (Int)LIVE_SLOTS_OFFSET,
+		     (Int)LIVE_FN_OFFSET, (Int)LIVE_THREADS_OFFSET);
+   for(i = 0; live_fields[i]; i++) {
+      CLG_ASSERT(p + VG_(strlen)(live_fields[i]) + 2 < LIVE_HEADER_SIZE);
+      p += VG_(sprintf)(h+p, " %s", live_fields[i]);
+   }
+   CLG_ASSERT(i <= LIVE_SLOTS_MAX);
+   h[p] = '\n';
+}
+
+/* Create page for this process. Called again in a forked child */
+void CLG_(init_live_stats)(void)
+{
+   SysRes res;
+   Int fd;
+   Bool ok;
+
+   if (!CLG_(clo).live_stats) return;
+
+   if (live_page) {
+      /* forked child: page of the parent stays with the parent */
+      VG_(am_munmap_valgrind)((Addr)live_page, live_size);
+      live_page = 0;
+   }
+   live_pid = VG_(getpid)();
+   live_size = VG_PGROUNDUP(LIVE_SIZE);
+   VG_(snprintf)(live_file, sizeof(live_file), "%s/callgrind-live.%d",
+		 VG_(tmpdir)(), live_pid);
+
+   /* The name is predictable: remove a page left over by a killed run
+    * with the same pid (unlink never follows a symlink), and only use
+    * a newly created file, never one planted by somebody else */
+   VG_(unlink)(live_file);
+   res = VG_(open)(live_file, VKI_O_CREAT|VKI_O_EXCL|VKI_O_RDWR,
+		   VKI_S_IRUSR|VKI_S_IWUSR);
+   if (sr_isError(res)) {
+      VG_(message)(Vg_UserMsg,
+		   "Warning: can not create live statistics file %s\n",
+		   live_file);
+      return;
+   }
+   fd = (Int) sr_Res(res);
+
+   /* extend file to page size: mapped pages beyond end of file fault */
+   ok = (VG_(lseek)(fd, live_size-1, VKI_SEEK_SET) == live_size-1) &&
+	(VG_(write)(fd, "", 1) == 1);
+   if (ok) {
+      res = VG_(am_shared_mmap_file_float_valgrind)
+	 (live_size, VKI_PROT_READ|VKI_PROT_WRITE, fd, (Off64T)0);
+      ok = !sr_isError(res);
+   }
+   VG_(close)(fd);
+
+   if (!ok) {
+      VG_(message)(Vg_UserMsg,
+		   "Warning: can not map live statistics file %s\n",
+		   live_file);
+      VG_(unlink)(live_file);
+      return;
+   }
+   live_page = (HChar*) sr_Res(res);
+
+   live_header();
+   CLG_(update_live_stats)();
+}
+
+void CLG_(update_live_stats)(void)
+{
+   volatile ULong* s = (volatile ULong*) (live_page + LIVE_SLOTS_OFFSET);
+   ULong* tir = (ULong*) (live_page + LIVE_THREADS_OFFSET);
+   HChar* fn = live_page + LIVE_FN_OFFSET;
+   Int i = 1, t;
+
+   CLG_(live_next_update) = CLG_(stat).bb_executions + LIVE_UPDATE_BBS;
+   if (!live_page) {
+      if (!CLG_(clo).live_stats) CLG_(live_next_update) = ~0ULL;
+      return;
+   }
+
+   /* odd sequence number: update in progress. Readers run on other
+    * CPUs, so the stores need real barriers, not only compiler ones */
+   s[0]++;
+   __sync_synchronize();
+
+   s[i++] = CLG_(get_total_ir)();
+   s[i++] = CLG_(instrument_state) ? 1 : 0;
+   s[i++] = CLG_(current_tid);
+   s[i++] = CLG_(get_dump_counter)();
+   s[i++] = CLG_(stat).bb_executions;
+   s[i++] = CLG_(stat).call_counter;
+   s[i++] = CLG_(stat).jcnd_counter;
+   s[i++] = CLG_(stat).jump_counter;
+   s[i++] = CLG_(stat).rec_call_counter;
+   s[i++] = CLG_(stat).ret_counter;
+   s[i++] = CLG_(stat).context_counter;
+   s[i++] = CLG_(stat).bb_retranslations;
+   s[i++] = CLG_(stat).distinct_objs;
+   s[i++] = CLG_(stat).distinct_files;
+   s[i++] = CLG_(stat).distinct_fns;
+   s[i++] = CLG_(stat).distinct_contexts;
+   s[i++] = CLG_(stat).distinct_bbs;
+   s[i++] = CLG_(stat).distinct_jccs;
+   s[i++] = CLG_(stat).distinct_bbccs;
+   s[i++] = CLG_(stat).distinct_instrs;
+   s[i++] = CLG_(stat).distinct_skips;
+   s[i++] = CLG_(stat).bb_hash_resizes;
+   s[i++] = CLG_(stat).bbcc_hash_resizes;
+   s[i++] = CLG_(stat).jcc_hash_resizes;
+   s[i++] = CLG_(stat).cxt_hash_resizes;
+   s[i++] = CLG_(stat).fn_array_resizes;
+   s[i++] = CLG_(stat).call_stack_resizes;
+   s[i++] = CLG_(stat).fn_stack_resizes;
+   s[i++] = CLG_(stat).arena_chunks;
+   s[i++] = CLG_(stat).cc_releases;
+   s[i++] = CLG_(stat).full_debug_BBs;
+   s[i++] = CLG_(stat).file_line_debug_BBs;
+   s[i++] = CLG_(stat).fn_name_debug_BBs;
+   s[i++] = CLG_(stat).no_debug_BBs;
+   s[i++] = CLG_(stat).bbcc_lru_misses;
+   s[i++] = CLG_(stat).jcc_lru_misses;
+   s[i++] = CLG_(stat).cxt_lru_misses;
+   s[i++] = CLG_(stat).bbcc_clones;
+   CLG_ASSERT(live_fields[i] == 0);
+
+   for(t = 1; t < VG_N_THREADS; t++)
+      tir[t] = CLG_(get_thread_ir)(t);
+
+   if (CLG_(current_state).cxt)
+      VG_(strncpy)(fn, CLG_(current_state).cxt->fn[0]->name, LIVE_FN_LEN-1);
+   else
+      fn[0] = 0;
+   fn[LIVE_FN_LEN-1] = 0;
+
+   __sync_synchronize();
+   s[0]++;
+}
+
+/* Remove the file at process exit */
+void CLG_(finish_live_stats)(void)
+{
+   if (!live_page || (live_pid != VG_(getpid)())) return;
+
+   CLG_(update_live_stats)();
+   VG_(am_munmap_valgrind)((Addr)live_page, live_size);
+   VG_(unlink)(live_file);
+   live_page = 0;
+   CLG_(live_next_update) = ~0ULL;
+}
@@ -37,6 +37,7 @@
 
 #include "pub_tool_threadstate.h"
 #include "pub_tool_gdbserver.h"
+#include "pub_tool_aspacemgr.h"
 
 #include "cg_branchpred.c"
 
@@ -48,6 +49,11 @@
 CommandLineOptions CLG_(clo);
 Statistics CLG_(stat);
 Bool CLG_(instrument_state) = True; /* Instrumentation on ? */
+Long CLG_(instr_budget) = 0;
+
+/* With --fast-instr-toggle: were translations instrumented (guarded)
+ * already? Before, code is translated without instrumentation. */
+static Bool guarded_translations = False;
 
 /* thread and signal handler specific */
 exec_state CLG_(current_state);
@@ -89,6 +95,8 @@ static void CLG_(init_statistics)(Statistics* s)
   s->fn_array_resizes    = 0;
   s->call_stack_resizes  = 0;
   s->fn_stack_resizes    = 0;
+  s->arena_chunks        = 0;
+  s->cc_releases         = 0;
 
   s->full_debug_BBs      = 0;
   s->file_line_debug_BBs = 0;
@@ -98,6 +106,11 @@ static void CLG_(init_statistics)(Statistics* s)
   s->jcc_lru_misses      = 0;
   s->cxt_lru_misses      = 0;
   s->bbcc_clones         = 0;
+
+  s->context_memory      = 0;
+  s->clone_memory        = 0;
+  s->folded_contexts     = 0;
+  s->folded_recursions   = 0;
 }
 
 
@@ -323,9 +336,94 @@ typedef struct {
 
     /* The output SB being constructed. */
     IRSB* sbOut;
+
+    /* With --fast-instr-toggle, a :: Ity_I1 atom which is true if
+     * instrumentation is switched on. Guards all helper calls. */
+    IRAtom* instr_guard;
+
+    /* With --sample-period, :: Ity_I1 atoms which are true in the
+     * detail and warm-up phases. Guard cache simulation helper calls. */
+    IRAtom* detail_guard;
+    IRAtom* warm_guard;
 } ClgState;
 
 
+/* Combine guard <g> of a dirty helper call with guard <g2> */
+static IRExpr* andGuard ( ClgState* clgs, IRExpr* g, IRAtom* g2 )
+{
+   IRTemp g1, g3, g4, gn;
+
+   if (g->tag == Iex_Const) {
+      tl_assert(g->Iex.Const.con->Ico.U1 == True);
+      return g2;
+   }
+
+   g1 = newIRTemp(clgs->sbOut->tyenv, Ity_I32);
+   g3 = newIRTemp(clgs->sbOut->tyenv, Ity_I32);
+   g4 = newIRTemp(clgs->sbOut->tyenv, Ity_I32);
+   gn = newIRTemp(clgs->sbOut->tyenv, Ity_I1);
+   addStmtToIRSB( clgs->sbOut,
+      IRStmt_WrTmp( g1, IRExpr_Unop( Iop_1Uto32, g )));
+   addStmtToIRSB( clgs->sbOut,
+      IRStmt_WrTmp( g3, IRExpr_Unop( Iop_1Uto32, g2 )));
+   addStmtToIRSB( clgs->sbOut,
+      IRStmt_WrTmp( g4, IRExpr_Binop( Iop_And32, IRExpr_RdTmp(g1),
+                                      IRExpr_RdTmp(g3) )));
+   addStmtToIRSB( clgs->sbOut,
+      IRStmt_WrTmp( gn, IRExpr_Binop( Iop_CmpNE32, IRExpr_RdTmp(g4),
+                                      IRExpr_Const(IRConst_U32(0)) )));
+   return IRExpr_RdTmp(gn);
+}
+
+/* Add a dirty helper call, guarded by the instrumentation state if
+ * translations are kept across instrumentation toggles. */
+static void addInstrumentedDirty ( ClgState* clgs, IRDirty* di )
+{
+   if (clgs->instr_guard)
+      di->guard = andGuard( clgs, di->guard, clgs->instr_guard );
+   addStmtToIRSB( clgs->sbOut, IRStmt_Dirty(di) );
+}
+
+/* Add a call to a cache simulation helper. With sampled simulation,
+ * it is guarded by the detail phase, and for the warm-up phase, calls
+ * to warm_* helpers for the accesses of events <ev> to <ev>+<n>-1 are
+ * added, which only update the simulator state. */
+static void addSimDirty ( ClgState* clgs, IRDirty* di, Event* ev, Int n )
+{
+   Int i;
+
+   if (clgs->detail_guard) {
+      IRExpr* guard = di->guard;
+
+      di->guard = andGuard( clgs, guard, clgs->detail_guard );
+
+      for(i = 0; i < n; i++, ev++) {
+         IRDirty* wdi;
+         IRExpr*  inode = mkIRExpr_HWord( (HWord)ev->inode );
+
+         if (ev->tag == Ev_Ir)
+            wdi = unsafeIRDirty_0_N( 1, "warm_1I",
+                     VG_(fnptr_to_fnentry)( CLG_(cachesim).warm_1I ),
+                     mkIRExprVec_1( inode ) );
+         else if (ev->tag == Ev_Dr)
+            wdi = unsafeIRDirty_0_N( 3, "warm_0I1Dr",
+                     VG_(fnptr_to_fnentry)( CLG_(cachesim).warm_0I1Dr ),
+                     mkIRExprVec_3( inode, get_Event_dea(ev),
+                                    mkIRExpr_HWord( get_Event_dszB(ev) ) ));
+         else
+            wdi = unsafeIRDirty_0_N( 3, "warm_0I1Dw",
+                     VG_(fnptr_to_fnentry)( CLG_(cachesim).warm_0I1Dw ),
+                     mkIRExprVec_3( inode, get_Event_dea(ev),
+                                    mkIRExpr_HWord( get_Event_dszB(ev) ) ));
+         wdi->guard = andGuard( clgs, guard, clgs->warm_guard );
+         addInstrumentedDirty( clgs, wdi );
+      }
+   }
+   addInstrumentedDirty( clgs, di );
+}
+
+
+
 static void showEvent ( Event* ev )
 {
    switch (ev->tag) {
@@ -590,7 +688,10 @@ static void flushEvents ( ClgState* clgs )
       di = unsafeIRDirty_0_N( regparms,
 			      helperName, VG_(fnptr_to_fnentry)( helperAddr ),
 			      argv );
-      addStmtToIRSB( clgs->sbOut, IRStmt_Dirty(di) );
+      if (ev->tag == Ev_Bc || ev->tag == Ev_Bi || ev->tag == Ev_G)
+	 addInstrumentedDirty( clgs, di );
+      else
+	 addSimDirty( clgs, di, ev, inew - i );
    }
 
    clgs->events_used = 0;
@@ -696,6 +797,7 @@ void addEvent_D_guarded ( ClgState* clgs, InstrInfo* inode,
    IRExpr**     argv;
    Int          regparms;
    IRDirty*     di;
+   Event        ev;
    i_node_expr = mkIRExpr_HWord( (HWord)inode );
    helperName  = isWrite ? CLG_(cachesim).log_0I1Dw_name
                          : CLG_(cachesim).log_0I1Dr_name;
@@ -709,7 +811,21 @@ void addEvent_D_guarded ( ClgState* clgs, InstrInfo* inode,
                     helperName, VG_(fnptr_to_fnentry)( helperAddr ), 
                     argv );
    di->guard = guard;
-   addStmtToIRSB( clgs->sbOut, IRStmt_Dirty(di) );
+
+   /* event for warm-up helper with sampled simulation */
+   init_Event(&ev);
+   ev.inode = inode;
+   if (isWrite) {
+      ev.tag       = Ev_Dw;
+      ev.Ev.Dw.ea  = ea;
+      ev.Ev.Dw.szB = datasize;
+   }
+   else {
+      ev.tag       = Ev_Dr;
+      ev.Ev.Dr.ea  = ea;
+      ev.Ev.Dr.szB = datasize;
+   }
+   addSimDirty( clgs, di, &ev, 1 );
 }
 
 static
@@ -768,6 +884,152 @@ void addEvent_G ( ClgState* clgs, InstrInfo* inode )
    clgs->events_used++;
 }
 
+/*------------------------------------------------------------*/
+/*--- Instruction mix (--collect-mix)                      ---*/
+/*------------------------------------------------------------*/
+
+/* Every guest instruction is put into exactly one class of the EG_MIX
+ * event group, decided from its VEX IR at instrumentation time. If the
+ * IR matches multiple classes, the one with highest priority is used:
+ * e.g. a load-and-add instruction is a load, and a vector load is SIMD.
+ * Instructions not in any other class (including moves) are "Alu".
+ * Thus, the sum of all classes is the Ir count.
+ */
+static const UChar mix_prio[MIX_EVENTS] = {
+   [MIX_ALU] = 0, [MIX_LD] = 1, [MIX_ST] = 2, [MIX_BR] = 3,
+   [MIX_FP] = 4, [MIX_SIMD] = 5, [MIX_DIV] = 6, [MIX_ATOM] = 7
+};
+
+static
+void addMix ( ClgState* clgs, InstrInfo* inode, UChar cl )
+{
+   if ((!CLG_(clo).collect_mix && !CLG_(clo).cost_model) ||
+       clgs->seen_before) return;
+
+   if (mix_prio[cl] > mix_prio[inode->mix])
+      inode->mix = cl;
+}
+
+static
+UChar mixOfType ( IRType ty )
+{
+   switch (ty) {
+      case Ity_F32: case Ity_F64: case Ity_F128:
+      case Ity_D32: case Ity_D64: case Ity_D128:
+         return MIX_FP;
+      case Ity_V128: case Ity_V256:
+         return MIX_SIMD;
+      default:
+         return MIX_ALU;
+   }
+}
+
+static
+Bool isDivOp ( IROp op )
+{
+   switch (op) {
+      case Iop_DivU32: case Iop_DivS32: case Iop_DivU64: case Iop_DivS64:
+      case Iop_DivU32E: case Iop_DivS32E: case Iop_DivU64E: case Iop_DivS64E:
+      case Iop_DivModU64to32: case Iop_DivModS64to32:
+      case Iop_DivModU128to64: case Iop_DivModS128to64:
+      case Iop_DivModS64to64:
+      case Iop_DivF32: case Iop_DivF64: case Iop_DivF64r32: case Iop_DivF128:
+      case Iop_SqrtF32: case Iop_SqrtF64: case Iop_SqrtF128:
+      case Iop_DivD64: case Iop_DivD128:
+      case Iop_Div32Fx4: case Iop_Div64Fx2: case Iop_Div32F0x4:
+      case Iop_Div64F0x2: case Iop_Div32Fx8: case Iop_Div64Fx4:
+      case Iop_Sqrt32Fx4: case Iop_Sqrt64Fx2: case Iop_Sqrt32F0x4:
+      case Iop_Sqrt64F0x2: case Iop_Sqrt32Fx8: case Iop_Sqrt64Fx4:
+         return True;
+      default:
+         return False;
+   }
+}
+
+/* Class of an instruction writing expression <e> of type <ty> to a temp.
+ * Operations are classified by their result and argument types. */
+static
+void addMix_Expr ( ClgState* clgs, InstrInfo* inode, IRType ty, IRExpr* e )
+{
+   IRTypeEnv* tyenv = clgs->sbOut->tyenv;
+   IROp op;
+
+   addMix( clgs, inode, mixOfType(ty) );
+
+   switch (e->tag) {
+      case Iex_Load:
+         addMix( clgs, inode, MIX_LD );
+         return;
+      case Iex_Unop:
+         op = e->Iex.Unop.op;
+         addMix( clgs, inode, mixOfType(typeOfIRExpr(tyenv, e->Iex.Unop.arg)) );
+         break;
+      case Iex_Binop:
+         op = e->Iex.Binop.op;
+         addMix( clgs, inode, mixOfType(typeOfIRExpr(tyenv, e->Iex.Binop.arg1)) );
+         addMix( clgs, inode, mixOfType(typeOfIRExpr(tyenv, e->Iex.Binop.arg2)) );
+         break;
+      case Iex_Triop:
+         /* first argument is the rounding mode */
+         op = e->Iex.Triop.details->op;
+         addMix( clgs, inode,
+                 mixOfType(typeOfIRExpr(tyenv, e->Iex.Triop.details->arg2)) );
+         break;
+      case Iex_Qop:
+         op = e->Iex.Qop.details->op;
+         addMix( clgs, inode,
+                 mixOfType(typeOfIRExpr(tyenv, e->Iex.Qop.details->arg2)) );
+         break;
+      default:
+         return;
+   }
+   if (isDivOp(op))
+      addMix( clgs, inode, MIX_DIV );
+
+   /* the largest weight of operations overrides the class weight */
+   if (CLG_(clo).cost_model && !clgs->seen_before) {
+      UShort w = CLG_(op_weight)(op);
+      if (w > inode->weight) inode->weight = w;
+   }
+}
+
+/* Fill per side exit tallies of instruction classes at end of
+ * instrumentation of a new BB. As the jump kinds of the last two exits
+ * may be swapped because of VEX branch inversion, instruction indexes
+ * of exits are not ascending, and each exit is counted separately. */
+static
+void setMixTallies ( BB* bb )
+{
+   UInt j, i;
+   UShort* tally;
+
+   for (j = 0; j <= bb->cjmp_count; j++) {
+      tally = bb->mix + j * MIX_EVENTS;
+      for (i = 0; i < MIX_EVENTS; i++)
+         tally[i] = 0;
+      for (i = 0; i <= bb->jmp[j].instr; i++)
+         tally[ bb->instr[i].mix ]++;
+   }
+}
+
+/* Fill per side exit estimated cycles with --cost-model. Instructions
+ * without an operation weight get the weight of their class. */
+static
+void setCycleTallies ( BB* bb )
+{
+   UInt j, i;
+
+   for (i = 0; i < bb->instr_count; i++)
+      if (bb->instr[i].weight == 0)
+         bb->instr[i].weight = CLG_(class_weight)( bb->instr[i].mix );
+
+   for (j = 0; j <= bb->cjmp_count; j++) {
+      bb->cycles[j] = 0;
+      for (i = 0; i <= bb->jmp[j].instr; i++)
+         bb->cycles[j] += bb->instr[i].weight;
+   }
+}
+
 /* Initialise or check (if already seen before) an InstrInfo for next insn.
    We only can set instr_offset/instr_size here. The required event set and
    resulting cost offset depend on events (Ir/Dr/Dw/Dm) in guest
@@ -791,6 +1053,8 @@ InstrInfo* next_InstrInfo ( ClgState* clgs, UInt instr_size )
        ii->instr_size = instr_size;
        ii->cost_offset = 0;
        ii->eventset = 0;
+       ii->mix = MIX_ALU;
+       ii->weight = 0;
    }
 
    clgs->ii_index++;
@@ -912,6 +1176,43 @@ void addConstMemStoreStmt( IRSB* bbOut, UWord addr, UInt val, IRType hWordTy)
 				IRExpr_Const(IRConst_U32(val)) ));
 }   
 
+/* Guard which is true if CLG_(instrument_state) is set at execution time */
+static IRAtom* mkInstrGuard ( IRSB* sbOut )
+{
+   IRTemp state = newIRTemp(sbOut->tyenv, Ity_I8);
+   IRTemp guard = newIRTemp(sbOut->tyenv, Ity_I1);
+
+   tl_assert(sizeof(CLG_(instrument_state)) == 1);
+   addStmtToIRSB( sbOut,
+      IRStmt_WrTmp( state,
+         IRExpr_Load( CLGEndness, Ity_I8,
+            mkIRExpr_HWord( (HWord) &CLG_(instrument_state) ))));
+   addStmtToIRSB( sbOut,
+      IRStmt_WrTmp( guard,
+         IRExpr_Binop( Iop_CmpNE8, IRExpr_RdTmp(state),
+                       IRExpr_Const(IRConst_U8(0)) )));
+   return IRExpr_RdTmp(guard);
+}
+
+
+/* Guard which is true if sampled simulation is in <phase> at execution time */
+static IRAtom* mkPhaseGuard ( IRSB* sbOut, UChar phase )
+{
+   IRTemp state = newIRTemp(sbOut->tyenv, Ity_I8);
+   IRTemp guard = newIRTemp(sbOut->tyenv, Ity_I1);
+
+   tl_assert(sizeof(CLG_(sample_phase)) == 1);
+   addStmtToIRSB( sbOut,
+      IRStmt_WrTmp( state,
+         IRExpr_Load( CLGEndness, Ity_I8,
+            mkIRExpr_HWord( (HWord) &CLG_(sample_phase) ))));
+   addStmtToIRSB( sbOut,
+      IRStmt_WrTmp( guard,
+         IRExpr_Binop( Iop_CmpEQ8, IRExpr_RdTmp(state),
+                       IRExpr_Const(IRConst_U8(phase)) )));
+   return IRExpr_RdTmp(guard);
+}
+
 
 /* add helper call to setup_bbcc, with pointer to BB struct as argument
  *
@@ -944,7 +1245,142 @@ void addBBSetupCall(ClgState* clgs)
    di = unsafeIRDirty_0_N( 1, "setup_bbcc",
 			      VG_(fnptr_to_fnentry)( & CLG_(setup_bbcc) ),
 			      argv);
-   addStmtToIRSB( clgs->sbOut, IRStmt_Dirty(di) );
+   addInstrumentedDirty( clgs, di );
+}
+
+
+/* Instrumentation with --count-only=yes
+ *
+ * No call to setup_bbcc and no event helpers are added. Instead, in the
+ * same way as jmps_passed is updated, before each exit of the SB the
+ * number of guest instructions executed up to this exit is stored into
+ * CLG_(current_state).ir_passed, and inline code at the start of the
+ * next SB adds this number to the Ir cost of the current execution state.
+ * This is exactly the accounting done in setup_bbcc, so the Ir totals
+ * are the same as with full instrumentation.
+ * With --fast-instr-toggle, the update of the Ir cost is guarded by the
+ * instrumentation state.
+ */
+static
+IRSB* instrument_count_only(IRSB* sbIn, IRType hWordTy)
+{
+   Int      i;
+   IRStmt*  st;
+   IRSB*    sbOut;
+   UInt     instr_count = 0;
+   IRTemp   costp, irp, irold, passed, passedW, irnew;
+   IROp     opAdd = (hWordTy == Ity_I32) ? Iop_Add32 : Iop_Add64;
+
+   sbOut = deepCopyIRSBExceptStmts(sbIn);
+
+   // Copy verbatim any IR preamble preceding the first IMark
+   i = 0;
+   while (i < sbIn->stmts_used && sbIn->stmts[i]->tag != Ist_IMark) {
+      addStmtToIRSB( sbOut, sbIn->stmts[i] );
+      i++;
+   }
+
+   /* CLG_(current_state).cost[ fullOffset(EG_IR) ] +=
+    *    CLG_(current_state).ir_passed */
+   costp   = newIRTemp(sbOut->tyenv, hWordTy);
+   irp     = newIRTemp(sbOut->tyenv, hWordTy);
+   irold   = newIRTemp(sbOut->tyenv, Ity_I64);
+   passed  = newIRTemp(sbOut->tyenv, Ity_I32);
+   passedW = newIRTemp(sbOut->tyenv, Ity_I64);
+   irnew   = newIRTemp(sbOut->tyenv, Ity_I64);
+   addStmtToIRSB( sbOut,
+      IRStmt_WrTmp( costp,
+         IRExpr_Load( CLGEndness, hWordTy,
+            mkIRExpr_HWord( (HWord) &CLG_(current_state).cost ))));
+   addStmtToIRSB( sbOut,
+      IRStmt_WrTmp( irp,
+         IRExpr_Binop( opAdd, IRExpr_RdTmp(costp),
+            mkIRExpr_HWord( fullOffset(EG_IR) * sizeof(ULong) ))));
+   addStmtToIRSB( sbOut,
+      IRStmt_WrTmp( irold,
+         IRExpr_Load( CLGEndness, Ity_I64, IRExpr_RdTmp(irp) )));
+   addStmtToIRSB( sbOut,
+      IRStmt_WrTmp( passed,
+         IRExpr_Load( CLGEndness, Ity_I32,
+            mkIRExpr_HWord( (HWord) &CLG_(current_state).ir_passed ))));
+   addStmtToIRSB( sbOut,
+      IRStmt_WrTmp( passedW,
+         IRExpr_Unop( Iop_32Uto64, IRExpr_RdTmp(passed) )));
+   addStmtToIRSB( sbOut,
+      IRStmt_WrTmp( irnew,
+         IRExpr_Binop( Iop_Add64, IRExpr_RdTmp(irold),
+                       IRExpr_RdTmp(passedW) )));
+   if (CLG_(clo).fast_instr_toggle) {
+      /* keep the old value if instrumentation is switched off */
+      IRTemp irsel = newIRTemp(sbOut->tyenv, Ity_I64);
+      addStmtToIRSB( sbOut,
+         IRStmt_WrTmp( irsel,
+            IRExpr_ITE( mkInstrGuard(sbOut),
+                        IRExpr_RdTmp(irnew), IRExpr_RdTmp(irold) )));
+      irnew = irsel;
+   }
+   addStmtToIRSB( sbOut,
+      IRStmt_Store( CLGEndness, IRExpr_RdTmp(irp), IRExpr_RdTmp(irnew) ));
+
+   if (CLG_(clo).max_instructions > 0) {
+      /* CLG_(instr_budget) -= irnew - irold;
+       * if (CLG_(instr_budget) <= 0) CLG_(max_instructions_reached)() */
+      IRTemp   added     = newIRTemp(sbOut->tyenv, Ity_I64);
+      IRTemp   bold      = newIRTemp(sbOut->tyenv, Ity_I64);
+      IRTemp   bnew      = newIRTemp(sbOut->tyenv, Ity_I64);
+      IRTemp   exhausted = newIRTemp(sbOut->tyenv, Ity_I1);
+      IRDirty* di;
+
+      addStmtToIRSB( sbOut,
+         IRStmt_WrTmp( added,
+            IRExpr_Binop( Iop_Sub64, IRExpr_RdTmp(irnew),
+                          IRExpr_RdTmp(irold) )));
+      addStmtToIRSB( sbOut,
+         IRStmt_WrTmp( bold,
+            IRExpr_Load( CLGEndness, Ity_I64,
+               mkIRExpr_HWord( (HWord) &CLG_(instr_budget) ))));
+      addStmtToIRSB( sbOut,
+         IRStmt_WrTmp( bnew,
+            IRExpr_Binop( Iop_Sub64, IRExpr_RdTmp(bold),
+                          IRExpr_RdTmp(added) )));
+      addStmtToIRSB( sbOut,
+         IRStmt_Store( CLGEndness,
+                       mkIRExpr_HWord( (HWord) &CLG_(instr_budget) ),
+                       IRExpr_RdTmp(bnew) ));
+      addStmtToIRSB( sbOut,
+         IRStmt_WrTmp( exhausted,
+            IRExpr_Binop( Iop_CmpLE64S, IRExpr_RdTmp(bnew),
+                          IRExpr_Const(IRConst_U64(0)) )));
+      di = unsafeIRDirty_0_N( 0, "max_instructions_reached",
+                              VG_(fnptr_to_fnentry)(
+                                 CLG_(max_instructions_reached) ),
+                              mkIRExprVec_0() );
+      di->guard = IRExpr_RdTmp(exhausted);
+      addStmtToIRSB( sbOut, IRStmt_Dirty(di) );
+   }
+
+   for (/*use current i*/; i < sbIn->stmts_used; i++) {
+      st = sbIn->stmts[i];
+      CLG_ASSERT(isFlatIRStmt(st));
+
+      if (st->tag == Ist_IMark)
+         instr_count++;
+      else if (st->tag == Ist_Exit) {
+         CLG_ASSERT(instr_count > 0);
+         addConstMemStoreStmt( sbOut,
+                               (UWord) &CLG_(current_state).ir_passed,
+                               instr_count, hWordTy);
+      }
+      addStmtToIRSB( sbOut, st );
+   }
+
+   addConstMemStoreStmt( sbOut,
+                         (UWord) &CLG_(current_state).ir_passed,
+                         instr_count, hWordTy);
+
+   CLG_DEBUG(3, "- instrument(count only): %u instrs\n", instr_count);
+
+   return sbOut;
 }
 
 
@@ -969,12 +1405,20 @@ IRSB* CLG_(instrument)( VgCallbackClosure* closure,
       VG_(tool_panic)("host/guest word size mismatch");
    }
 
-   // No instrumentation if it is switched off
-   if (! CLG_(instrument_state)) {
+   // No instrumentation if it is switched off, unless translations are
+   // kept across instrumentation toggles (then calls are guarded).
+   // Code running before instrumentation is switched on the first time
+   // (e.g. startup of an interpreter) is never instrumented.
+   if (! CLG_(instrument_state) &&
+       ! (CLG_(clo).fast_instr_toggle && guarded_translations)) {
        CLG_DEBUG(5, "instrument(BB %#lx) [Instrumentation OFF]\n",
 		 (Addr)closure->readdr);
        return sbIn;
    }
+   guarded_translations = True;
+
+   if (CLG_(clo).count_only)
+       return instrument_count_only(sbIn, hWordTy);
 
    CLG_DEBUG(3, "+ instrument(BB %#lx)\n", (Addr)closure->readdr);
 
@@ -998,6 +1442,9 @@ IRSB* CLG_(instrument)( VgCallbackClosure* closure,
    CLG_ASSERT(origAddr == st->Ist.IMark.addr 
                           + st->Ist.IMark.delta);  // XXX: check no overflow
 
+   clgs.instr_guard = CLG_(clo).fast_instr_toggle ?
+                         mkInstrGuard(clgs.sbOut) : NULL;
+
    /* Get BB struct (creating if necessary).
     * JS: The hash table is keyed with orig_addr_noredir -- important!
     * JW: Why? If it is because of different chasing of the redirection,
@@ -1007,6 +1454,14 @@ IRSB* CLG_(instrument)( VgCallbackClosure* closure,
 
    addBBSetupCall(&clgs);
 
+   /* The sampling phase is switched in setup_bbcc, so load it afterwards */
+   clgs.detail_guard = NULL;
+   clgs.warm_guard   = NULL;
+   if (CLG_(sampling)) {
+      clgs.detail_guard = mkPhaseGuard(clgs.sbOut, SAMPLE_DETAIL);
+      clgs.warm_guard   = mkPhaseGuard(clgs.sbOut, SAMPLE_WARMUP);
+   }
+
    // Set up running state
    clgs.events_used = 0;
    clgs.ii_index = 0;
@@ -1055,6 +1510,8 @@ IRSB* CLG_(instrument)( VgCallbackClosure* closure,
 	       addEvent_Dr( &clgs, curr_inode,
 			    sizeofIRType(data->Iex.Load.ty), aexpr );
 	    }
+	    addMix_Expr( &clgs, curr_inode,
+			 typeOfIRTemp(tyenv, st->Ist.WrTmp.tmp), data );
 	    break;
 	 }
 
@@ -1063,6 +1520,9 @@ IRSB* CLG_(instrument)( VgCallbackClosure* closure,
 	    IRExpr* aexpr = st->Ist.Store.addr;
 	    addEvent_Dw( &clgs, curr_inode,
 			 sizeofIRType(typeOfIRExpr(sbIn->tyenv, data)), aexpr );
+	    addMix( &clgs, curr_inode, MIX_ST );
+	    addMix( &clgs, curr_inode,
+		    mixOfType(typeOfIRExpr(sbIn->tyenv, data)) );
 	    break;
 	 }
 
@@ -1075,6 +1535,8 @@ IRSB* CLG_(instrument)( VgCallbackClosure* closure,
             addEvent_D_guarded( &clgs, curr_inode,
                                 sizeofIRType(type), addr, sg->guard,
                                 True/*isWrite*/ );
+            addMix( &clgs, curr_inode, MIX_ST );
+            addMix( &clgs, curr_inode, mixOfType(type) );
             break;
          }
 
@@ -1088,6 +1550,8 @@ IRSB* CLG_(instrument)( VgCallbackClosure* closure,
             addEvent_D_guarded( &clgs, curr_inode,
                                 sizeofIRType(type), addr, lg->guard,
                                 False/*!isWrite*/ );
+            addMix( &clgs, curr_inode, MIX_LD );
+            addMix( &clgs, curr_inode, mixOfType(type) );
             break;
          }
 
@@ -1105,10 +1569,14 @@ IRSB* CLG_(instrument)( VgCallbackClosure* closure,
 	       // than two cache lines in the simulation.
 	       if (CLG_(clo).simulate_cache && dataSize > CLG_(min_line_size))
 		  dataSize = CLG_(min_line_size);
-	       if (d->mFx == Ifx_Read || d->mFx == Ifx_Modify)
+	       if (d->mFx == Ifx_Read || d->mFx == Ifx_Modify) {
 		  addEvent_Dr( &clgs, curr_inode, dataSize, d->mAddr );
-	       if (d->mFx == Ifx_Write || d->mFx == Ifx_Modify)
+		  addMix( &clgs, curr_inode, MIX_LD );
+	       }
+	       if (d->mFx == Ifx_Write || d->mFx == Ifx_Modify) {
 		  addEvent_Dw( &clgs, curr_inode, dataSize, d->mAddr );
+		  addMix( &clgs, curr_inode, MIX_ST );
+	       }
 	    } else {
 	       tl_assert(d->mAddr == NULL);
 	       tl_assert(d->mSize == 0);
@@ -1132,11 +1600,13 @@ IRSB* CLG_(instrument)( VgCallbackClosure* closure,
             addEvent_Dr( &clgs, curr_inode, dataSize, cas->addr );
             addEvent_Dw( &clgs, curr_inode, dataSize, cas->addr );
             addEvent_G(  &clgs, curr_inode );
+            addMix( &clgs, curr_inode, MIX_ATOM );
             break;
          }
 
          case Ist_LLSC: {
             IRType dataTy;
+            addMix( &clgs, curr_inode, MIX_ATOM );
             if (st->Ist.LLSC.storedata == NULL) {
                /* LL */
                dataTy = typeOfIRTemp(sbIn->tyenv, st->Ist.LLSC.result);
@@ -1216,6 +1686,7 @@ IRSB* CLG_(instrument)( VgCallbackClosure* closure,
                                     ));
                 /* And post the event. */
                 addEvent_Bc( &clgs, curr_inode, IRExpr_RdTmp(guard) );
+                addMix( &clgs, curr_inode, MIX_BR );
             }
 
 	    /* We may never reach the next statement, so need to flush
@@ -1319,6 +1790,12 @@ IRSB* CLG_(instrument)( VgCallbackClosure* closure,
      /* Instruction index of the call/ret at BB end
       * (it is wrong for fall-through, but does not matter) */
      clgs.bb->jmp[cJumps].instr = clgs.ii_index-1;
+
+     /* not for system calls and other special exits */
+     if ((jk != jk_None) &&
+	 ((sbIn->jumpkind == Ijk_Boring) || (sbIn->jumpkind == Ijk_Call) ||
+	  (sbIn->jumpkind == Ijk_Ret)))
+       addMix( &clgs, curr_inode, MIX_BR );
    }
 
    /* swap information of last exit with final exit if inverted */
@@ -1341,6 +1818,13 @@ IRSB* CLG_(instrument)( VgCallbackClosure* closure,
    else {
        clgs.bb->cost_count = update_cost_offsets(&clgs);
        clgs.bb->instr_len = clgs.instr_offset;
+       if (CLG_(clo).collect_mix)
+	   setMixTallies(clgs.bb);
+       if (CLG_(clo).cost_model)
+	   setCycleTallies(clgs.bb);
+       /* without line numbers, files are looked up when dumping */
+       if (CLG_(clo).dump_line)
+	   CLG_(init_bb_pos)(clgs.bb);
    }
 
    CLG_DEBUG(3, "- instrument(BB %#lx): byteLen %u, CJumps %u, CostLen %u\n",
@@ -1402,7 +1886,8 @@ static void zero_thread_cost(thread_info* t)
     CLG_(current_call_stack).entry[i].jcc->call_counter = 0;
   }
 
-  CLG_(forall_bbccs)(CLG_(zero_bbcc));
+  CLG_(forall_dirty_bbccs)(CLG_(zero_bbcc));
+  CLG_(clear_dirty_bbccs)();
 
   /* set counter for last dump */
   CLG_(copy_cost)( CLG_(sets).full, 
@@ -1418,6 +1903,7 @@ void CLG_(zero_all_cost)(Bool only_current_thread)
     zero_thread_cost(CLG_(get_current_thread)());
   else
     CLG_(forall_threads)(zero_thread_cost);
+  CLG_(sample_reset_estimates)();
 
   if (VG_(clo_verbosity) > 1)
     VG_(message)(Vg_DebugMsg, "  ...done\n");
@@ -1456,17 +1942,35 @@ void CLG_(set_instrument_state)(const HChar* reason, Bool state)
 	     reason, state ? "ON" : "OFF");
     return;
   }
-  CLG_(instrument_state) = state;
   CLG_DEBUG(2, "%s: Switching instrumentation %s ...\n",
 	   reason, state ? "ON" : "OFF");
 
-  VG_(discard_translations)( (Addr64)0x1000, (ULong) ~0xfffl, "callgrind");
+  /* cost centers are freed below, so write out their costs first */
+  if (!state && CLG_(clo).release_at_instr_off) {
+    HChar trigger[64];
+    VG_(snprintf)(trigger, sizeof(trigger), "%s: instrumentation off",
+		  reason);
+    CLG_(dump_profile)(trigger, False);
+  }
+
+  CLG_(instrument_state) = state;
+
+  /* With guarded helper calls, existing translations stay valid.
+   * Uninstrumented ones from before the first switch on are thrown away once */
+  if (!CLG_(clo).fast_instr_toggle || !guarded_translations)
+    VG_(discard_translations)( (Addr64)0x1000, (ULong) ~0xfffl, "callgrind");
 
   /* reset internal state: call stacks, simulator */
   CLG_(forall_threads)(unwind_thread);
-  CLG_(forall_threads)(zero_state_cost);
+  /* with --count-only, state costs are the only place keeping Ir */
+  if (!CLG_(clo).count_only)
+    CLG_(forall_threads)(zero_state_cost);
   (*CLG_(cachesim).clear)();
 
+  /* no call stack refers to a BBCC or JCC any longer */
+  if (!state && CLG_(clo).release_at_instr_off)
+    CLG_(release_cost_centers)();
+
   if (VG_(clo_verbosity) > 1)
     VG_(message)(Vg_DebugMsg, "%s: instrumentation switched %s\n",
 		 reason, state ? "ON" : "OFF");
@@ -1682,6 +2186,53 @@ Bool CLG_(handle_client_request)(ThreadId tid, UWord *args, UWord *ret)
      *ret = 0;                 /* meaningless */
      break;
 
+   case VG_USERREQ__GET_COUNTERS:
+     if (!VG_(am_is_valid_for_client)(args[1], args[2] * sizeof(ULong),
+				      VKI_PROT_WRITE)) {
+       *ret = 0;
+       break;
+     }
+     *ret = CLG_(get_counters)(tid, (ULong*)args[1], (Int)args[2]);
+     break;
+
+   case VG_USERREQ__GET_EVENT_NAMES:
+     {
+       HChar buf[COSTS_LEN];
+       Int len = CLG_(sprint_eventmapping)(buf, CLG_(dumpmap));
+
+       if ((args[2] > 0) &&
+	   VG_(am_is_valid_for_client)(args[1], args[2], VKI_PROT_WRITE)) {
+	 if (len >= (Int)args[2]) len = args[2]-1;
+	 VG_(memcpy)((HChar*)args[1], buf, len);
+	 ((HChar*)args[1])[len] = 0;
+       }
+       *ret = CLG_(dumpmap)->size;
+     }
+     break;
+
+   case VG_USERREQ__REGION_BEGIN:
+     CLG_(region_begin)(tid, (HChar*)args[1]);
+     *ret = 0;                 /* meaningless */
+     break;
+
+   case VG_USERREQ__REGION_END:
+     if (!CLG_(region_end)(tid, (HChar*)args[1]))
+       VG_(message)(Vg_UserMsg,
+		    "Warning: region '%s' ended, but not started\n",
+		    (HChar*)args[1]);
+     *ret = 0;                 /* meaningless */
+     break;
+
+   case VG_USERREQ__GET_REGION_COUNTERS:
+     if (!VG_(am_is_valid_for_client)(args[2], args[3] * sizeof(ULong),
+				      VKI_PROT_WRITE)) {
+       *ret = -1;
+       break;
+     }
+     *ret = CLG_(get_region_counters)((HChar*)args[1],
+				     (ULong*)args[2], (Int)args[3]);
+     break;
+
    case VG_USERREQ__GDB_MONITOR_COMMAND: {
       Bool handled = handle_gdb_monitor_command (tid, (HChar*)args[1]);
       if (handled)
@@ -1751,204 +2302,18 @@ void CLG_(post_syscalltime)(ThreadId tid, UInt syscallno,
 
     CLG_(current_state).cost[o] ++;
     CLG_(current_state).cost[o+1] += diff;
-    if (!CLG_(current_state).bbcc->skipped)
-      CLG_(init_cost_lz)(CLG_(sets).full,
-			&(CLG_(current_state).bbcc->skipped));
+    CLG_(init_skipped_cost)(CLG_(current_state).bbcc);
     CLG_(current_state).bbcc->skipped[o] ++;
     CLG_(current_state).bbcc->skipped[o+1] += diff;
   }
 }
 
-/*** collect_openclose patch ***/
-
-/* Syscall collect_openclose(coc) */
-#define MAX_CLOSE_FILE_FD 2048
-
-struct int_set {
-    Int items[MAX_CLOSE_FILE_FD];
-    Int size;
-    Int capacity;
-};
-
-void int_set_init(struct int_set* this){
-    this->size = 0;
-    this->capacity = MAX_CLOSE_FILE_FD;
-}
-
-void int_set_add(struct int_set* this, Int num){
-    if (this->size >= this->capacity){
-        return;
-    }
-    this->items[this->size] = num;
-    this->size++;
-}
-
-Bool int_set_is_inset(struct int_set* this, Int num){
-    Int i;
-    for(i=0; i<this->size; i++){
-        if (this->items[i] == num){
-            return True;
-        }
-    }
-    return False;
-}
-
-Bool int_set_remove(struct int_set* this, Int num){
-    if (this->size == 0){
-        return False;
-    }
-
-    Int i;
-    Bool removed = False;
-    for(i=0; i<this->size; i++){
-        if (removed){
-            this->items[i-1] = this->items[i];
-            continue;
-        }
-
-        if (this->items[i] == num){
-            // item[i] is removed.
-            removed = True;
-        }
-    }
-
-    if (removed){
-        this->size--;
-        return True;
-    }
-    return False;
-}
-
-Bool CLG_(open_close_file_current) = False;
-Bool CLG_(dup_close_file_current) = False;
-// Int CLG_(num_of_close_file_fds) = 0;
-// Int CLG_(close_file_fds)[16] = {0};
-struct int_set CLG_(close_file_fds);
-Int CLG_(coc_dbg_level) = 1;
-#if defined(VGP_x86_linux)
-    Int CLG_(sys_open_num) = 5;
-    Int CLG_(sys_close_num) = 6;
-    Int CLG_(sys_dup_num) = 41;
-    Int CLG_(sys_dup2_num) = 63;
-    Int CLG_(sys_dup3_num) = 330;
-#elif defined(VGP_amd64_linux)
-    Int CLG_(sys_open_num) = 2;
-    Int CLG_(sys_close_num) = 3;
-    Int CLG_(sys_dup_num) = 32;
-    Int CLG_(sys_dup2_num) = 33;
-    Int CLG_(sys_dup3_num) = 292;
-#else
-    CLG_DEBUG(CLG_(coc_dbg_level), "Unsupported platform, open()/close() use x86 system call number");
-    Int CLG_(sys_open_num) = 5;
-    Int CLG_(sys_close_num) = 6;
-    Int CLG_(sys_dup_num) = 41;
-    Int CLG_(sys_dup2_num) = 63;
-    Int CLG_(sys_dup3_num) = 330;
-#endif
-
-Int path_cmp(const HChar* path1, const HChar* path2){
-  /* simple path comparsion 
-   * just add checking for relative path start with ./ and not.
-   *
-   * not progress now
-   * 1. .. and . in path
-   * 2. relative and absolute path
-   * 3. symbolic link
-   * 4. hard link
-   */
-  const HChar* p1 = path1;
-  const HChar* p2 = path2;
-
-  /* relative path start with ./ */
-  if(VG_(strncmp)(p1, "./", 2) == 0)
-      p1 += 2;
-  if(VG_(strncmp)(p2, "./", 2) == 0)
-      p2 += 2;
-  
-  return VG_(strcmp)(p1, p2);
-}
-
-static
-void CLG_(pre_syscallcoc)(ThreadId tid, UInt syscallno,
-                           UWord* args, UInt nArgs){
-  /*
-   * need comment.
-   */
-  if (CLG_(clo).collect_openclose){
-    /* count between Open/Close */
-    if (syscallno == CLG_(sys_open_num)){ /* open */
-      CLG_DEBUG(CLG_(coc_dbg_level), "system call open: filename = %s\n", (HChar*)args[0])
-
-      if (path_cmp((HChar*)args[0], CLG_(clo).collect_openfile) == 0){ 
-        /* if open input file */
-        CLG_DEBUG(CLG_(coc_dbg_level), "collect openfile open\n");
-        /* start instrumentation */
-        CLG_(set_instrument_state)("COC: open", True);
-      }
-      else if (path_cmp((HChar*)args[0], CLG_(clo).collect_closefile) == 0){ 
-        /* if open output file */
-        CLG_DEBUG(CLG_(coc_dbg_level), "collect closefile open\n");
-
-        CLG_(open_close_file_current) = True;
-      }
-    }
-    else if (syscallno == CLG_(sys_close_num)){ /* close */
-      CLG_DEBUG(CLG_(coc_dbg_level), "system call close: fd number = %d\n", (Int)args[0])
-      // CLG_DEBUG(CLG_(coc_dbg_level), "close file fds: %d\n", CLG_(close_file_fds)[0])
-      
-      if (int_set_is_inset(&CLG_(close_file_fds), (Int)args[0])){
-        /* if closing output file */
-        CLG_DEBUG(CLG_(coc_dbg_level), "collect closefile close\n");
-        int_set_remove(&CLG_(close_file_fds), (Int)args[0]);
-        if (CLG_(close_file_fds).size == 0){
-          /* stop instrumentation */
-          CLG_DEBUG(CLG_(coc_dbg_level), "all closefiles are closed\n");
-          CLG_(set_instrument_state)("COC: close", False);
-        }
-      }
-    }
-    else if (syscallno == CLG_(sys_dup_num) || syscallno == CLG_(sys_dup2_num) || syscallno == CLG_(sys_dup3_num)){
-      CLG_DEBUG(CLG_(coc_dbg_level), "system call dup: old fd number = %d\n", (Int)args[0])
-      if (int_set_is_inset(&CLG_(close_file_fds), (Int)args[0])){
-        /* if duping output file */
-        CLG_DEBUG(CLG_(coc_dbg_level), "collect closefile dup\n");
-
-        CLG_(dup_close_file_current) = True;
-      }
-    }
-  }
-}
-
-static
-void CLG_(post_syscallcoc)(ThreadId tid, UInt syscallno,
-                            UWord* args, UInt nArgs, SysRes res){
-  if (CLG_(clo).collect_openclose){
-    /* count between Open/Close */
-    if (CLG_(open_close_file_current) == True){ /* open */
-      CLG_DEBUG(CLG_(coc_dbg_level), "collect closefile fd = %d\n", (Int)sr_Res(res))
-      int_set_add(&CLG_(close_file_fds), sr_Res(res));
-      // CLG_(num_of_close_file_fds) = 1;
-      // CLG_(close_file_fds)[0] = sr_Res(res);
-      CLG_(open_close_file_current) = False;
-    }
-    else if (CLG_(dup_close_file_current) == True){ /* dup */
-      if ((Int)sr_Res < 0){
-        CLG_DEBUG(CLG_(coc_dbg_level), "dup failed\n");
-        return;
-      }
-      CLG_DEBUG(CLG_(coc_dbg_level), "collect closefile fd(dup) = %d\n", (Int)sr_Res(res))
-      int_set_add(&CLG_(close_file_fds), sr_Res(res));
-      CLG_(dup_close_file_current) = False;
-    }
-  }
-}
-
 /* Syscall main function - do time and coc */
 
 static
 void CLG_(pre_syscall)(ThreadId tid, UInt syscallno,
                            UWord* args, UInt nArgs){
-  CLG_(pre_syscallcoc)(tid, syscallno, args, nArgs);
+  CLG_(pre_syscall_openclose)(tid, syscallno, args, nArgs);
   CLG_(pre_syscalltime)(tid, syscallno, args, nArgs);
 }
 
@@ -1956,11 +2321,9 @@ static
 void CLG_(post_syscall)(ThreadId tid, UInt syscallno,
                             UWord* args, UInt nArgs, SysRes res){
   CLG_(post_syscalltime)(tid, syscallno, args, nArgs, res);
-  CLG_(post_syscallcoc)(tid, syscallno, args, nArgs, res);
+  CLG_(post_syscall_openclose)(tid, syscallno, args, nArgs, res);
 }
 
-/*** collect_openclose patch end ***/
-
 static UInt ULong_width(ULong n)
 {
    UInt w = 0;
@@ -2012,7 +2375,7 @@ void branchsim_printstat(int l1, int l2, int l3)
 
 
 static
-void finish(void)
+void finish(const HChar* trigger)
 {
   HChar buf[32+COSTS_LEN];
   HChar fmt[128];
@@ -2027,7 +2390,8 @@ void finish(void)
    */
   CLG_(forall_threads)(unwind_thread);
 
-  CLG_(dump_profile)(0, False);
+  CLG_(dump_final_profile)(trigger);
+  CLG_(finish_live_stats)();
 
   if (VG_(clo_verbosity) == 0) return;
   
@@ -2058,6 +2422,8 @@ void finish(void)
 		 CLG_(stat).distinct_jccs);
     VG_(message)(Vg_DebugMsg, "Distinct skips:   %d\n",
 		 CLG_(stat).distinct_skips);
+    VG_(message)(Vg_DebugMsg, "Arena chunks:     %d (Releases %d)\n",
+		 CLG_(stat).arena_chunks, CLG_(stat).cc_releases);
     VG_(message)(Vg_DebugMsg, "BB lookups:       %d\n",
 		 BB_lookups);
     if (BB_lookups>0) {
@@ -2076,6 +2442,11 @@ void finish(void)
     }
     VG_(message)(Vg_DebugMsg, "BBCC Clones:       %d\n",
 		 CLG_(stat).bbcc_clones);
+    if (CLG_(clo).max_context_memory > 0)
+      VG_(message)(Vg_DebugMsg, "Context memory:    %llu (Clones %llu, "
+		   "folded %d contexts, %d recursions)\n",
+		   CLG_(stat).context_memory, CLG_(stat).clone_memory,
+		   CLG_(stat).folded_contexts, CLG_(stat).folded_recursions);
     VG_(message)(Vg_DebugMsg, "BBs Retranslated:  %d\n",
 		 CLG_(stat).bb_retranslations);
     VG_(message)(Vg_DebugMsg, "Distinct instrs:   %d\n",
@@ -2108,6 +2479,7 @@ void finish(void)
   VG_(message)(Vg_UserMsg, "Events    : %s\n", buf);
   CLG_(sprint_mappingcost)(buf, CLG_(dumpmap), CLG_(total_cost));
   VG_(message)(Vg_UserMsg, "Collected : %s\n", buf);
+  CLG_(print_regions)();
   VG_(message)(Vg_UserMsg, "\n");
 
   /* determine value widths for statistics */
@@ -2142,7 +2514,21 @@ void finish(void)
 
 void CLG_(fini)(Int exitcode)
 {
-  finish();
+  finish(0);
+}
+
+/* Called when the instruction budget given with --max-instructions
+ * is used up: write the final dump and terminate the program.
+ */
+void CLG_(max_instructions_reached)(void)
+{
+  VG_(message)(Vg_UserMsg,
+	       "Instruction limit of %llu reached, terminating program.\n",
+	       CLG_(clo).max_instructions);
+
+  finish("Instruction limit");
+
+  VG_(exit)(MAX_INSTRUCTIONS_EXITCODE);
 }
 
 
@@ -2157,6 +2543,11 @@ static void clg_start_client_code_callback ( ThreadId tid, ULong blocks_done )
    if (0)
       VG_(printf)("%d R %llu\n", (Int)tid, blocks_done);
 
+   /* Without setup_bbcc (--count-only), this is the only place where
+    * the thread switch is noticed. Costs must go to the right thread. */
+   if (CLG_(clo).count_only)
+      CLG_(switch_thread)( tid );
+
    /* throttle calls to CLG_(run_thread) by number of BBs executed */
    if (blocks_done - last_blocks_done < 5000) return;
    last_blocks_done = blocks_done;
@@ -2164,6 +2555,12 @@ static void clg_start_client_code_callback ( ThreadId tid, ULong blocks_done )
    CLG_(run_thread)( tid );
 }
 
+/* a forked child gets its own live statistics page */
+static void live_stats_atfork_child(ThreadId tid)
+{
+   CLG_(init_live_stats)();
+}
+
 static
 void CLG_(post_clo_init)(void)
 {
@@ -2199,7 +2596,28 @@ void CLG_(post_clo_init)(void)
        CLG_(clo).dump_line = True;
    }
 
+   if (CLG_(clo).count_only) {
+       if (CLG_(clo).simulate_cache || CLG_(clo).simulate_branch ||
+           CLG_(clo).collect_bus || CLG_(clo).collect_mix ||
+           CLG_(clo).cost_model)
+           VG_(fmsg_bad_option)("--count-only=yes",
+                                "Event simulation is not possible when "
+                                "only counting instructions.\n");
+       if (!CLG_(clo).collect_atstart || CLG_(clo).dump_every_bb > 0)
+           VG_(fmsg_bad_option)("--count-only=yes",
+                                "Collection toggling and --dump-every-bb "
+                                "need full instrumentation.\n");
+   }
+
+   if (CLG_(clo).dump_index &&
+       (CLG_(clo).binary_format || CLG_(clo).combine_dumps ||
+        !CLG_(clo).compress_strings))
+       VG_(fmsg_bad_option)("--dump-index=yes",
+                            "An index can only be written for separate dump "
+                            "files in text format with compressed strings.\n");
+
    CLG_(init_dumps)();
+   CLG_(init_cost_model)();
 
    (*CLG_(cachesim).post_clo_init)();
 
@@ -2216,19 +2634,20 @@ void CLG_(post_clo_init)(void)
    CLG_(run_thread)(1);
 
    CLG_(instrument_state) = CLG_(clo).instrument_atstart;
+   CLG_(instr_budget) = (CLG_(clo).max_instructions > 0) ?
+      (Long)CLG_(clo).max_instructions : 0x7FFFFFFFFFFFFFFFLL;
 
    if (VG_(clo_verbosity > 0)) {
       VG_(message)(Vg_UserMsg,
                    "For interactive control, run 'callgrind_control -h'.\n");
    }
 
-   if (CLG_(clo).collect_openclose) {
-       CLG_(instrument_state) = False;
-       CLG_(clo).collect_openfile = "input.txt";
-       CLG_(clo).collect_closefile = "output.txt";
-       int_set_init(&CLG_(close_file_fds));
+   CLG_(init_openclose)();
+
+   if (CLG_(clo).live_stats) {
+      CLG_(init_live_stats)();
+      VG_(atfork)(0, 0, live_stats_atfork_child);
    }
-   CLG_DEBUG(CLG_(coc_dbg_level), "collect_openclose is %s.\n", CLG_(clo).collect_openclose?"True":"False");
 }
 
 static
@@ -2246,6 +2665,7 @@ void CLG_(pre_clo_init)(void)
        = VexRegUpdSpAtMemAccess; // overridable by the user.
     VG_(clo_vex_control).iropt_unroll_thresh = 0;   // cannot be overriden.
     VG_(clo_vex_control).guest_chase_thresh = 0;    // cannot be overriden.
+    VG_(clo_defer_debuginfo) = True; // overridable by the user.
 
     VG_(basic_tool_funcs)        (CLG_(post_clo_init),
                                   CLG_(instrument),
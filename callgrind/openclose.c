@@ -0,0 +1,587 @@
+/*--------------------------------------------------------------------*/
+/*--- Callgrind                                                    ---*/
+/*---                                                  openclose.c ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Callgrind, a Valgrind tool for call tracing.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+#include "global.h"
+
+#include "pub_tool_threadstate.h"
+#include "pub_tool_vkiscnums.h"
+#include "pub_tool_aspacemgr.h"
+
+/*------------------------------------------------------------*/
+/*--- File descriptor sets                                 ---*/
+/*------------------------------------------------------------*/
+
+/* The kernel hands out the lowest free file descriptor, so fds are
+ * small and dense. A bitmap indexed by fd number gives O(1) insertion,
+ * removal and lookup, and is grown on demand.
+ */
+
+#define N_FDSET_INITIAL_FDS 1024
+#define FDSET_WORD_BITS     (8 * sizeof(UWord))
+
+void CLG_(init_fdset)(fdset* s)
+{
+   CLG_ASSERT(s != 0);
+
+   s->size    = 0;
+   s->entries = 0;
+   s->bits    = 0;
+}
+
+/* grow bitmap to include <fd> */
+static void resize_fdset(fdset* s, UInt fd)
+{
+   UInt i, new_size;
+   UWord* new_bits;
+
+   new_size = s->size ? s->size : N_FDSET_INITIAL_FDS;
+   while (new_size <= fd) new_size *= 2;
+
+   new_bits = (UWord*) CLG_MALLOC("cl.openclose.rf.1",
+                                  new_size / FDSET_WORD_BITS * sizeof(UWord));
+   for (i = 0; i < new_size / FDSET_WORD_BITS; i++)
+      new_bits[i] = (i < s->size / FDSET_WORD_BITS) ? s->bits[i] : 0;
+
+   if (s->bits) VG_(free)(s->bits);
+
+   CLG_DEBUG(0, "Resize fd set: %d => %d\n", s->size, new_size);
+
+   s->size = new_size;
+   s->bits = new_bits;
+}
+
+Bool CLG_(fdset_contains)(fdset* s, Int fd)
+{
+   if ((fd < 0) || ((UInt)fd >= s->size)) return False;
+   return (s->bits[fd / FDSET_WORD_BITS] >> (fd % FDSET_WORD_BITS)) & 1;
+}
+
+/* Returns True if <fd> was not in the set before */
+Bool CLG_(fdset_add)(fdset* s, Int fd)
+{
+   UWord mask;
+
+   if (fd < 0) return False;
+   if ((UInt)fd >= s->size) resize_fdset(s, fd);
+
+   mask = (UWord)1 << (fd % FDSET_WORD_BITS);
+   if (s->bits[fd / FDSET_WORD_BITS] & mask) return False;
+   s->bits[fd / FDSET_WORD_BITS] |= mask;
+   s->entries++;
+   return True;
+}
+
+/* Returns True if <fd> was in the set */
+Bool CLG_(fdset_remove)(fdset* s, Int fd)
+{
+   UWord mask;
+
+   if (!CLG_(fdset_contains)(s, fd)) return False;
+
+   mask = (UWord)1 << (fd % FDSET_WORD_BITS);
+   s->bits[fd / FDSET_WORD_BITS] &= ~mask;
+   s->entries--;
+   return True;
+}
+
+/* Remove all fds in [first, last], returning the number removed */
+UInt CLG_(fdset_remove_range)(fdset* s, UInt first, UInt last)
+{
+   UInt fd, removed = 0;
+
+   if (s->entries == 0) return 0;
+   if (last >= s->size) last = s->size - 1;
+
+   for (fd = first; fd <= last; fd++) {
+      /* skip empty words quickly */
+      if ((fd % FDSET_WORD_BITS == 0) &&
+          (s->bits[fd / FDSET_WORD_BITS] == 0)) {
+         fd += FDSET_WORD_BITS - 1;
+         continue;
+      }
+      if (CLG_(fdset_remove)(s, fd)) removed++;
+   }
+   return removed;
+}
+
+
+/*------------------------------------------------------------*/
+/*--- Collection windows (--collect-window, --collect-openclose) ---*/
+/*------------------------------------------------------------*/
+
+/* A collection window is opened when the program opens its openfile,
+ * and closed when the last file descriptor referring to its closefile
+ * is closed. File descriptors of closefiles are tracked through dup*(),
+ * fcntl(F_DUPFD*) and close_range().
+ *
+ * Instrumentation is on while at least one window is open. Each window
+ * accumulates the Ir executed while it is open; a window can be opened
+ * and closed multiple times. --collect-openclose is a window named
+ * "openclose" for --collect-openfile/--collect-closefile.
+ *
+ * The fd sets are per process, as is the fd table of the kernel: a
+ * forked child starts with a copy of the sets of its parent, matching
+ * the fds it inherits.
+ *
+ * The pre-syscall callback decides what to do with the result of a
+ * syscall; as syscalls of different threads can interleave, this is
+ * stored per thread until the post-syscall callback.
+ */
+
+/* close_range() flag which only marks fds close-on-exec */
+#define COC_CLOSE_RANGE_CLOEXEC (1U << 2)
+
+#define N_WINDOWS_INITIAL_ENTRIES 4
+#define MAX_WINDOW_NAME_LEN       64
+
+typedef struct _coc_window coc_window;
+struct _coc_window {
+   const HChar* name;
+   const HChar* openfile;
+   const HChar* closefile;
+   fdset close_fds;       /* open fds referring to closefile */
+
+   Bool  active;
+   UInt  activations;
+   ULong ir;              /* Ir of finished activations */
+   ULong ir_start;        /* total Ir at start of current activation */
+};
+
+enum coc_action {
+   coc_none = 0,
+   coc_open,        /* result fd is a new fd of a closefile */
+   coc_dup,         /* result fd is a copy of a tracked fd */
+   coc_dup_to,      /* dup2/dup3: newfd is (re)placed */
+   coc_close_range  /* range of fds was closed */
+};
+
+typedef struct _coc_pending coc_pending;
+struct _coc_pending {
+   enum coc_action action;
+   UWord arg1, arg2;    /* coc_open: first window matching closefile;
+                         * coc_dup*: oldfd, newfd;
+                         * coc_close_range: range */
+};
+
+static coc_window* windows = 0;
+static Int windows_size = 0;
+static Int windows_count = 0;
+static Int active_windows = 0;
+
+static coc_pending pending[VG_N_THREADS];
+
+static Int coc_dbg_level = 1;
+
+static coc_window* new_window(void)
+{
+   coc_window* new_windows;
+   Int i;
+
+   if (windows_count == windows_size) {
+      windows_size = windows_size ? 2 * windows_size
+                                  : N_WINDOWS_INITIAL_ENTRIES;
+      new_windows = (coc_window*) CLG_MALLOC("cl.openclose.nw.1",
+                                             windows_size * sizeof(coc_window));
+      for (i = 0; i < windows_count; i++)
+         new_windows[i] = windows[i];
+      if (windows) VG_(free)(windows);
+      windows = new_windows;
+   }
+   return &windows[windows_count++];
+}
+
+static void add_window(const HChar* name,
+                       const HChar* openfile, const HChar* closefile)
+{
+   coc_window* w = new_window();
+
+   w->name        = name;
+   w->openfile    = openfile;
+   w->closefile   = closefile;
+   CLG_(init_fdset)(&w->close_fds);
+   w->active      = False;
+   w->activations = 0;
+   w->ir          = 0;
+   w->ir_start    = 0;
+}
+
+/* Parse "<name>:open=<path>,close=<path>" of --collect-window.
+ * Returns False on a malformed specification. */
+Bool CLG_(add_collect_window)(const HChar* spec)
+{
+   const HChar *colon, *open, *sep, *close;
+   HChar *name, *openfile;
+   Int i;
+
+   colon = VG_(strchr)(spec, ':');
+   if (!colon || (colon == spec) ||
+       (colon - spec > MAX_WINDOW_NAME_LEN)) return False;
+   if (VG_(strncmp)(colon+1, "open=", 5) != 0) return False;
+   open = colon + 6;
+   sep = VG_(strstr)(open, ",close=");
+   if (!sep || (sep == open)) return False;
+   close = sep + 7;
+   if (*close == 0) return False;
+
+   for (i = 0; i < windows_count; i++)
+      if ((VG_(strlen)(windows[i].name) == colon - spec) &&
+          (VG_(strncmp)(windows[i].name, spec, colon - spec) == 0))
+         return False;
+
+   name = (HChar*) CLG_MALLOC("cl.openclose.acw.1", colon - spec + 1);
+   VG_(strncpy)(name, spec, colon - spec);
+   name[colon - spec] = 0;
+   openfile = (HChar*) CLG_MALLOC("cl.openclose.acw.2", sep - open + 1);
+   VG_(strncpy)(openfile, open, sep - open);
+   openfile[sep - open] = 0;
+
+   add_window(name, openfile,
+              VG_(strdup)("cl.openclose.acw.3", close));
+   return True;
+}
+
+Int CLG_(collect_window_count)(void)
+{
+   return windows_count;
+}
+
+/* Print description of window <i> as "desc:" line of a dump */
+Int CLG_(sprint_collect_window)(HChar* buf, Int i)
+{
+   coc_window* w;
+   ULong ir;
+
+   CLG_ASSERT((i >= 0) && (i < windows_count));
+   w = &windows[i];
+   ir = w->ir;
+   if (w->active) {
+      ULong now = CLG_(get_total_ir)();
+      if (now > w->ir_start) ir += now - w->ir_start;
+   }
+   return VG_(sprintf)(buf, "desc: Window %s: Ir=%llu, activations=%u%s\n",
+                       w->name, ir, w->activations,
+                       w->active ? " (open)" : "");
+}
+
+static Int path_cmp(const HChar* path1, const HChar* path2)
+{
+  /* simple path comparsion
+   * just add checking for relative path start with ./ and not.
+   *
+   * not progress now
+   * 1. .. and . in path
+   * 2. relative and absolute path
+   * 3. symbolic link
+   * 4. hard link
+   */
+  const HChar* p1 = path1;
+  const HChar* p2 = path2;
+
+  /* relative path start with ./ */
+  if(VG_(strncmp)(p1, "./", 2) == 0)
+      p1 += 2;
+  if(VG_(strncmp)(p2, "./", 2) == 0)
+      p2 += 2;
+
+  return VG_(strcmp)(p1, p2);
+}
+
+/* path argument of open-like syscalls, or 0 if it is not a readable,
+ * NUL-terminated string of at most VKI_PATH_MAX bytes */
+static const HChar* client_path(UWord arg)
+{
+   Addr a = (Addr)arg;
+   Addr end = a + VKI_PATH_MAX;
+   Addr page_end;
+
+   if (end < a) return 0;
+
+   while (a < end) {
+      /* check readability once per page, then scan for the NUL */
+      page_end = VG_PGROUNDUP(a + 1);
+      if (!VG_(am_is_valid_for_client)(a, page_end - a, VKI_PROT_READ))
+         return 0;
+      for (; a < page_end && a < end; a++)
+         if (*(const HChar*)a == 0) return (const HChar*) arg;
+   }
+   return 0;
+}
+
+static void window_open(coc_window* w)
+{
+   if (w->active) return;
+
+   CLG_DEBUG(coc_dbg_level, "window %s: open\n", w->name);
+
+   /* start instrumentation; this resets state costs, so take
+    * the start value afterwards */
+   if (active_windows == 0)
+      CLG_(set_instrument_state)("COC: open", True);
+
+   active_windows++;
+   w->active = True;
+   w->activations++;
+   w->ir_start = CLG_(get_total_ir)();
+}
+
+static void window_close(coc_window* w)
+{
+   ULong now;
+
+   if (!w->active) return;
+
+   now = CLG_(get_total_ir)();
+   if (now > w->ir_start) w->ir += now - w->ir_start;
+   w->active = False;
+   active_windows--;
+
+   CLG_DEBUG(coc_dbg_level, "window %s: close, Ir %llu\n", w->name, w->ir);
+
+   /* stop instrumentation */
+   if (active_windows == 0)
+      CLG_(set_instrument_state)("COC: close", False);
+}
+
+/* fd was removed from closefile fds of window <w> */
+static void window_fd_closed(coc_window* w)
+{
+   if (w->close_fds.entries > 0) return;
+
+   CLG_DEBUG(coc_dbg_level, "window %s: all closefiles are closed\n",
+             w->name);
+   window_close(w);
+}
+
+static Bool fd_tracked(Int fd)
+{
+   Int i;
+
+   for (i = 0; i < windows_count; i++)
+      if (CLG_(fdset_contains)(&windows[i].close_fds, fd)) return True;
+   return False;
+}
+
+static void coc_opened(ThreadId tid, const HChar* path)
+{
+   Int i;
+   Bool is_closefile = False;
+
+   if (!path) return;
+
+   CLG_DEBUG(coc_dbg_level, "system call open: filename = %s\n", path);
+
+   for (i = 0; i < windows_count; i++) {
+      if (path_cmp(path, windows[i].openfile) == 0) {
+         /* if open input file */
+         window_open(&windows[i]);
+      }
+      else if (!is_closefile && (path_cmp(path, windows[i].closefile) == 0)) {
+         /* if open output file: track fd returned */
+         CLG_DEBUG(coc_dbg_level, "collect closefile open\n");
+         is_closefile = True;
+         pending[tid].action = coc_open;
+         pending[tid].arg1 = i;
+      }
+   }
+}
+
+void CLG_(pre_syscall_openclose)(ThreadId tid, UInt syscallno,
+                                 UWord* args, UInt nArgs)
+{
+   Int i;
+
+   if (windows_count == 0) return;
+
+   CLG_ASSERT(tid < VG_N_THREADS);
+   pending[tid].action = coc_none;
+
+   switch (syscallno) {
+#if defined(VGO_linux)
+#if defined(__NR_open)
+   case __NR_open:
+#endif
+#if defined(__NR_creat)
+   case __NR_creat:
+#endif
+      coc_opened(tid, client_path(args[0]));
+      break;
+
+   case __NR_openat:
+#if defined(__NR_openat2)
+   case __NR_openat2:
+#endif
+      coc_opened(tid, client_path(args[1]));
+      break;
+
+   case __NR_close:
+      CLG_DEBUG(coc_dbg_level, "system call close: fd number = %d\n",
+                (Int)args[0]);
+      /* Linux always releases the fd, even if close() fails */
+      for (i = 0; i < windows_count; i++)
+         if (CLG_(fdset_remove)(&windows[i].close_fds, (Int)args[0]))
+            window_fd_closed(&windows[i]);
+      break;
+
+   case __NR_dup:
+      if (fd_tracked((Int)args[0])) {
+         pending[tid].action = coc_dup;
+         pending[tid].arg1 = args[0];
+      }
+      break;
+
+#if defined(__NR_dup2)
+   case __NR_dup2:
+#endif
+   case __NR_dup3:
+      /* dup2(fd, fd) is a no-op */
+      if (args[0] == args[1]) break;
+      pending[tid].action = coc_dup_to;
+      pending[tid].arg1 = args[0];
+      pending[tid].arg2 = args[1];
+      break;
+
+   case __NR_fcntl:
+#if defined(__NR_fcntl64)
+   case __NR_fcntl64:
+#endif
+      if (((args[1] == VKI_F_DUPFD) || (args[1] == VKI_F_DUPFD_CLOEXEC)) &&
+          fd_tracked((Int)args[0])) {
+         pending[tid].action = coc_dup;
+         pending[tid].arg1 = args[0];
+      }
+      break;
+
+#if defined(__NR_close_range)
+   case __NR_close_range:
+      if (args[2] & COC_CLOSE_RANGE_CLOEXEC) break;
+      pending[tid].action = coc_close_range;
+      pending[tid].arg1 = args[0];
+      pending[tid].arg2 = args[1];
+      break;
+#endif
+#endif
+
+   default:
+      break;
+   }
+}
+
+void CLG_(post_syscall_openclose)(ThreadId tid, UInt syscallno,
+                                  UWord* args, UInt nArgs, SysRes res)
+{
+   coc_pending* p;
+   coc_window* w;
+   Int i;
+
+   if (windows_count == 0) return;
+
+   CLG_ASSERT(tid < VG_N_THREADS);
+   p = &pending[tid];
+   if (p->action == coc_none) return;
+
+   if (sr_isError(res)) {
+      CLG_DEBUG(coc_dbg_level, "syscall %d failed\n", syscallno);
+      p->action = coc_none;
+      return;
+   }
+
+   switch (p->action) {
+   case coc_open: {
+      const HChar* closefile = windows[p->arg1].closefile;
+
+      CLG_DEBUG(coc_dbg_level, "collect closefile fd = %d\n",
+                (Int)sr_Res(res));
+      for (i = p->arg1; i < windows_count; i++) {
+         w = &windows[i];
+         if ((path_cmp(closefile, w->closefile) == 0) &&
+             (path_cmp(closefile, w->openfile) != 0))
+            CLG_(fdset_add)(&w->close_fds, (Int)sr_Res(res));
+      }
+      break;
+   }
+
+   case coc_dup:
+      CLG_DEBUG(coc_dbg_level, "collect closefile fd = %d\n",
+                (Int)sr_Res(res));
+      for (i = 0; i < windows_count; i++) {
+         w = &windows[i];
+         if (CLG_(fdset_contains)(&w->close_fds, (Int)p->arg1))
+            CLG_(fdset_add)(&w->close_fds, (Int)sr_Res(res));
+      }
+      break;
+
+   case coc_dup_to:
+      /* newfd is silently closed before, and now refers to the source */
+      for (i = 0; i < windows_count; i++) {
+         w = &windows[i];
+         if (CLG_(fdset_contains)(&w->close_fds, (Int)p->arg1)) {
+            CLG_DEBUG(coc_dbg_level, "collect closefile fd(dup) = %d\n",
+                      (Int)p->arg2);
+            CLG_(fdset_add)(&w->close_fds, (Int)p->arg2);
+         }
+         else if (CLG_(fdset_remove)(&w->close_fds, (Int)p->arg2))
+            window_fd_closed(w);
+      }
+      break;
+
+   case coc_close_range:
+      for (i = 0; i < windows_count; i++) {
+         w = &windows[i];
+         if (CLG_(fdset_remove_range)(&w->close_fds,
+                                      (UInt)p->arg1, (UInt)p->arg2) > 0)
+            window_fd_closed(w);
+      }
+      break;
+
+   default:
+      break;
+   }
+   p->action = coc_none;
+}
+
+void CLG_(init_openclose)(void)
+{
+   Int i;
+
+   if (CLG_(clo).collect_openclose)
+      add_window("openclose",
+                 CLG_(clo).collect_openfile, CLG_(clo).collect_closefile);
+
+   for (i = 0; i < VG_N_THREADS; i++)
+      pending[i].action = coc_none;
+
+   CLG_DEBUG(coc_dbg_level, "collection windows: %d\n", windows_count);
+   if (windows_count == 0) return;
+
+   /* instrumentation is switched on when a window opens;
+    * toggled at syscalls: keep translations */
+   CLG_(instrument_state) = False;
+   CLG_(clo).fast_instr_toggle = True;
+}
+
+/*--------------------------------------------------------------------*/
+/*--- end                                              openclose.c ---*/
+/*--------------------------------------------------------------------*/
@@ -0,0 +1,180 @@
+/*--------------------------------------------------------------------*/
+/*--- Callgrind                                                    ---*/
+/*---                                                     region.c ---*/
+/*--------------------------------------------------------------------*/
+
+/*
+   This file is part of Callgrind, a Valgrind tool for call tracing.
+
+   This program is free software; you can redistribute it and/or
+   modify it under the terms of the GNU General Public License as
+   published by the Free Software Foundation; either version 2 of the
+   License, or (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program; if not, write to the Free Software
+   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+   02111-1307, USA.
+
+   The GNU General Public License is contained in the file COPYING.
+*/
+
+#include "global.h"
+
+#include "pub_tool_threadstate.h"
+
+/*------------------------------------------------------------*/
+/*--- Named regions (client requests)                      ---*/
+/*------------------------------------------------------------*/
+
+/* A program can mark regions of its execution by name with
+ * CALLGRIND_REGION_BEGIN/END. Event counters of the thread are
+ * snapshotted at begin, and the difference at end is added to the
+ * totals of the region. Regions of a thread can be nested.
+ * Nothing is written to files; totals can be read back by the program
+ * and are printed at termination.
+ */
+
+typedef struct _region region;
+struct _region {
+  HChar* name;
+  ULong count;        /* number of finished regions */
+  FullCost cost;      /* summed up cost of finished regions */
+  region* next;
+};
+
+typedef struct _region_entry region_entry;
+struct _region_entry {
+  region* r;
+  FullCost enter_cost;
+};
+
+typedef struct _region_stack region_stack;
+struct _region_stack {
+  Int size, sp;
+  region_entry* entry;
+};
+
+static region* regions = 0;
+static region_stack region_stacks[VG_N_THREADS];
+
+/* Thread <tid> as given in client requests is the current thread */
+static region_stack* get_region_stack(ThreadId tid)
+{
+  region_stack* s;
+
+  CLG_ASSERT(tid > 0 && tid < VG_N_THREADS);
+  s = &(region_stacks[tid]);
+  if (s->sp < s->size) return s;
+
+  s->size = s->size ? 2 * s->size : 8;
+  s->entry = (region_entry*) VG_(realloc)("cl.region.grs.1", s->entry,
+					  s->size * sizeof(region_entry));
+  VG_(memset)(s->entry + s->sp, 0, (s->size - s->sp) * sizeof(region_entry));
+  return s;
+}
+
+static region* get_region(const HChar* name, Bool create)
+{
+  region* r;
+
+  for(r = regions; r; r = r->next)
+    if (VG_(strcmp)(r->name, name) == 0) return r;
+  if (!create) return 0;
+
+  r = (region*) CLG_MALLOC("cl.region.gr.1", sizeof(region));
+  r->name = VG_(strdup)("cl.region.gr.2", name);
+  r->count = 0;
+  r->cost = 0;
+  CLG_(init_cost_lz)( CLG_(sets).full, &(r->cost) );
+  r->next = regions;
+  regions = r;
+  return r;
+}
+
+/* Current counters of thread <tid> into <cost> */
+static void get_thread_cost(ThreadId tid, FullCost cost)
+{
+  CLG_(zero_cost)( CLG_(sets).full, cost );
+  CLG_(add_thread_cost)( tid, cost );
+}
+
+void CLG_(region_begin)(ThreadId tid, const HChar* name)
+{
+  region_stack* s = get_region_stack(tid);
+  region_entry* e = &(s->entry[s->sp++]);
+
+  e->r = get_region(name, True);
+  CLG_(init_cost_lz)( CLG_(sets).full, &(e->enter_cost) );
+  get_thread_cost(tid, e->enter_cost);
+}
+
+/* Returns False if region <name> was not started in thread <tid> */
+Bool CLG_(region_end)(ThreadId tid, const HChar* name)
+{
+  static FullCost cost = 0;
+  region_stack* s = &(region_stacks[tid]);
+  Int i;
+
+  /* usually, the innermost region is ended */
+  for(i = s->sp-1; i >= 0; i--)
+    if (VG_(strcmp)(s->entry[i].r->name, name) == 0) break;
+  if (i < 0) return False;
+
+  CLG_(init_cost_lz)( CLG_(sets).full, &cost );
+  get_thread_cost(tid, cost);
+  CLG_(add_diff_cost)( CLG_(sets).full, s->entry[i].r->cost,
+		       s->entry[i].enter_cost, cost );
+  s->entry[i].r->count++;
+
+  /* regions started inside and not ended are dropped */
+  s->sp = i;
+  return True;
+}
+
+/* Write up to <n> counters of <cost> into <buf>, in the order of
+ * events in the profile dump. Returns the number of events */
+static Int copy_counters(FullCost cost, ULong* buf, Int n)
+{
+  EventMapping* em = CLG_(dumpmap);
+  Int i;
+
+  for(i = 0; (i < em->size) && (i < n); i++)
+    buf[i] = cost[ em->entry[i].offset ];
+  return em->size;
+}
+
+Int CLG_(get_counters)(ThreadId tid, ULong* buf, Int n)
+{
+  static FullCost cost = 0;
+
+  CLG_(init_cost_lz)( CLG_(sets).full, &cost );
+  get_thread_cost(tid, cost);
+  return copy_counters(cost, buf, n);
+}
+
+/* Returns -1 if there is no region <name> */
+Int CLG_(get_region_counters)(const HChar* name, ULong* buf, Int n)
+{
+  region* r = get_region(name, False);
+
+  if (!r) return -1;
+  return copy_counters(r->cost, buf, n);
+}
+
+void CLG_(print_regions)(void)
+{
+  HChar buf[COSTS_LEN];
+  region* r;
+
+  for(r = regions; r; r = r->next) {
+    CLG_(sprint_mappingcost)(buf, CLG_(dumpmap), r->cost);
+    VG_(message)(Vg_UserMsg, "Region %s (%llu x): %s\n",
+		 r->name, r->count, buf);
+  }
+}
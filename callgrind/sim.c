@@ -32,6 +32,8 @@
 
 #include "global.h"
 
+#include "pub_tool_threadstate.h"
+
 
 /* Notes:
   - simulates a write-allocate cache
@@ -243,24 +245,18 @@ static void print_cache(cache_t2* c)
  *  CacheModelResult cachesim_I1_ref(Addr a, UChar size)
  *  CacheModelResult cachesim_D1_ref(Addr a, UChar size)
  */
+/* Search <tag> in <set> of <assoc> ways, and make it MRU (set[0]).
+ * Called with constant <assoc> for common associativities, so that the
+ * compiler can unroll the search and shift loops. */
 __attribute__((always_inline))
 static __inline__
-CacheResult cachesim_setref(cache_t2* c, UInt set_no, UWord tag)
+CacheResult setref_lru(UWord* set, int assoc, UWord tag)
 {
     int i, j;
-    UWord *set;
-
-    set = &(c->tags[set_no * c->assoc]);
-
-    /* This loop is unrolled for just the first case, which is the most */
-    /* common.  We can't unroll any further because it would screw up   */
-    /* if we have a direct-mapped (1-way) cache.                        */
-    if (tag == set[0])
-        return Hit;
 
     /* If the tag is one other than the MRU, move it into the MRU spot  */
     /* and shuffle the rest down.                                       */
-    for (i = 1; i < c->assoc; i++) {
+    for (i = 1; i < assoc; i++) {
         if (tag == set[i]) {
             for (j = i; j > 0; j--) {
                 set[j] = set[j - 1];
@@ -271,7 +267,7 @@ CacheResult cachesim_setref(cache_t2* c, UInt set_no, UWord tag)
     }
 
     /* A miss;  install this tag as MRU, shuffle rest down. */
-    for (j = c->assoc - 1; j > 0; j--) {
+    for (j = assoc - 1; j > 0; j--) {
         set[j] = set[j - 1];
     }
     set[0] = tag;
@@ -279,6 +275,26 @@ CacheResult cachesim_setref(cache_t2* c, UInt set_no, UWord tag)
     return Miss;
 }
 
+__attribute__((always_inline))
+static __inline__
+CacheResult cachesim_setref(cache_t2* c, UInt set_no, UWord tag)
+{
+    UWord *set;
+
+    set = &(c->tags[set_no * c->assoc]);
+
+    /* Hit on the MRU entry is the most common case */
+    if (tag == set[0])
+        return Hit;
+
+    switch(c->assoc) {
+    case 8:  return setref_lru(set, 8, tag);
+    case 16: return setref_lru(set, 16, tag);
+    default: break;
+    }
+    return setref_lru(set, c->assoc, tag);
+}
+
 __attribute__((always_inline))
 static __inline__
 CacheResult cachesim_ref(cache_t2* c, Addr a, UChar size)
@@ -349,25 +365,17 @@ CacheModelResult cachesim_D1_ref(Addr a, UChar size)
  * this cache line (CACHELINE_DIRTY = 1). By OR'ing the reference
  * type (Read/Write), the line gets dirty on a write.
  */
+/* Write-back variant of setref_lru, see there */
 __attribute__((always_inline))
 static __inline__
-CacheResult cachesim_setref_wb(cache_t2* c, RefType ref, UInt set_no, UWord tag)
+CacheResult setref_lru_wb(UWord* set, int assoc, RefType ref, UWord tag)
 {
     int i, j;
-    UWord *set, tmp_tag;
+    UWord tmp_tag;
 
-    set = &(c->tags[set_no * c->assoc]);
-
-    /* This loop is unrolled for just the first case, which is the most */
-    /* common.  We can't unroll any further because it would screw up   */
-    /* if we have a direct-mapped (1-way) cache.                        */
-    if (tag == (set[0] & ~CACHELINE_DIRTY)) {
-	set[0] |= ref;
-        return Hit;
-    }
     /* If the tag is one other than the MRU, move it into the MRU spot  */
     /* and shuffle the rest down.                                       */
-    for (i = 1; i < c->assoc; i++) {
+    for (i = 1; i < assoc; i++) {
 	if (tag == (set[i] & ~CACHELINE_DIRTY)) {
 	    tmp_tag = set[i] | ref; // update dirty flag
             for (j = i; j > 0; j--) {
@@ -379,8 +387,8 @@ CacheResult cachesim_setref_wb(cache_t2* c, RefType ref, UInt set_no, UWord tag)
     }
 
     /* A miss;  install this tag as MRU, shuffle rest down. */
-    tmp_tag = set[c->assoc - 1];
-    for (j = c->assoc - 1; j > 0; j--) {
+    tmp_tag = set[assoc - 1];
+    for (j = assoc - 1; j > 0; j--) {
         set[j] = set[j - 1];
     }
     set[0] = tag | ref;
@@ -388,6 +396,28 @@ CacheResult cachesim_setref_wb(cache_t2* c, RefType ref, UInt set_no, UWord tag)
     return (tmp_tag & CACHELINE_DIRTY) ? MissDirty : Miss;
 }
 
+__attribute__((always_inline))
+static __inline__
+CacheResult cachesim_setref_wb(cache_t2* c, RefType ref, UInt set_no, UWord tag)
+{
+    UWord *set;
+
+    set = &(c->tags[set_no * c->assoc]);
+
+    /* Hit on the MRU entry is the most common case */
+    if (tag == (set[0] & ~CACHELINE_DIRTY)) {
+	set[0] |= ref;
+        return Hit;
+    }
+
+    switch(c->assoc) {
+    case 8:  return setref_lru_wb(set, 8, ref, tag);
+    case 16: return setref_lru_wb(set, 16, ref, tag);
+    default: break;
+    }
+    return setref_lru_wb(set, c->assoc, ref, tag);
+}
+
 __attribute__((always_inline))
 static __inline__
 CacheResult cachesim_ref_wb(cache_t2* c, RefType ref, Addr a, UChar size)
@@ -1278,6 +1308,315 @@ static void log_0I1Dw(InstrInfo* ii, Addr data_addr, Word data_size)
 
 
 
+/*------------------------------------------------------------*/
+/*--- Sampled simulation (--sample-period)                 ---*/
+/*------------------------------------------------------------*/
+
+/* With --sample-period=<P>, cache simulation is done in detail windows
+ * of --sample-detail instructions every <P> instructions. Each window is
+ * preceded by a warm-up window of --sample-warmup instructions, in which
+ * the simulated caches are updated without counting events. In between,
+ * the program is fast-forwarded.
+ * Phases switch at BB boundaries in setup_bbcc. Translations stay valid:
+ * simulation helper calls are guarded by the phase (see flushEvents in
+ * main.c), and the warm_* helpers below are used in warm-up windows.
+ *
+ * Ir is always exact: outside of detail windows, it is counted per BB in
+ * setup_bbcc, and at dump time, from the execution counters.
+ * Profile data only contains other simulator events of detail windows.
+ * Estimates are extrapolated from event rates per instruction in the
+ * windows, with 95% confidence intervals from the variation of the rates:
+ * in dumps for the Ir of the dump, using windows since the previous dump,
+ * and at termination for all collected Ir, using all windows.
+ * Caches are only warmed up for --sample-warmup instructions, so misses
+ * may be overestimated if that is not enough to refill them.
+ */
+
+static ULong clo_sample_period = 0;
+static ULong clo_sample_warmup = 100000;
+static ULong clo_sample_detail = 10000;
+
+Bool  CLG_(sampling)     = False;
+UChar CLG_(sample_phase) = SAMPLE_DETAIL;
+Long  CLG_(sample_left)  = 0x7FFFFFFFFFFFFFFFLL;
+
+/* Event rates of detail windows */
+typedef struct {
+    ULong windows;
+    ULong dropped;
+    double* rate_sum;     /* indexed by full cost offset */
+    double* rate_sqsum;
+} SampleStat;
+
+static Long  phase_len = 0;
+static FullCost window_start = 0;
+static FullCost window_end = 0;
+static SampleStat run_stat;      /* whole run, for termination */
+static SampleStat dump_stat;     /* since last dump */
+
+VG_REGPARM(1)
+static void warm_1I(InstrInfo* ii)
+{
+    current_ii = ii;
+    (*simulator.I1_Read)(CLG_(bb_base) + ii->instr_offset, ii->instr_size);
+}
+
+VG_REGPARM(3)
+static void warm_0I1Dr(InstrInfo* ii, Addr data_addr, Word data_size)
+{
+    current_ii = ii;
+    (*simulator.D1_Read)(data_addr, data_size);
+}
+
+VG_REGPARM(3)
+static void warm_0I1Dw(InstrInfo* ii, Addr data_addr, Word data_size)
+{
+    current_ii = ii;
+    (*simulator.D1_Write)(data_addr, data_size);
+}
+
+/* Event counters of all threads */
+static void sample_get_cost(FullCost c)
+{
+    Int t;
+
+    CLG_(zero_cost)( CLG_(sets).full, c );
+    for(t = 1; t < VG_N_THREADS; t++)
+	CLG_(add_thread_cost)( t, c );
+}
+
+/* Is <o> the offset of an event simulated in detail windows only?
+ * Ir itself is exact. */
+static Bool sample_event(Int o)
+{
+    Int g;
+
+    if (o == fullOffset(EG_IR)) return False;
+    for(g = EG_IR; g <= EG_DW; g++)
+	if (CLG_(get_event_group)(g) &&
+	    (o >= fullOffset(g)) &&
+	    (o < fullOffset(g) + CLG_(get_event_group)(g)->size))
+	    return True;
+    return False;
+}
+
+static void sample_stat_reset(SampleStat* s)
+{
+    Int i, size = CLG_(sets).full->size;
+
+    if (!s->rate_sum) {
+	s->rate_sum   = (double*) CLG_MALLOC("cl.sim.ssr.1",
+					     size * sizeof(double));
+	s->rate_sqsum = (double*) CLG_MALLOC("cl.sim.ssr.2",
+					     size * sizeof(double));
+    }
+    for(i = 0; i < size; i++)
+	s->rate_sum[i] = s->rate_sqsum[i] = 0.0;
+    s->windows = 0;
+    s->dropped = 0;
+}
+
+/* Add event rates of the finished detail window */
+static void sample_end_window(void)
+{
+    Int i, size = CLG_(sets).full->size;
+    ULong ir;
+
+    if (!run_stat.rate_sum)  sample_stat_reset(&run_stat);
+    if (!dump_stat.rate_sum) sample_stat_reset(&dump_stat);
+    CLG_(init_cost_lz)( CLG_(sets).full, &window_end );
+    sample_get_cost(window_end);
+
+    /* drop windows with collection switched off, or with counters zeroed
+     * in between (by zero requests) */
+    ir = window_end[fullOffset(EG_IR)] - window_start[fullOffset(EG_IR)];
+    for(i = 0; i < size; i++)
+	if (window_end[i] < window_start[i]) ir = 0;
+    if (ir == 0 || ir > 2 * clo_sample_detail + 1000) {
+	run_stat.dropped++;
+	dump_stat.dropped++;
+	return;
+    }
+
+    for(i = 0; i < size; i++) {
+	double r;
+	if (!sample_event(i)) continue;
+	r = (double)(window_end[i] - window_start[i]) / (double)ir;
+	run_stat.rate_sum[i]    += r;
+	run_stat.rate_sqsum[i]  += r * r;
+	dump_stat.rate_sum[i]   += r;
+	dump_stat.rate_sqsum[i] += r * r;
+    }
+    run_stat.windows++;
+    dump_stat.windows++;
+}
+
+/* Called from setup_bbcc if the current phase is finished */
+void CLG_(sample_next_phase)(void)
+{
+    switch(CLG_(sample_phase)) {
+    case SAMPLE_FASTFWD:
+	if (clo_sample_warmup > 0) {
+	    CLG_(sample_phase) = SAMPLE_WARMUP;
+	    phase_len = clo_sample_warmup;
+	    break;
+	}
+	/* fall through */
+    case SAMPLE_WARMUP:
+	CLG_(init_cost_lz)( CLG_(sets).full, &window_start );
+	sample_get_cost(window_start);
+	CLG_(sample_phase) = SAMPLE_DETAIL;
+	phase_len = clo_sample_detail;
+	break;
+    case SAMPLE_DETAIL:
+	sample_end_window();
+	CLG_(sample_phase) = SAMPLE_FASTFWD;
+	phase_len = clo_sample_period - clo_sample_warmup - clo_sample_detail;
+	break;
+    default:
+	tl_assert(0);
+    }
+    CLG_(sample_left) = phase_len;
+
+    CLG_DEBUG(1, "Sampling: phase %d for %lld instructions\n",
+	      CLG_(sample_phase), phase_len);
+}
+
+/* Start new estimates, after a dump or when costs are zeroed */
+void CLG_(sample_reset_estimates)(void)
+{
+    if (!dump_stat.rate_sum) return;
+
+    sample_stat_reset(&dump_stat);
+}
+
+static double sample_sqrt(double x)
+{
+    double r;
+    Int i;
+
+    if (x <= 0.0) return 0.0;
+    r = (x > 1.0) ? x : 1.0;
+    for(i = 0; i < 100; i++)
+	r = (r + x / r) / 2.0;
+    return r;
+}
+
+/* Extrapolated count of event at full cost offset <o> for <ir>
+ * instructions, and half width of its 95% confidence interval */
+static void sample_estimate(SampleStat* s, Int o, ULong ir,
+			    ULong* est, ULong* conf)
+{
+    double n = (double) s->windows, mean, var;
+
+    *est = *conf = 0;
+    if (s->windows == 0) return;
+
+    mean = s->rate_sum[o] / n;
+    var = (s->windows > 1) ?
+	(s->rate_sqsum[o] - s->rate_sum[o] * mean) / (n - 1.0) : 0.0;
+    *est  = (ULong) (mean * (double)ir + 0.5);
+    *conf = (ULong) (1.96 * sample_sqrt(var / n) * (double)ir + 0.5);
+}
+
+/* Name and full cost offset of estimated event <i>.
+ * Returns False if there is no such event */
+static Bool sample_event_info(Int i, const HChar** name, Int* o)
+{
+    Int g, e;
+
+    for(g = EG_IR; g <= EG_DW; g++) {
+	EventGroup* eg = CLG_(get_event_group)(g);
+	if (!eg) continue;
+	for(e = 0; e < eg->size; e++) {
+	    if (!sample_event(fullOffset(g) + e)) continue;
+	    if (i-- > 0) continue;
+	    *name = eg->name[e];
+	    *o = fullOffset(g) + e;
+	    return True;
+	}
+    }
+    return False;
+}
+
+/* Write line <i> of sampling description into <buf> for the header of
+ * a dump with <ir> instructions. Returns False if there is no such line */
+Bool CLG_(sample_desc)(HChar* buf, Int i, ULong ir)
+{
+    const HChar* name;
+    Int o;
+    ULong est, conf;
+
+    if (!CLG_(sampling)) return False;
+
+    if (i == 0) {
+	VG_(sprintf)(buf, "desc: Sampling: %llu windows of %llu instructions "
+		     "(warm-up %llu) per %llu\n", dump_stat.windows,
+		     clo_sample_detail, clo_sample_warmup, clo_sample_period);
+	return True;
+    }
+
+    /* no estimates without any window */
+    if (dump_stat.windows == 0) return False;
+    if (!sample_event_info(i-1, &name, &o)) return False;
+    sample_estimate(&dump_stat, o, ir, &est, &conf);
+    VG_(sprintf)(buf, "desc: Estimate: %s %llu +- %llu\n", name, est, conf);
+    return True;
+}
+
+static void sample_printstat(void)
+{
+    const HChar* name;
+    Int i, o;
+    ULong est, conf, ir = CLG_(total_cost)[fullOffset(EG_IR)];
+
+    VG_(message)(Vg_UserMsg, "\n");
+    VG_(message)(Vg_UserMsg,
+		 "Sampled:  %llu windows of %llu instructions every %llu "
+		 "(warm-up %llu)\n", run_stat.windows, clo_sample_detail,
+		 clo_sample_period, clo_sample_warmup);
+    if (run_stat.dropped > 0)
+	VG_(message)(Vg_UserMsg,
+		     "Dropped:  %llu windows (collection off or zeroed)\n",
+		     run_stat.dropped);
+
+    for(i = 0; sample_event_info(i, &name, &o); i++) {
+	sample_estimate(&run_stat, o, ir, &est, &conf);
+	VG_(message)(Vg_UserMsg,
+		     "Estimate %s: %llu +- %llu (95%% confidence)\n",
+		     name, est, conf);
+    }
+    VG_(message)(Vg_UserMsg,
+		 "Misses may be overestimated if warm-up does not refill "
+		 "the caches\n");
+}
+
+static void sample_post_clo_init(void)
+{
+    if (clo_sample_period == 0) return;
+
+    if (!CLG_(clo).simulate_cache || clo_collect_cacheuse)
+	VG_(fmsg_bad_option)("--sample-period",
+			     "Sampling needs --cache-sim=yes, "
+			     "and can not be used with --cacheuse=yes\n");
+    if (clo_sample_detail == 0 ||
+	clo_sample_period <= clo_sample_warmup + clo_sample_detail)
+	VG_(fmsg_bad_option)("--sample-period",
+			     "Period has to be larger than the sum of "
+			     "warm-up and detail windows (%llu)\n",
+			     clo_sample_warmup + clo_sample_detail);
+
+    CLG_(sampling) = True;
+    CLG_(sample_phase) = SAMPLE_FASTFWD;
+    phase_len = clo_sample_period - clo_sample_warmup - clo_sample_detail;
+    CLG_(sample_left) = phase_len;
+
+    CLG_(cachesim).warm_1I    = warm_1I;
+    CLG_(cachesim).warm_0I1Dr = warm_0I1Dr;
+    CLG_(cachesim).warm_0I1Dw = warm_0I1Dw;
+}
+
+
 /*------------------------------------------------------------*/
 /*--- Cache configuration                                  ---*/
 /*------------------------------------------------------------*/
@@ -1369,6 +1708,8 @@ static void cachesim_post_clo_init(void)
   CLG_(cachesim).log_0I1Dr_name = "log_0I1Dr";
   CLG_(cachesim).log_0I1Dw_name = "log_0I1Dw";
 
+  sample_post_clo_init();
+
   if (clo_collect_cacheuse) {
 
       /* Output warning for not supported option combinations */
@@ -1452,7 +1793,11 @@ void cachesim_print_opts(void)
 #if CLG_EXPERIMENTAL
 "    --simulate-sectors=no|yes Simulate sectored behaviour [no]\n"
 #endif
-"    --cacheuse=no|yes         Collect cache block use [no]\n");
+"    --cacheuse=no|yes         Collect cache block use [no]\n"
+"    --sample-period=<n>       Simulate only in windows every <n>\n"
+"                              instructions, and extrapolate [0=off]\n"
+"    --sample-warmup=<n>       Warm-up window before each sample [100000]\n"
+"    --sample-detail=<n>       Instructions in each sample [10000]\n");
   VG_(print_cache_clo_opts)();
 }
 
@@ -1474,6 +1819,13 @@ static Bool cachesim_parse_opt(const HChar* arg)
       }
    }
 
+   else if VG_BINT_CLO(arg, "--sample-period", clo_sample_period,
+                       0, 1000000000000LL) {}
+   else if VG_BINT_CLO(arg, "--sample-warmup", clo_sample_warmup,
+                       0, 1000000000000LL) {}
+   else if VG_BINT_CLO(arg, "--sample-detail", clo_sample_detail,
+                       0, 1000000000000LL) {}
+
    else if (VG_(str_clo_cache_opt)(arg,
                                    &clo_I1_cache,
                                    &clo_D1_cache,
@@ -1664,6 +2016,9 @@ void cachesim_printstat(Int l1, Int l2, Int l3)
 	     total[fullOffset(EG_DW)], p, l3+1, buf3);
   VG_(message)(Vg_UserMsg, "LL miss rate:  %s (%s   + %s  )\n",
 	       buf1, buf2,buf3);
+
+  if (CLG_(sampling))
+    sample_printstat();
 }
 
 
@@ -1673,8 +2028,15 @@ void cachesim_printstat(Int l1, Int l2, Int l3)
 
 struct event_sets CLG_(sets);
 
+/* Event names of instruction classes MIX_* */
+const HChar* CLG_(mix_events)[MIX_EVENTS] = {
+    "Ld", "St", "Alu", "Fp", "Simd", "Div", "Atom", "Br"
+};
+
 void CLG_(init_eventsets)()
 {
+    Int i;
+
     // Event groups from which the event sets are composed
     // the "Use" group only is used with "cacheuse" simulation
     if (clo_collect_cacheuse)
@@ -1702,6 +2064,12 @@ void CLG_(init_eventsets)()
     if (CLG_(clo).collect_bus)
 	CLG_(register_event_group)(EG_BUS, "Ge");
 
+    if (CLG_(clo).collect_mix)
+	CLG_(register_event_groupN)(EG_MIX, MIX_EVENTS, CLG_(mix_events));
+
+    if (CLG_(clo).cost_model)
+	CLG_(register_event_group)(EG_CYC, "Cy");
+
     if (CLG_(clo).collect_alloc)
 	CLG_(register_event_group2)(EG_ALLOC, "allocCount", "allocSize");
 
@@ -1716,6 +2084,7 @@ void CLG_(init_eventsets)()
     CLG_(sets).full = CLG_(add_event_group2)(CLG_(sets).full, EG_BC, EG_BI);
     CLG_(sets).full = CLG_(add_event_group) (CLG_(sets).full, EG_BUS);
     CLG_(sets).full = CLG_(add_event_group2)(CLG_(sets).full, EG_ALLOC, EG_SYS);
+    CLG_(sets).full = CLG_(add_event_group2)(CLG_(sets).full, EG_MIX, EG_CYC);
 
     CLG_DEBUGIF(1) {
 	CLG_DEBUG(1, "EventSets:\n");
@@ -1726,6 +2095,7 @@ void CLG_(init_eventsets)()
     /* Not-existing events are silently ignored */
     CLG_(dumpmap) = CLG_(get_eventmapping)(CLG_(sets).full);
     CLG_(append_event)(CLG_(dumpmap), "Ir");
+    CLG_(append_event)(CLG_(dumpmap), "Cy");
     CLG_(append_event)(CLG_(dumpmap), "Dr");
     CLG_(append_event)(CLG_(dumpmap), "Dw");
     CLG_(append_event)(CLG_(dumpmap), "I1mr");
@@ -1750,6 +2120,8 @@ void CLG_(init_eventsets)()
     CLG_(append_event)(CLG_(dumpmap), "allocSize");
     CLG_(append_event)(CLG_(dumpmap), "sysCount");
     CLG_(append_event)(CLG_(dumpmap), "sysTime");
+    for(i = 0; i < MIX_EVENTS; i++)
+	CLG_(append_event)(CLG_(dumpmap), CLG_(mix_events)[i]);
 }
 
 
@@ -1759,6 +2131,18 @@ static void cachesim_add_icost(SimCost cost, BBCC* bbcc,
 {
     if (!CLG_(clo).simulate_cache)
 	cost[ fullOffset(EG_IR) ] += exe_count;
+    else if (CLG_(sampling)) {
+	/* simulator calls only counted Ir in detail windows */
+	cost[ fullOffset(EG_IR) ] += exe_count;
+	if (ii->eventset)
+	    bbcc->cost[ ii->cost_offset + ii->eventset->offset[EG_IR] ] = 0;
+    }
+
+    if (CLG_(clo).collect_mix)
+	cost[ fullOffset(EG_MIX) + ii->mix ] += exe_count;
+
+    if (CLG_(clo).cost_model)
+	cost[ fullOffset(EG_CYC) ] += exe_count * ii->weight;
 
     if (ii->eventset)
 	CLG_(add_and_zero_cost2)( CLG_(sets).full, cost,
@@ -1806,6 +2190,11 @@ struct cachesim_if CLG_(cachesim) = {
 
   .log_0I1Dr_name = "(no function)",
   .log_0I1Dw_name = "(no function)",
+
+  /* set with --sample-period */
+  .warm_1I    = 0,
+  .warm_0I1Dr = 0,
+  .warm_0I1Dw = 0,
 };
 
 
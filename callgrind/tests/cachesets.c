@@ -0,0 +1,78 @@
+// Walk cache lines which all map to the same cache set, with as many
+// lines as the set has ways and with one more. With LRU replacement,
+// the first walk only misses at the start, the second misses on every
+// access. Each walk is dumped separately. Used with an 8-way D1 and a
+// 16-way LL, whose set lookup is specialized in the simulator.
+
+#include <stdio.h>
+#include "../callgrind.h"
+
+#define LINE   64
+#define ROUNDS 100
+
+// D1 32768,8,64 and LL 1048576,16,64
+#define D1_SETS  64
+#define LL_SETS  1024
+
+static char buf[18 * LL_SETS * LINE];
+
+static unsigned long set_of(unsigned long a, unsigned long sets)
+{
+   return (a / LINE) % sets;
+}
+
+// Returns the first line of a walk in a cache with <sets> sets, in a
+// set away from the sets of the stack frame and of the code
+static char* walk_start(unsigned long sets)
+{
+   unsigned long frame = set_of((unsigned long)&sets, sets);
+   unsigned long code = set_of((unsigned long)walk_start, sets);
+   unsigned long set = (frame + sets/2 + 16) % sets;
+   unsigned long a;
+
+   if ((set + sets - code) % sets < 16 || (code + sets - set) % sets < 16)
+      set = (set + sets/4) % sets;
+
+   a = (unsigned long)buf + sets * LINE;
+   a -= a % (sets * LINE);
+   return (char*)(a + set * LINE);
+}
+
+static int walk(char* p, int lines, unsigned long stride, int write)
+{
+   int r, i, sum = 0;
+
+   for(r = 0; r < ROUNDS; r++)
+      for(i = 0; i < lines; i++) {
+	 if (write) p[i * stride] = r;
+	 else sum += p[i * stride];
+      }
+   return sum;
+}
+
+static int dumped_walk(const char* name, unsigned long sets, int lines,
+		       int write)
+{
+   char* p = walk_start(sets);
+   int sum;
+
+   CALLGRIND_ZERO_STATS;
+   sum = walk(p, lines, sets * LINE, write);
+   CALLGRIND_DUMP_STATS_AT(name);
+   return sum;
+}
+
+int main(void)
+{
+   int sum = 0;
+
+   sum += dumped_walk("D1-8-read", D1_SETS, 8, 0);
+   sum += dumped_walk("D1-9-read", D1_SETS, 9, 0);
+   sum += dumped_walk("LL-16-read", LL_SETS, 16, 0);
+   sum += dumped_walk("LL-17-read", LL_SETS, 17, 0);
+   sum += dumped_walk("LL-16-write", LL_SETS, 16, 1);
+   sum += dumped_walk("LL-17-write", LL_SETS, 17, 1);
+
+   printf("Sum: %d\n", sum);
+   return 0;
+}
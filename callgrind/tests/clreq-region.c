@@ -0,0 +1,47 @@
+// Check reading back counters and named regions with client requests.
+
+#include <stdio.h>
+#include "../callgrind.h"
+
+int some_work(int sum)
+{
+   int i;
+
+   for(i=0;i<100;i++) sum += i; /* some dummy work */
+
+   return sum;
+}
+
+int main(void)
+{
+   unsigned long long before[8], after[8], region[8];
+   char names[256];
+   int n, i, sum = 0;
+
+   n = CALLGRIND_GET_EVENT_NAMES(names, sizeof(names));
+   printf("events: %d (%s)\n", n, names);
+
+   CALLGRIND_GET_COUNTERS(before, 8);
+   sum += some_work(sum);
+   CALLGRIND_GET_COUNTERS(after, 8);
+   printf("Ir increased: %s\n", after[0] > before[0] ? "yes":"no");
+
+   printf("unknown region: %d\n",
+          CALLGRIND_GET_REGION_COUNTERS("loop", region, 8));
+
+   for(i=0;i<3;i++) {
+      CALLGRIND_REGION_BEGIN("loop");
+      sum += some_work(sum);
+      CALLGRIND_REGION_BEGIN("inner");
+      sum += some_work(sum);
+      CALLGRIND_REGION_END("inner");
+      CALLGRIND_REGION_END("loop");
+   }
+
+   n = CALLGRIND_GET_REGION_COUNTERS("loop", region, 8);
+   printf("region events: %d\n", n);
+   CALLGRIND_GET_REGION_COUNTERS("inner", before, 8);
+   printf("inner within loop: %s\n", before[0] < region[0] ? "yes":"no");
+
+   return sum == 0;
+}
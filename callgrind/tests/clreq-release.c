@@ -0,0 +1,28 @@
+// Check --release-at-instr-off: switching instrumentation off dumps
+// the costs collected so far and frees all cost centers. Costs of the
+// next phase have to start from zero.
+
+#include "../callgrind.h"
+
+static int work(int n)
+{
+   int i, sum = 0;
+
+   for(i = 0; i < n; i++) sum += i % 7;
+   return sum;
+}
+
+int main(void)
+{
+   int sum = work(100000);
+
+   CALLGRIND_STOP_INSTRUMENTATION;
+   sum += work(100000);
+   CALLGRIND_START_INSTRUMENTATION;
+
+   sum += work(1000);
+   CALLGRIND_DUMP_STATS_AT("after-release");
+   sum += work(1000);
+
+   return sum == 0;
+}
@@ -0,0 +1,23 @@
+// For check_deterministic: put addresses of the client's initial state
+// into the profile data, as reason of a dump. The address of an
+// environment variable depends on the order of the environment, and
+// address space randomisation is reported, as Valgrind has to switch
+// it off with --deterministic=yes.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/personality.h>
+#include "../callgrind.h"
+
+int main(void)
+{
+   char reason[256];
+   int local = 0;
+   int pers = personality(0xffffffff);
+
+   snprintf(reason, sizeof(reason), "env=%p stack=%p aslr=%s",
+	    (void*)getenv("CLG_DET_A"), (void*)&local,
+	    (pers != -1 && (pers & ADDR_NO_RANDOMIZE)) ? "off" : "on");
+   CALLGRIND_DUMP_STATS_AT(reason);
+   return local;
+}
@@ -0,0 +1,75 @@
+// Check that the live statistics page published with --live-stats=yes
+// is updated while the program runs, by reading the own page.
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static char page[65536];
+
+// Returns the value of counter <name>, or -1 if not found
+static long long live_counter(const char* name)
+{
+   char file[256], *p, *fields, *offsets;
+   const char* tmpdir = getenv("TMPDIR");
+   long long value;
+   int fd, len, slots, i;
+
+   if (!tmpdir) tmpdir = "/tmp";
+   snprintf(file, sizeof(file), "%s/callgrind-live.%d", tmpdir, getpid());
+   fd = open(file, O_RDONLY);
+   if (fd < 0) return -1;
+   len = read(fd, page, sizeof(page) - 1);
+   close(fd);
+   if (len <= 0) return -1;
+   page[len] = 0;
+
+   if (strncmp(page, "callgrind-live: 1\n", 18) != 0) return -1;
+   offsets = strstr(page, "\noffsets: ");
+   fields = strstr(page, "\nfields:");
+   if (!offsets || !fields) return -1;
+   slots = atoi(offsets + 10);
+
+   p = fields + 8;
+   for(i = 0; *p && *p != '\n'; i++) {
+      while(*p == ' ') p++;
+      if (strncmp(p, name, strlen(name)) == 0 &&
+	  (p[strlen(name)] == ' ' || p[strlen(name)] == '\n')) {
+	 if (slots + (i+1) * (int)sizeof(value) > len) return -1;
+	 memcpy(&value, page + slots + i * sizeof(value), sizeof(value));
+	 return value;
+      }
+      while(*p && *p != ' ' && *p != '\n') p++;
+   }
+   return -1;
+}
+
+static double work(int n)
+{
+   double sum = 0.0;
+   int i;
+
+   for(i = 0; i < n; i++) sum += (double)(i % 7);
+   return sum;
+}
+
+int main(void)
+{
+   long long before, after;
+   double sum;
+
+   before = live_counter("total-ir");
+   sum = work(1000000);
+   after = live_counter("total-ir");
+
+   if (before < 0 || after < 0)
+      printf("no live statistics\n");
+   else if (after > before)
+      printf("total-ir moves\n");
+   else
+      printf("total-ir does not move: %lld -> %lld\n", before, after);
+
+   return sum < 0.0;
+}
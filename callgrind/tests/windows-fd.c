@@ -0,0 +1,60 @@
+// Collection window closed via duplicated fds: the window stays open
+// until the last fd referring to the closefile is closed. Also opens
+// paths which callgrind must not read beyond the readable client
+// memory: an invalid pointer, and a path not terminated before an
+// inaccessible page.
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "../callgrind.h"
+
+static int work(int n)
+{
+   int i, sum = 0;
+
+   for(i = 0; i < n; i++) sum += i % 7;
+   return sum;
+}
+
+int main(void)
+{
+   long pagesize = sysconf(_SC_PAGESIZE);
+   const char* in = "windows-fd.in";
+   char *pages, *path;
+   int fd, fd2, sum = 0;
+
+   pages = mmap(0, 2 * pagesize, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+   if (pages == MAP_FAILED) return 1;
+   mprotect(pages + pagesize, pagesize, PROT_NONE);
+
+   // openfile name unterminated up to the inaccessible page, and
+   // invalid path
+   memcpy(pages + pagesize - strlen(in), in, strlen(in));
+   close(open(pages + pagesize - strlen(in), O_RDONLY));
+   close(open((const char*)1, O_RDONLY));
+
+   // openfile terminated at the end of the accessible page
+   path = pages + pagesize - strlen(in) - 1;
+   strcpy(path, in);
+
+   CALLGRIND_ZERO_STATS;
+   close(open(path, O_RDONLY));
+   fd = open("windows-fd.out", O_WRONLY | O_CREAT | O_TRUNC, 0600);
+   fd2 = fcntl(fd, F_DUPFD, 10);
+   dup2(fd, 20);
+   close(fd);
+   sum += work(100000);
+   CALLGRIND_DUMP_STATS_AT("dup-dup2-open");
+   close(20);
+   sum += work(100000);
+   CALLGRIND_DUMP_STATS_AT("dup-open");
+   close(fd2);
+   sum += work(100000);
+   CALLGRIND_DUMP_STATS_AT("closed");
+
+   unlink("windows-fd.out");
+   return sum == 0;
+}
@@ -0,0 +1,43 @@
+// Collection windows (--collect-window): window "a" is opened once and
+// window "b" twice, by opening their openfiles, and closed by closing
+// their closefiles. The cost of each activation is dumped separately,
+// to compare it with the Ir counter of the window and with a full run.
+
+#include <fcntl.h>
+#include <unistd.h>
+#include "../callgrind.h"
+
+static int work(int n)
+{
+   int i, sum = 0;
+
+   for(i = 0; i < n; i++) sum += i % 7;
+   return sum;
+}
+
+static int window(const char* in, const char* out, const char* name, int n)
+{
+   int fd, sum;
+
+   CALLGRIND_ZERO_STATS;
+   close(open(in, O_RDONLY));
+   fd = open(out, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+   sum = work(n);
+   close(fd);
+   CALLGRIND_DUMP_STATS_AT(name);
+   return sum;
+}
+
+int main(void)
+{
+   int sum = work(10000);
+
+   sum += window("windows.a.in", "windows.a.out", "a", 100000);
+   sum += window("windows.b.in", "windows.b.out", "b", 200000);
+   sum += window("windows.b.in", "windows.b.out", "b", 200000);
+   sum += work(10000);
+
+   unlink("windows.a.out");
+   unlink("windows.b.out");
+   return sum == 0;
+}
@@ -113,6 +113,7 @@ thread_info* new_thread(void)
     t->lastdump_cost   = CLG_(get_eventset_cost)( CLG_(sets).full );
     t->sighandler_cost = CLG_(get_eventset_cost)( CLG_(sets).full );
     CLG_(init_cost)( CLG_(sets).full, t->lastdump_cost );
+    t->lastdump_part = 0;
     CLG_(init_cost)( CLG_(sets).full, t->sighandler_cost );
 
     /* init data containers */
@@ -175,6 +176,27 @@ void CLG_(switch_thread)(ThreadId tid)
 }
 
 
+static void release_thread_ccs(thread_info* t)
+{
+  /* If we cumulate costs of threads, all use BBCCs/JCCs of TID 1 */
+  if (!CLG_(clo).separate_threads && (t != thread[1])) return;
+
+  CLG_(release_current_bbccs)();
+  CLG_(release_current_jccs)();
+}
+
+/* Free all BBCCs and JCCs of all threads.
+ * Their costs must be dumped before, and no call stack may refer
+ * to them any longer.
+ */
+void CLG_(release_cost_centers)()
+{
+  CLG_(forget_bbccs)();
+  CLG_(forall_threads)(release_thread_ccs);
+  CLG_(stat).cc_releases++;
+  CLG_(stat).clone_memory = 0;
+}
+
 void CLG_(run_thread)(ThreadId tid)
 {
     /* check for dumps needed */
@@ -191,6 +213,10 @@ void CLG_(run_thread)(ThreadId tid)
 
     /* now check for thread switch */
     CLG_(switch_thread)(tid);
+
+    /* also with --count-only, where BBs are not counted */
+    if (CLG_(clo).live_stats)
+	CLG_(update_live_stats)();
 }
 
 void CLG_(pre_signal)(ThreadId tid, Int sigNum, Bool alt_stack)
@@ -314,6 +340,7 @@ void CLG_(init_exec_state)(exec_state* es)
   es->collect = CLG_(clo).collect_atstart;
   es->cxt  = 0;
   es->jmps_passed = 0;
+  es->ir_passed = 0;
   es->bbcc = 0;
   es->nonskipped = 0;
 }
@@ -366,6 +393,48 @@ void CLG_(set_current_exec_stack)(exec_stack* dst)
 }
 
 
+/* Ir counter of thread <t>, including running signal handlers
+ * and finished ones */
+ULong CLG_(get_thread_ir)(ThreadId t)
+{
+  Int i;
+  ULong ir;
+  exec_stack* es;
+
+  if (!thread[t]) return 0;
+  es = (t == CLG_(current_tid)) ? &current_states : &(thread[t]->states);
+  ir = thread[t]->sighandler_cost[ fullOffset(EG_IR) ];
+  for(i=0;i<=es->sp;i++)
+    ir += es->entry[i]->cost[ fullOffset(EG_IR) ];
+  return ir;
+}
+
+/* Add counters of thread <t> to <sum>, see CLG_(get_thread_ir) */
+void CLG_(add_thread_cost)(ThreadId t, FullCost sum)
+{
+  Int i;
+  exec_stack* es;
+
+  if (!thread[t]) return;
+  es = (t == CLG_(current_tid)) ? &current_states : &(thread[t]->states);
+  CLG_(add_cost)( CLG_(sets).full, sum, thread[t]->sighandler_cost );
+  for(i=0;i<=es->sp;i++)
+    CLG_(add_cost)( CLG_(sets).full, sum, es->entry[i]->cost );
+}
+
+/* Sum of Ir counters of all threads.
+ * Used as time base for collection windows. */
+ULong CLG_(get_total_ir)(void)
+{
+  Int t;
+  ULong ir = 0;
+
+  for(t=1;t<VG_N_THREADS;t++)
+    ir += CLG_(get_thread_ir)(t);
+  return ir;
+}
+
+
 /* Get top context info struct of current thread */
 static
 exec_state* top_exec_state(void)
@@ -413,6 +482,7 @@ exec_state* exec_state_save(void)
   es->cxt         = CLG_(current_state).cxt;
   es->collect     = CLG_(current_state).collect;
   es->jmps_passed = CLG_(current_state).jmps_passed;
+  es->ir_passed   = CLG_(current_state).ir_passed;
   es->bbcc        = CLG_(current_state).bbcc;
   es->nonskipped  = CLG_(current_state).nonskipped;
   CLG_ASSERT(es->cost == CLG_(current_state).cost);
@@ -438,6 +508,7 @@ exec_state* exec_state_restore(void)
   CLG_(current_state).cxt     = es->cxt;
   CLG_(current_state).collect = es->collect;
   CLG_(current_state).jmps_passed = es->jmps_passed;
+  CLG_(current_state).ir_passed = es->ir_passed;
   CLG_(current_state).bbcc    = es->bbcc;
   CLG_(current_state).nonskipped = es->nonskipped;
   CLG_(current_state).cost    = es->cost;
@@ -217,6 +217,13 @@ static void free_DebugInfo ( DebugInfo* di )
    if (di->cfsi_exprs)   VG_(deleteXA)(di->cfsi_exprs);
    if (di->fpo)          ML_(dinfo_free)(di->fpo);
 
+   if (di->deferred_files) {
+      for (i = 0; i < N_DEFER_FILES; i++)
+         if (di->deferred_files->path[i])
+            ML_(dinfo_free)(di->deferred_files->path[i]);
+      ML_(dinfo_free)(di->deferred_files);
+   }
+
    if (di->symtab) {
       /* We have to visit all the entries so as to free up any
          sec_names arrays that might exist. */
@@ -1386,6 +1393,18 @@ static void search_all_symtabs ( Addr ptr, /*OUT*/DebugInfo** pdi,
 }
 
 
+/* Read the line number info of |di| if this was deferred at load
+   time, and prepare it for use. */
+static void read_deferred_lines ( DebugInfo* di )
+{
+   vg_assert(di->lines_deferred && di->have_dinfo);
+#  if defined(VGO_linux)
+   ML_(read_elf_deferred_lines)( di );
+#  endif
+   di->lines_deferred = False;
+   ML_(canonicaliseLoctab)( di );
+}
+
 /* Search all loctabs that we know about to locate ptr.  If found, set
    *pdi to the relevant DebugInfo, and *locno to the loctab entry
    *number within that.  If not found, *pdi is set to NULL. */
@@ -1399,6 +1418,8 @@ static void search_all_loctabs ( Addr ptr, /*OUT*/DebugInfo** pdi,
           && di->text_size > 0
           && di->text_avma <= ptr 
           && ptr < di->text_avma + di->text_size) {
+         if (di->lines_deferred && di->have_dinfo)
+            read_deferred_lines( di );
          lno = ML_(search_one_loctab) ( di, ptr );
          if (lno == -1) goto not_found;
          *locno = lno;
@@ -2145,6 +2166,20 @@ UWord evalCfiExpr ( XArray* exprs, Int ix,
 }
 
 
+/* Read the CFI of |di| if this was deferred at load time, and
+   prepare it for use. */
+static void read_deferred_cfi ( DebugInfo* di )
+{
+   vg_assert(di->cfi_deferred && di->have_dinfo);
+#  if defined(VGO_linux)
+   ML_(read_elf_deferred_cfi)( di );
+#  endif
+   di->cfi_deferred = False;
+   ML_(canonicaliseCFI)( di );
+   check_CFSI_related_invariants( di );
+   cfsi_cache__invalidate();
+}
+
 /* Search all the DebugInfos in the entire system, to find the DiCfSI
    that pertains to 'ip'. 
 
@@ -2171,6 +2206,11 @@ static void find_DiCfSI ( /*OUT*/DebugInfo** diP,
       Word j;
       n_steps++;
 
+      /* CFI not read yet: all of it is inside the rx mappings */
+      if (di->cfi_deferred && di->have_dinfo
+          && ML_(find_rx_mapping)(di, ip, ip) != NULL)
+         read_deferred_cfi( di );
+
       /* Use the per-DebugInfo summary address ranges to skip
          inapplicable DebugInfos quickly. */
       if (di->cfsi_used == 0)
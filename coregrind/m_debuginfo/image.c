@@ -67,8 +67,8 @@ typedef
       Bool  is_local;
       // The fd for the local file, or sd for a remote server.
       Int   fd;
-      // The name.  In ML_(dinfo_zalloc)'d space.  Used only for printing
-      // error messages; hence it doesn't really matter what this contains.
+      // The name.  In ML_(dinfo_zalloc)'d space.  Used for printing
+      // error messages, and for local files, to open them again.
       HChar* name;
       // The rest of these fields are only valid when using remote files
       // (that is, using a debuginfo server; hence when is_local==False)
@@ -772,6 +772,12 @@ DiOffT ML_(img_size)(DiImage* img)
    return img->size;
 }
 
+const HChar* ML_(img_local_path)(DiImage* img)
+{
+   vg_assert(img);
+   return img->source.is_local ? img->source.name : NULL;
+}
+
 inline Bool ML_(img_valid)(DiImage* img, DiOffT offset, SizeT size)
 {
    vg_assert(img);
@@ -77,6 +77,10 @@ void ML_(img_done)(DiImage*);
 /* How big is the image? */
 DiOffT ML_(img_size)(DiImage* img);
 
+/* Path of the local file the image was created from, or NULL if it
+   comes from a debuginfo server. */
+const HChar* ML_(img_local_path)(DiImage* img);
+
 /* Does the section [offset, +size) exist in the image? */
 Bool ML_(img_valid)(DiImage* img, DiOffT offset, SizeT size);
 
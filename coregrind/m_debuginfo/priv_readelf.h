@@ -53,6 +53,13 @@ extern Bool ML_(is_elf_object_file)( void* image, SizeT n_image, Bool rel_ok );
 */
 extern Bool ML_(read_elf_debug_info) ( DebugInfo* di );
 
+/* Read the call frame info whose reading was deferred by
+   ML_(read_elf_debug_info) (--defer-debuginfo=yes). */
+extern void ML_(read_elf_deferred_cfi) ( DebugInfo* di );
+
+/* Ditto for line number info. */
+extern void ML_(read_elf_deferred_lines) ( DebugInfo* di );
+
 
 #endif /* ndef __PRIV_READELF_H */
 
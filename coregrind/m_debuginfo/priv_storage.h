@@ -489,6 +489,34 @@ struct _DebugInfoFSM
 #define N_EHFRAME_SECTS 2
 
 
+/* With --defer-debuginfo=yes, some debug info sections are not read
+   when the object is mapped, but only when their information is first
+   needed.  The object files are then opened again: these record
+   where to find them, and the size and mtime they had when the
+   object was mapped, to detect a file which was replaced meanwhile. */
+#define DEFER_MAIN     0   /* the main ELF file */
+#define DEFER_DEBUG    1   /* separate debuginfo file */
+#define DEFER_ALT      2   /* alternate debuginfo file */
+#define N_DEFER_FILES  3
+
+typedef
+   struct {
+      HChar* path[N_DEFER_FILES];  /* NULL if not present */
+      Long   size[N_DEFER_FILES];
+      ULong  mtime[N_DEFER_FILES];
+   }
+   DeferredFiles;
+
+/* A DiSlice, but with the image given as DEFER_* index */
+typedef
+   struct {
+      Int    file;  /* -1 if invalid */
+      DiOffT ioff;
+      DiOffT szB;
+   }
+   DeferredSlice;
+
+
 /* So, the main structure for holding debug info for one object. */
 
 struct _DebugInfo {
@@ -823,6 +851,22 @@ struct _DebugInfo {
       This helps performance a lot during ML_(addLineInfo) etc., which can
       easily be invoked hundreds of thousands of times. */
    struct _DebugInfoMapping* last_rx_map;
+
+   /* Deferred reading (--defer-debuginfo=yes).  deferred_files is
+      NULL if nothing was deferred.  If cfi_deferred, the call frame
+      info still has to be read from the given sections; ditto for
+      line number info and lines_deferred. */
+   DeferredFiles* deferred_files;
+   Bool           cfi_deferred;
+   DeferredSlice  ehframe_dsli[N_EHFRAME_SECTS];
+   DeferredSlice  debug_frame_dsli;
+   Bool           lines_deferred;
+   DeferredSlice  debug_info_dsli;
+   DeferredSlice  debug_types_dsli;
+   DeferredSlice  debug_abbv_dsli;
+   DeferredSlice  debug_line_dsli;
+   DeferredSlice  debug_str_dsli;
+   DeferredSlice  debug_str_alt_dsli;
 };
 
 /* --------------------- functions --------------------- */
@@ -876,6 +920,9 @@ extern void ML_(canonicaliseTables) ( struct _DebugInfo* di );
    called on it's own to sort just this table. */
 extern void ML_(canonicaliseCFI) ( struct _DebugInfo* di );
 
+/* Ditto for the location table. */
+extern void ML_(canonicaliseLoctab) ( struct _DebugInfo* di );
+
 /* ------ Searching ------ */
 
 /* Find a symbol-table index containing the specified pointer, or -1
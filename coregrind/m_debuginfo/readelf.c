@@ -37,6 +37,7 @@
 #include "pub_core_libcbase.h"
 #include "pub_core_libcprint.h"
 #include "pub_core_libcassert.h"
+#include "pub_core_libcfile.h"     /* VG_(stat) */
 #include "pub_core_machine.h"      /* VG_ELF_CLASS */
 #include "pub_core_options.h"
 #include "pub_core_oset.h"
@@ -1357,6 +1358,192 @@ Word file_offset_from_svma ( /*OUT*/Bool* ok,
 }
 
 
+/* ------ Deferred reading (--defer-debuginfo=yes) ------ */
+
+/* Record the files behind |mimg|, |dimg| and |aimg| (any of which
+   may be NULL) in di->deferred_files, so that sections can be read
+   from them later on.  Returns False if that is not possible, which
+   is the case for images from a debuginfo server. */
+static Bool defer_files ( struct _DebugInfo* di,
+                          DiImage* mimg, DiImage* dimg, DiImage* aimg )
+{
+   DiImage*       imgs[N_DEFER_FILES];
+   DeferredFiles* df;
+   struct vg_stat st;
+   SysRes         sr;
+   Int            k;
+
+   if (di->deferred_files)
+      return True;
+
+   imgs[DEFER_MAIN]  = mimg;
+   imgs[DEFER_DEBUG] = dimg;
+   imgs[DEFER_ALT]   = aimg;
+
+   for (k = 0; k < N_DEFER_FILES; k++) {
+      if (imgs[k] && !ML_(img_local_path)(imgs[k]))
+         return False;
+   }
+
+   df = ML_(dinfo_zalloc)("di.redi.df.1", sizeof(DeferredFiles));
+   for (k = 0; k < N_DEFER_FILES; k++) {
+      if (!imgs[k])
+         continue;
+      sr = VG_(stat)(ML_(img_local_path)(imgs[k]), &st);
+      if (sr_isError(sr) || st.size != (Long)ML_(img_size)(imgs[k]))
+         break;
+      df->path[k]  = ML_(dinfo_strdup)("di.redi.df.2",
+                                       ML_(img_local_path)(imgs[k]));
+      df->size[k]  = st.size;
+      df->mtime[k] = st.mtime;
+   }
+   if (k < N_DEFER_FILES) {
+      for (k = 0; k < N_DEFER_FILES; k++)
+         if (df->path[k]) ML_(dinfo_free)(df->path[k]);
+      ML_(dinfo_free)(df);
+      return False;
+   }
+
+   di->deferred_files = df;
+   return True;
+}
+
+static DeferredSlice defer_slice ( DiSlice sli,
+                                   DiImage* mimg, DiImage* dimg,
+                                   DiImage* aimg )
+{
+   DeferredSlice dsli;
+
+   dsli.file = -1;
+   dsli.ioff = sli.ioff;
+   dsli.szB  = sli.szB;
+   if (!ML_(sli_is_valid)(sli))
+      return dsli;
+
+   if (sli.img == mimg)      dsli.file = DEFER_MAIN;
+   else if (sli.img == dimg) dsli.file = DEFER_DEBUG;
+   else if (sli.img == aimg) dsli.file = DEFER_ALT;
+   vg_assert(dsli.file >= 0);
+   return dsli;
+}
+
+/* Open again the deferred files which |dslis| refer to, into |imgs|.
+   Returns False if a file cannot be opened, or was changed after the
+   object was mapped. */
+static Bool reopen_deferred_files ( struct _DebugInfo* di,
+                                    /*OUT*/DiImage* imgs[N_DEFER_FILES],
+                                    DeferredSlice* dslis, Int n_dslis )
+{
+   DeferredFiles* df = di->deferred_files;
+   struct vg_stat st;
+   SysRes         sr;
+   Int            i, k;
+
+   vg_assert(df);
+   for (k = 0; k < N_DEFER_FILES; k++)
+      imgs[k] = NULL;
+
+   for (i = 0; i < n_dslis; i++) {
+      k = dslis[i].file;
+      if (k < 0 || imgs[k])
+         continue;
+      vg_assert(k < N_DEFER_FILES && df->path[k]);
+      sr = VG_(stat)(df->path[k], &st);
+      if (!sr_isError(sr)
+          && st.size == df->size[k] && st.mtime == df->mtime[k])
+         imgs[k] = ML_(img_from_local_file)(df->path[k]);
+      if (!imgs[k] || ML_(img_size)(imgs[k]) != df->size[k]) {
+         ML_(symerr)(di, True, "object file changed since it was mapped;"
+                               " ignoring its deferred debug info");
+         for (k = 0; k < N_DEFER_FILES; k++)
+            if (imgs[k]) ML_(img_done)(imgs[k]);
+         return False;
+      }
+   }
+   return True;
+}
+
+static DiSlice undefer_slice ( DeferredSlice dsli,
+                               DiImage* imgs[N_DEFER_FILES] )
+{
+   if (dsli.file < 0)
+      return DiSlice_INVALID;
+   vg_assert(imgs[dsli.file]);
+   return mk_DiSlice(imgs[dsli.file], dsli.ioff, dsli.szB);
+}
+
+void ML_(read_elf_deferred_cfi) ( struct _DebugInfo* di )
+{
+   DeferredSlice dslis[N_EHFRAME_SECTS + 1];
+   DiImage*      imgs[N_DEFER_FILES];
+   Word          i;
+
+   vg_assert(di->cfi_deferred);
+   di->cfi_deferred = False;
+
+   TRACE_SYMTAB("\n------ Reading deferred CFI of %s ------\n",
+                di->fsm.filename);
+
+   for (i = 0; i < di->n_ehframe; i++)
+      dslis[i] = di->ehframe_dsli[i];
+   dslis[di->n_ehframe] = di->debug_frame_dsli;
+   if (!reopen_deferred_files(di, imgs, dslis, di->n_ehframe + 1))
+      return;
+
+   for (i = 0; i < di->n_ehframe; i++) {
+      ML_(read_callframe_info_dwarf3)( di,
+                                       undefer_slice(di->ehframe_dsli[i],
+                                                     imgs),
+                                       di->ehframe_avma[i],
+                                       True/*is_ehframe*/ );
+   }
+   if (di->debug_frame_dsli.file >= 0) {
+      ML_(read_callframe_info_dwarf3)( di,
+                                       undefer_slice(di->debug_frame_dsli,
+                                                     imgs),
+                                       0/*assume zero avma*/,
+                                       False/*!is_ehframe*/ );
+   }
+
+   for (i = 0; i < N_DEFER_FILES; i++)
+      if (imgs[i]) ML_(img_done)(imgs[i]);
+}
+
+
+void ML_(read_elf_deferred_lines) ( struct _DebugInfo* di )
+{
+   DeferredSlice dslis[6];
+   DiImage*      imgs[N_DEFER_FILES];
+   Word          i;
+
+   vg_assert(di->lines_deferred);
+   di->lines_deferred = False;
+
+   TRACE_SYMTAB("\n------ Reading deferred line info of %s ------\n",
+                di->fsm.filename);
+
+   dslis[0] = di->debug_info_dsli;
+   dslis[1] = di->debug_types_dsli;
+   dslis[2] = di->debug_abbv_dsli;
+   dslis[3] = di->debug_line_dsli;
+   dslis[4] = di->debug_str_dsli;
+   dslis[5] = di->debug_str_alt_dsli;
+   if (!reopen_deferred_files(di, imgs, dslis, 6))
+      return;
+
+   ML_(read_debuginfo_dwarf3) ( di,
+                                undefer_slice(di->debug_info_dsli, imgs),
+                                undefer_slice(di->debug_types_dsli, imgs),
+                                undefer_slice(di->debug_abbv_dsli, imgs),
+                                undefer_slice(di->debug_line_dsli, imgs),
+                                undefer_slice(di->debug_str_dsli, imgs),
+                                undefer_slice(di->debug_str_alt_dsli, imgs) );
+
+   for (i = 0; i < N_DEFER_FILES; i++)
+      if (imgs[i]) ML_(img_done)(imgs[i]);
+}
+
+
 /* The central function for reading ELF debug info.  For the
    object/exe specified by the DebugInfo, find ELF sections, then read
    the symbols, line number info, file name info, CFA (stack-unwind
@@ -2751,16 +2938,32 @@ Bool ML_(read_elf_debug_info) ( struct _DebugInfo* di )
             this next assertion should hold. */
          vg_assert(ML_(sli_is_valid)(ehframe_escn[i]));
          vg_assert(ehframe_escn[i].szB == di->ehframe_size[i]);
-         ML_(read_callframe_info_dwarf3)( di,
-                                          ehframe_escn[i],
-                                          di->ehframe_avma[i],
-                                          True/*is_ehframe*/ );
       }
-      if (ML_(sli_is_valid)(debug_frame_escn)) {
-         ML_(read_callframe_info_dwarf3)( di,
-                                          debug_frame_escn,
-                                          0/*assume zero avma*/,
-                                          False/*!is_ehframe*/ );
+      /* Unwind info is only needed for stack traces, which many runs
+         never take.  If possible, read it when first asked for (see
+         ML_(read_elf_deferred_cfi)). */
+      if (VG_(clo_defer_debuginfo)
+          && (di->n_ehframe > 0 || ML_(sli_is_valid)(debug_frame_escn))
+          && defer_files(di, mimg, dimg, aimg)) {
+         for (i = 0; i < di->n_ehframe; i++)
+            di->ehframe_dsli[i] = defer_slice(ehframe_escn[i],
+                                              mimg, dimg, aimg);
+         di->debug_frame_dsli = defer_slice(debug_frame_escn,
+                                            mimg, dimg, aimg);
+         di->cfi_deferred = True;
+      } else {
+         for (i = 0; i < di->n_ehframe; i++) {
+            ML_(read_callframe_info_dwarf3)( di,
+                                             ehframe_escn[i],
+                                             di->ehframe_avma[i],
+                                             True/*is_ehframe*/ );
+         }
+         if (ML_(sli_is_valid)(debug_frame_escn)) {
+            ML_(read_callframe_info_dwarf3)( di,
+                                             debug_frame_escn,
+                                             0/*assume zero avma*/,
+                                             False/*!is_ehframe*/ );
+         }
       }
 
       /* Read the stabs and/or dwarf2 debug information, if any.  It
@@ -2790,20 +2993,44 @@ Bool ML_(read_elf_debug_info) ( struct _DebugInfo* di )
       if (ML_(sli_is_valid)(debug_info_escn) 
           && ML_(sli_is_valid)(debug_abbv_escn)
           && ML_(sli_is_valid)(debug_line_escn)) {
-         /* The old reader: line numbers and unwind info only */
-         ML_(read_debuginfo_dwarf3) ( di,
-                                      debug_info_escn,
-                                      debug_types_escn,
-                                      debug_abbv_escn,
-                                      debug_line_escn,
-                                      debug_str_escn,
-                                      debug_str_alt_escn );
+         Bool need_var_info
+            = VG_(needs).var_info /* the tool requires it */
+              || VG_(clo_read_var_info); /* the user asked for it */
+
+         /* The old reader: line numbers and unwind info only.  Line
+            numbers are only needed for reporting, and often only for
+            a few objects: if possible, read them when first asked for
+            (see ML_(read_elf_deferred_lines)).  Variable info is
+            looked up in too many places to defer it as well. */
+         if (VG_(clo_defer_debuginfo) && !need_var_info
+             && defer_files(di, mimg, dimg, aimg)) {
+            di->debug_info_dsli    = defer_slice(debug_info_escn,
+                                                 mimg, dimg, aimg);
+            di->debug_types_dsli   = defer_slice(debug_types_escn,
+                                                 mimg, dimg, aimg);
+            di->debug_abbv_dsli    = defer_slice(debug_abbv_escn,
+                                                 mimg, dimg, aimg);
+            di->debug_line_dsli    = defer_slice(debug_line_escn,
+                                                 mimg, dimg, aimg);
+            di->debug_str_dsli     = defer_slice(debug_str_escn,
+                                                 mimg, dimg, aimg);
+            di->debug_str_alt_dsli = defer_slice(debug_str_alt_escn,
+                                                 mimg, dimg, aimg);
+            di->lines_deferred = True;
+         } else {
+            ML_(read_debuginfo_dwarf3) ( di,
+                                         debug_info_escn,
+                                         debug_types_escn,
+                                         debug_abbv_escn,
+                                         debug_line_escn,
+                                         debug_str_escn,
+                                         debug_str_alt_escn );
+         }
          /* The new reader: read the DIEs in .debug_info to acquire
             information on variable types and locations.  But only if
             the tool asks for it, or the user requests it on the
             command line. */
-         if (VG_(needs).var_info /* the tool requires it */
-             || VG_(clo_read_var_info) /* the user asked for it */) {
+         if (need_var_info) {
             ML_(new_dwarf3_reader)(
                di, debug_info_escn,     debug_types_escn,
                    debug_abbv_escn,     debug_line_escn,
@@ -1633,7 +1633,7 @@ static Int compare_DiLoc ( const void* va, const void* vb )
    return 0;
 }
 
-static void canonicaliseLoctab ( struct _DebugInfo* di )
+void ML_(canonicaliseLoctab) ( struct _DebugInfo* di )
 {
    Word i, j;
 
@@ -1811,7 +1811,7 @@ void ML_(canonicaliseCFI) ( struct _DebugInfo* di )
 void ML_(canonicaliseTables) ( struct _DebugInfo* di )
 {
    canonicaliseSymtab ( di );
-   canonicaliseLoctab ( di );
+   ML_(canonicaliseLoctab) ( di );
    ML_(canonicaliseCFI) ( di );
    canonicaliseVarInfo ( di );
 }
@@ -376,6 +376,38 @@ struct auxv *find_auxv(UWord* sp)
    return (struct auxv *)sp;
 }
 
+/* For --deterministic=yes: put the environment into a canonical
+   order, so that the client sees the same envp[] layout whatever
+   order the invoking shell used.  Entries are ordered by name only
+   and the sort is stable, so that of several definitions of the same
+   name the one seen by getenv() does not change. */
+static Int env_name_cmp ( const HChar* a, const HChar* b )
+{
+   while (*a && *a != '=' && *a == *b) {
+      a++; b++;
+   }
+   if (*a == '=') return (*b == '=' || *b == 0) ? 0 : -1;
+   if (*b == '=') return *a == 0 ? 0 : 1;
+   return (Int)(UChar)*a - (Int)(UChar)*b;
+}
+
+static void canonicalise_env ( HChar** envp )
+{
+   Int i, j, n;
+   HChar* e;
+
+   if (envp == NULL)
+      return;
+   for (n = 0; envp[n]; n++)
+      ;
+   for (i = 1; i < n; i++) {
+      e = envp[i];
+      for (j = i; j > 0 && env_name_cmp(envp[j-1], e) > 0; j--)
+         envp[j] = envp[j-1];
+      envp[j] = e;
+   }
+}
+
 static 
 Addr setup_client_stack( void*  init_sp,
                          HChar** orig_envp, 
@@ -410,6 +442,9 @@ Addr setup_client_stack( void*  init_sp,
 
    /* ==================== compute sizes ==================== */
 
+   if (VG_(clo_deterministic))
+      canonicalise_env(orig_envp);
+
    /* first of all, work out how big the client stack will be */
    stringsize   = 0;
    have_exename = VG_(args_the_exename) != NULL;
@@ -472,6 +507,12 @@ Addr setup_client_stack( void*  init_sp,
       auxsize +                               /* auxv */
       VG_ROUNDUP(stringsize, sizeof(Word));   /* strings (aligned) */
 
+   /* With --deterministic=yes, the initial SP (and with it the
+      alignment of everything the client later puts on its stack)
+      must not depend on the exact size of args and environment. */
+   if (VG_(clo_deterministic))
+      stacksize = VG_PGROUNDUP(stacksize);
+
    if (0) VG_(printf)("stacksize = %d\n", stacksize);
 
    /* client_SP is the client's stack pointer */
@@ -763,7 +804,13 @@ Addr setup_client_stack( void*  init_sp,
                propagated to the client as glibc will assume it is
                present if it is built for kernel 2.6.29 or later */
             auxv->u.a_ptr = strtab;
-            VG_(memcpy)(strtab, orig_auxv->u.a_ptr, 16);
+            if (VG_(clo_deterministic)) {
+               /* Same "random" bytes in every run: they seed the
+                  stack protector canary and pointer guard of glibc. */
+               for (i = 0; i < 16; i++)
+                  strtab[i] = (HChar)(0x5a ^ i);
+            } else
+               VG_(memcpy)(strtab, orig_auxv->u.a_ptr, 16);
             strtab += 16;
             break;
 
@@ -606,6 +606,29 @@ Int VG_(fork) ( void )
 #  endif
 }
 
+/* Fork a helper process of the tool, which runs no client code and ends
+   with VG_(exit).  No atfork handlers are run.  On Linux, the child is
+   created without an exit signal, so the client never gets a SIGCHLD
+   for it; wait for it using VG_(waitpid) with __VKI_WCLONE. */
+Int VG_(fork_helper) ( void )
+{
+#  if defined(VGO_linux)
+   /* With all arguments zero, the argument order of clone (which varies
+      across architectures) does not matter. */
+   SysRes res;
+   res = VG_(do_syscall5)(__NR_clone, 0, 0, 0, 0, 0);
+   if (sr_isError(res))
+      return -1;
+   return sr_Res(res);
+
+#  elif defined(VGO_darwin)
+   return VG_(fork)();
+
+#  else
+#    error "Unknown OS"
+#  endif
+}
+
 /* ---------------------------------------------------------------------
    Timing stuff
    ------------------------------------------------------------------ */
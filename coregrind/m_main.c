@@ -160,6 +160,9 @@ static void usage_NORETURN ( Bool debug_help )
 "                              than <number> bytes [2000000]\n"
 "    --main-stacksize=<number> set size of main thread's stack (in bytes)\n"
 "                              [min(max(current 'ulimit' value,1MB),16MB)]\n"
+"    --deterministic=no|yes    pin the address space layout and canonicalise\n"
+"                              the client's environment and auxv, so that\n"
+"                              repeated runs execute identical code [no]\n"
 "\n"
 "  user options for Valgrind tools that replace malloc:\n"
 "    --alignment=<number>      set minimum alignment of heap allocations [%s]\n"
@@ -189,6 +192,8 @@ static void usage_NORETURN ( Bool debug_help )
 "                              and use it to print better error messages in\n"
 "                              tools that make use of it (Memcheck, Helgrind,\n"
 "                              DRD) [no]\n"
+"    --defer-debuginfo=yes|no  read unwind and line number info of objects\n"
+"                              only when first needed [no]\n"
 "    --vgdb-poll=<number>      gdbserver poll max every <number> basic blocks [%d] \n"
 "    --vgdb-shadow-registers=no|yes   let gdb see the shadow registers [no]\n"
 "    --vgdb-prefix=<prefix>    prefix for vgdb FIFOs [%s]\n"
@@ -349,6 +354,7 @@ static void usage_NORETURN ( Bool debug_help )
    - get the toolname (--tool=)
    - set VG_(clo_max_stackframe) (--max-stackframe=)
    - set VG_(clo_main_stacksize) (--main-stacksize=)
+   - set VG_(clo_deterministic) (--deterministic=)
    - set VG_(clo_sim_hints) (--sim-hints=)
 
    That's all it does.  The main command line processing is done below
@@ -385,11 +391,13 @@ static void early_process_cmd_line_options ( /*OUT*/Int* need_help,
       // here.
       else if VG_STR_CLO(str, "--tool", *tool) {} 
 
-      // Set up VG_(clo_max_stackframe) and VG_(clo_main_stacksize).
+      // Set up VG_(clo_max_stackframe), VG_(clo_main_stacksize) and
+      // VG_(clo_deterministic).
       // These are needed by VG_(ii_create_image), which happens
       // before main_process_cmd_line_options().
       else if VG_INT_CLO(str, "--max-stackframe", VG_(clo_max_stackframe)) {}
       else if VG_INT_CLO(str, "--main-stacksize", VG_(clo_main_stacksize)) {}
+      else if VG_BOOL_CLO(str, "--deterministic", VG_(clo_deterministic)) {}
 
       // Set up VG_(clo_sim_hints). This is needed a.o. for an inner
       // running in an outer, to have "no-inner-prefix" enabled
@@ -398,6 +406,39 @@ static void early_process_cmd_line_options ( /*OUT*/Int* need_help,
    }
 }
 
+#if defined(VGO_linux)
+/* For --deterministic=yes: the kernel chose the stack and mmap bases
+   of this process when it was exec'd, and the client's address space
+   is derived from them.  So switch off address space randomisation
+   and exec ourselves again, with the same arguments and environment.
+   This is done here rather than in the launcher, as only now all
+   sources of options (command line, $VALGRIND_OPTS, .valgrindrc
+   files) have been looked at.  Returns if randomisation is off
+   already, or if it cannot be switched off. */
+static void reexec_without_aslr ( HChar** argv, HChar** envp )
+{
+   SysRes res;
+   UWord  pers;
+
+   res = VG_(do_syscall1)(__NR_personality, 0xffffffff);
+   if (sr_isError(res) || (sr_Res(res) & VKI_ADDR_NO_RANDOMIZE))
+      return;
+   pers = sr_Res(res);
+
+   res = VG_(do_syscall1)(__NR_personality, pers | VKI_ADDR_NO_RANDOMIZE);
+   if (sr_isError(res))
+      return;
+
+   VG_(debugLog)(1, "main", "Re-executing without address randomisation\n");
+   res = VG_(do_syscall3)(__NR_execve, (UWord)"/proc/self/exe",
+                          (UWord)argv, (UWord)envp);
+
+   /* still here: continue as we are */
+   VG_(debugLog)(1, "main", "... execve failed, errno %lu\n", sr_Err(res));
+   (void)VG_(do_syscall1)(__NR_personality, pers);
+}
+#endif
+
 /* The main processing for command line options.  See comments above
    on early_process_cmd_line_options.
 
@@ -516,6 +557,7 @@ void main_process_cmd_line_options ( /*OUT*/Bool* logging_to_fd,
       else if VG_STREQ(     arg, "-d")                   {}
       else if VG_STREQN(17, arg, "--max-stackframe=")    {}
       else if VG_STREQN(17, arg, "--main-stacksize=")    {}
+      else if VG_STREQN(16, arg, "--deterministic=")     {}
       else if VG_STREQN(12, arg,  "--sim-hints=")        {}
       else if VG_STREQN(15, arg, "--profile-heap=")      {}
       else if VG_STREQN(20, arg, "--core-redzone-size=") {}
@@ -608,6 +650,7 @@ void main_process_cmd_line_options ( /*OUT*/Bool* logging_to_fd,
       else if VG_STR_CLO (arg, "--db-command",       VG_(clo_db_command)) {}
       else if VG_BOOL_CLO(arg, "--sym-offsets",      VG_(clo_sym_offsets)) {}
       else if VG_BOOL_CLO(arg, "--read-var-info",    VG_(clo_read_var_info)) {}
+      else if VG_BOOL_CLO(arg, "--defer-debuginfo",  VG_(clo_defer_debuginfo)) {}
 
       else if VG_INT_CLO (arg, "--dump-error",       VG_(clo_dump_error))   {}
       else if VG_INT_CLO (arg, "--input-fd",         VG_(clo_input_fd))     {}
@@ -1785,6 +1828,16 @@ Int valgrind_main ( Int argc, HChar **argv, HChar **envp )
                     "(early_) Process Valgrind's command line options\n");
    early_process_cmd_line_options(&need_help, &toolname);
 
+   //--------------------------------------------------------------
+   // With --deterministic=yes, restart without address space
+   // randomisation
+   //   p: early_process_cmd_line_options() [for clo_deterministic]
+   //--------------------------------------------------------------
+#  if defined(VGO_linux)
+   if (VG_(clo_deterministic))
+      reexec_without_aslr(argv, envp);
+#  endif
+
    // Set default vex control params
    LibVEX_default_VexControl(& VG_(clo_vex_control));
 
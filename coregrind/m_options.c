@@ -111,6 +111,7 @@ Int    VG_(clo_merge_recursive_frames) = 0; // default value: no merge
 const HChar* VG_(clo_sim_hints)      = NULL;
 Bool   VG_(clo_sym_offsets)    = False;
 Bool   VG_(clo_read_var_info)  = False;
+Bool   VG_(clo_defer_debuginfo) = False;
 Int    VG_(clo_n_req_tsyms)    = 0;
 const HChar* VG_(clo_req_tsyms)[VG_CLO_MAX_REQ_TSYMS];
 HChar* VG_(clo_require_text_symbol) = NULL;
@@ -120,6 +121,7 @@ Bool   VG_(clo_show_below_main)= False;
 Bool   VG_(clo_show_emwarns)   = False;
 Word   VG_(clo_max_stackframe) = 2000000;
 Word   VG_(clo_main_stacksize) = 0; /* use client's rlimit.stack */
+Bool   VG_(clo_deterministic)  = False;
 Bool   VG_(clo_wait_for_gdb)   = False;
 VgSmc  VG_(clo_smc_check)      = Vg_SmcStack;
 const HChar* VG_(clo_kernel_variant) = NULL;
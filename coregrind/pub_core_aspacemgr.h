@@ -258,9 +258,10 @@ extern SysRes VG_(am_mmap_file_float_valgrind)
 
 /* Map shared a file at an unconstrained address for V, and update the
    segment array accordingly.  This is used by V for communicating
-   with vgdb.  */
-extern SysRes VG_(am_shared_mmap_file_float_valgrind)
-   ( SizeT length, UInt prot, Int fd, Off64T offset );
+   with vgdb, and by tools publishing data to other processes.  */
+// Is in tool-visible header file.
+// extern SysRes VG_(am_shared_mmap_file_float_valgrind)
+//   ( SizeT length, UInt prot, Int fd, Off64T offset );
 
 /* Unmap the given address range and update the segment array
    accordingly.  This fails if the range isn't valid for the client.
@@ -207,6 +207,9 @@ extern const HChar* VG_(clo_sim_hints);
 extern Bool VG_(clo_sym_offsets);
 /* Read DWARF3 variable info even if tool doesn't ask for it? */
 extern Bool VG_(clo_read_var_info);
+/* Postpone reading debug info which might not be needed? */
+// Is in tool-visible header file.
+// extern Bool VG_(clo_defer_debuginfo);
 /* Which prefix to strip from full source file paths, if any. */
 extern const HChar* VG_(clo_prefix_to_strip);
 
@@ -264,6 +267,10 @@ extern Word VG_(clo_max_stackframe);
    be? */
 extern Word VG_(clo_main_stacksize);
 
+/* Make the client's initial address space, environment and auxv the
+   same from run to run? */
+extern Bool VG_(clo_deterministic);
+
 /* If the same IP is found twice in a backtrace in a sequence of max
    VG_(clo_merge_recursive_frames) frames, then the recursive call
    is merged in the backtrace.
@@ -144,6 +144,10 @@ extern HChar* VG_(am_get_filename)( NSegment const * );
 extern Bool VG_(am_is_valid_for_client) ( Addr start, SizeT len, 
                                           UInt prot );
 
+// See pub_core_aspacemgr.h for description.
+extern SysRes VG_(am_shared_mmap_file_float_valgrind)
+   ( SizeT length, UInt prot, Int fd, Off64T offset );
+
 // See pub_core_aspacemgr.h for description.
 /* Really just a wrapper around VG_(am_mmap_anon_float_valgrind). */
 extern void* VG_(am_shadow_alloc)(SizeT size);
@@ -58,6 +58,9 @@ extern const HChar* VG_(LD_PRELOAD_var_name);
 extern Int  VG_(waitpid)( Int pid, Int *status, Int options );
 extern Int  VG_(system) ( const HChar* cmd );
 extern Int  VG_(fork)   ( void);
+// Fork a helper process for the tool, see m_libcproc.c.  Unlike VG_(fork),
+// the client does not get notified when it terminates.
+extern Int  VG_(fork_helper) ( void );
 extern void VG_(execv)  ( const HChar* filename, HChar** argv );
 
 /* ---------------------------------------------------------------------
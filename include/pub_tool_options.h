@@ -174,6 +174,11 @@ extern Int   VG_(clo_backtrace_size);
 /* Continue stack traces below main()?  Default: NO */
 extern Bool VG_(clo_show_below_main);
 
+/* Postpone reading debug info which might not be needed?  Default: NO.
+   Tool-visible so tools which rarely need it can make this the default
+   (callgrind does). */
+extern Bool VG_(clo_defer_debuginfo);
+
 
 /* Used to expand file names.  "option_name" is the option name, eg.
    "--log-file".  'format' is what follows, eg. "cachegrind.out.%p".  In
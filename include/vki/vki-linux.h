@@ -3154,6 +3154,12 @@ struct vki_sock_fprog {
 	__vki_u16 len;  /* actually unsigned short */
 	struct vki_sock_filter *filter;
 };
+
+//----------------------------------------------------------------------
+// From linux-3.2.0/include/linux/personality.h
+//----------------------------------------------------------------------
+
+#define VKI_ADDR_NO_RANDOMIZE 0x0040000 /* disable randomization of VA space */
    
 #endif // __VKI_LINUX_H
 
@@ -414,6 +414,8 @@
 #define __NR_setns			375
 #define __NR_process_vm_readv		376
 #define __NR_process_vm_writev		377
+#define __NR_close_range		436
+#define __NR_openat2			437
 
 
 
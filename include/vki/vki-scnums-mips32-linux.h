@@ -382,6 +382,8 @@
 #define __NR_syncfs                     (__NR_Linux + 342)
 #define __NR_process_vm_readv           (__NR_Linux + 345)
 #define __NR_process_vm_writev          (__NR_Linux + 346)
+#define __NR_close_range               (__NR_Linux + 436)
+#define __NR_openat2                    (__NR_Linux + 437)
 
 /*
  * Offset of the last Linux o32 flavoured syscall
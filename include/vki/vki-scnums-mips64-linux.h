@@ -342,6 +342,8 @@
 #define __NR_setns                  (__NR_Linux + 303)
 #define __NR_process_vm_readv       (__NR_Linux + 304)
 #define __NR_process_vm_writev      (__NR_Linux + 305)
+#define __NR_close_range            (__NR_Linux + 436)
+#define __NR_openat2                (__NR_Linux + 437)
 
 #endif /* __VKI_SCNUMS_MIPS64_LINUX_H */
 
@@ -395,6 +395,8 @@
 #define __NR_setns		350
 #define __NR_process_vm_readv	351
 #define __NR_process_vm_writev	352
+#define __NR_close_range	436
+#define __NR_openat2		437
 
 #endif /* __VKI_SCNUMS_PPC32_LINUX_H */
 
@@ -387,6 +387,8 @@
 #define __NR_setns		350
 #define __NR_process_vm_readv	351
 #define __NR_process_vm_writev	352
+#define __NR_close_range	436
+#define __NR_openat2		437
 
 #endif /* __VKI_SCNUMS_PPC64_LINUX_H */
 
@@ -307,6 +307,8 @@
 #define __NR_setns		339
 #define __NR_process_vm_readv	340
 #define __NR_process_vm_writev	341
+#define __NR_close_range	436
+#define __NR_openat2		437
 #define NR_syscalls 342
 
 /* 
@@ -383,6 +383,8 @@
 #define __NR_setns		346
 #define __NR_process_vm_readv   347
 #define __NR_process_vm_writev  348
+#define __NR_close_range        436
+#define __NR_openat2            437
 
 #endif /* __VKI_SCNUMS_X86_LINUX_H */
 
@@ -0,0 +1,27 @@
+// With --defer-debuginfo=yes, the unwind info of this program is only
+// read when the first stack trace needs it. The functions are compiled
+// without frame pointer, so the trace past f1 needs the unwind info.
+
+#include "valgrind.h"
+
+__attribute__((noinline)) int f1(int x)
+{
+   VALGRIND_PRINTF_BACKTRACE("f1\n");
+   return x + 1;
+}
+
+__attribute__((noinline)) int f2(int x)
+{
+   return f1(x) + 2;
+}
+
+__attribute__((noinline)) int f3(int x)
+{
+   return f2(x) + 3;
+}
+
+int main(void)
+{
+   int r = f3(0);
+   return r != 6;
+}
@@ -0,0 +1,51 @@
+// This artificial program does a lot of calls between many functions,
+// in pseudo-random order.  It is a stress test for the lookup of call
+// arcs, contexts and basic block costs in Callgrind, as the number of
+// distinct call arcs is large and the call pattern defeats the caches
+// of last recently used entries.  With "--separate-callers=N", the
+// number of contexts grows quickly with N.
+
+#define N_FUNCS  64
+#define DEPTH    6
+#define REPS     1000*1000
+
+typedef unsigned int (*func_t)(unsigned int depth, unsigned int seed);
+
+static func_t funcs[N_FUNCS];
+
+// Linear congruential generator, selects the function called next
+#define NEXT(s) ((s) * 1103515245u + 12345u)
+
+#define FUNC(n)                                                         \
+__attribute__((noinline))                                               \
+static unsigned int f##n(unsigned int depth, unsigned int seed)        \
+{                                                                       \
+   unsigned int s = NEXT(seed ^ n);                                     \
+   if (depth == 0) return s;                                            \
+   s = funcs[(s >> 16) % N_FUNCS](depth - 1, s);                        \
+   if (s & 0x10000)                                                     \
+      s += funcs[(s >> 8) % N_FUNCS](depth - 1, s);                     \
+   return s;                                                            \
+}
+
+#define FUNC8(n) FUNC(n##0) FUNC(n##1) FUNC(n##2) FUNC(n##3) \
+                 FUNC(n##4) FUNC(n##5) FUNC(n##6) FUNC(n##7)
+
+FUNC8(1) FUNC8(2) FUNC8(3) FUNC8(4) FUNC8(5) FUNC8(6) FUNC8(7) FUNC8(8)
+
+#define ADD8(n) f##n##0, f##n##1, f##n##2, f##n##3, \
+                f##n##4, f##n##5, f##n##6, f##n##7
+
+static func_t funcs[N_FUNCS] = {
+   ADD8(1), ADD8(2), ADD8(3), ADD8(4), ADD8(5), ADD8(6), ADD8(7), ADD8(8)
+};
+
+int main(void)
+{
+   unsigned int i, sum = 0;
+
+   for (i = 0; i < REPS; i++) {
+      sum += funcs[i % N_FUNCS](DEPTH, i);
+   }
+   return ( sum == 0xdeadbeef ? 1 : 0 );
+}